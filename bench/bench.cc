@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <docopt.h>
+#include <json.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/estep.hpp"
+#include "../lda/inference.hpp"
+#include "../lda/lda.hpp"
+#include "../lda/lda_io.hpp"
+#include "../lda/math.hpp"
+#include "../lda/sparse_matrix.hpp"
+#include "../tsv/tsv.hpp"
+#include "synthetic.hpp"
+
+
+// Usage message in the docopt syntax.
+static char const usage[] = R"(
+bench - Benchmarks of the LDA library
+
+Usage:
+  bench [options]
+  bench -h
+
+Runs microbenchmarks and end-to-end fit, transform and score benchmarks on
+a synthetic corpus drawn from the LDA generative process, and prints the
+results in JSON. Throughput is in tokens per second for the end-to-end
+benchmarks and in the unit of each microbenchmark otherwise.
+
+Options:
+  -h --help                    Show this message
+  --docs <number>              Documents in the corpus (D) [default: 2000]
+  --words <number>             Vocabulary size (W) [default: 2000]
+  --topics <number>            Topic count (K) [default: 16]
+  --doc-length <number>        Mean tokens per document [default: 100]
+  --doc-topic-prior <number>   Dirichlet prior of document topics in the corpus [default: 0.1]
+  --topic-word-prior <number>  Dirichlet prior of topic words in the corpus [default: 0.01]
+  --seed <number>              Seed of the corpus and the models [default: 1]
+  --max-iter <number>          Max iteration of fit and transform [default: 10]
+  --threads <number>           Number of threads [default: 1]
+  --float32                    Use single precision model parameters
+  --min-time <seconds>         Min time to run each benchmark [default: 0.5]
+  --filter <text>              Run only the benchmarks whose name contains text
+  --output <json>              Write the results to a file instead of the standard output
+)";
+
+// Returns the peak resident set size of this process in bytes.
+std::size_t peak_rss()
+{
+    rusage resources;
+    ::getrusage(RUSAGE_SELF, &resources);
+    return static_cast<std::size_t>(resources.ru_maxrss) * 1024;
+}
+
+// Sink of computed values.
+static volatile double benchmark_sink;
+
+// Keeps the compiler from discarding a computed value.
+template<typename T>
+void do_not_optimize(T value)
+{
+    benchmark_sink = benchmark_sink + static_cast<double>(value);
+}
+
+// Runs benchmarks and collects the results.
+class benchmark_runner
+{
+  public:
+    benchmark_runner(double min_time, std::string filter)
+        : min_time_{min_time}
+        , filter_{std::move(filter)}
+    {
+    }
+
+    // Returns true if the benchmark of given name is selected.
+    bool selected(std::string const& name) const
+    {
+        return name.find(filter_) != std::string::npos;
+    }
+
+    // Calls body repeatedly until min_time has passed, at least once.
+    // body() processes items of unit and returns how many. Each call is
+    // timed, so a body should take well over a microsecond.
+    template<typename Body>
+    void run(std::string const& name, std::string const& unit, Body&& body)
+    {
+        if (!selected(name)) {
+            return;
+        }
+
+        using clock = std::chrono::steady_clock;
+
+        std::size_t iteration_count = 0;
+        double total_items = 0;
+        double total_time = 0;
+        double min_iteration_time = 0;
+
+        while (iteration_count == 0 || total_time < min_time_) {
+            auto const start = clock::now();
+            auto const items = static_cast<double>(body());
+            double const time = std::chrono::duration<double>(clock::now() - start).count();
+
+            min_iteration_time = iteration_count == 0 ? time : std::min(min_iteration_time, time);
+            iteration_count++;
+            total_items += items;
+            total_time += time;
+        }
+
+        double const mean_time = total_time / static_cast<double>(iteration_count);
+
+        results_.push_back({
+            {"name", name},
+            {"iterations", iteration_count},
+            {"mean_seconds", mean_time},
+            {"min_seconds", min_iteration_time},
+            {"unit", unit},
+            {"items_per_iteration", total_items / static_cast<double>(iteration_count)},
+            {"items_per_second", total_items / total_time},
+            {"peak_rss_bytes", peak_rss()},
+        });
+
+        std::cerr << name << ": " << total_items / total_time << ' ' << unit << "/s\n";
+    }
+
+    // Returns the results as a JSON array.
+    nlohmann::json const& results() const
+    {
+        return results_;
+    }
+
+  private:
+    double min_time_;
+    std::string filter_;
+    nlohmann::json results_ = nlohmann::json::array();
+};
+
+// Benchmarks the math kernels of the E-step.
+template<typename T>
+void run_math_benchmarks(benchmark_runner& runner, std::size_t topic_count)
+{
+    std::mt19937_64 engine;
+    std::gamma_distribution<double> gamma{1.0, 10.0};
+
+    std::vector<double> args(1 << 16);
+    for (double& arg : args) {
+        arg = gamma(engine) + 1e-3;
+    }
+
+    runner.run("digamma", "calls", [&] {
+        double sum = 0;
+        for (double arg : args) {
+            sum += detail::digamma(arg);
+        }
+        do_not_optimize(sum);
+        return args.size();
+    });
+
+    std::size_t const row_count = args.size() / topic_count;
+    std::vector<T> params(args.begin(), args.begin() + static_cast<std::ptrdiff_t>(row_count * topic_count));
+    std::vector<T> geoexp(params.size());
+
+    runner.run("dirichlet_geometric_expect", "values", [&] {
+        for (std::size_t row = 0; row < row_count; ++row) {
+            estep::dirichlet_geometric_expect(params.data() + row * topic_count, topic_count,
+                                              geoexp.data() + row * topic_count);
+        }
+        do_not_optimize(geoexp[0]);
+        return params.size();
+    });
+}
+
+// Benchmarks the TSV reader and writer on the dense corpus.
+void run_tsv_benchmarks(benchmark_runner& runner, sparse_matrix const& documents)
+{
+    if (!runner.selected("save_tsv") && !runner.selected("load_tsv")) {
+        return;
+    }
+
+    xt::xtensor<double, 2> const dense = documents.to_dense();
+
+    std::ostringstream saved;
+    save_tsv(saved, dense);
+    std::string const text = saved.str();
+
+    runner.run("save_tsv", "bytes", [&] {
+        std::ostringstream output;
+        save_tsv(output, dense);
+        return static_cast<std::size_t>(output.tellp());
+    });
+
+    runner.run("load_tsv", "bytes", [&] {
+        std::istringstream input{text};
+        do_not_optimize(load_tsv(input).size());
+        return text.size();
+    });
+}
+
+// Benchmarks model serialization in the text and binary formats.
+template<typename T>
+void run_model_io_benchmarks(benchmark_runner& runner, basic_latent_dirichlet_allocation<T> const& lda)
+{
+    auto const run_format = [&](std::string const& suffix, auto save) {
+        std::ostringstream saved;
+        save(saved, lda);
+        std::string const data = saved.str();
+
+        runner.run("save_lda" + suffix, "bytes", [&] {
+            std::ostringstream output;
+            save(output, lda);
+            return static_cast<std::size_t>(output.tellp());
+        });
+
+        runner.run("load_lda" + suffix, "bytes", [&] {
+            std::istringstream input{data};
+            do_not_optimize(load_lda<T>(input).update_count());
+            return data.size();
+        });
+    };
+
+    run_format("", [](std::ostream& output, basic_latent_dirichlet_allocation<T> const& model) {
+        save_lda(output, model);
+    });
+    run_format("_binary", [](std::ostream& output, basic_latent_dirichlet_allocation<T> const& model) {
+        save_lda_binary(output, model);
+    });
+}
+
+// Runs all the benchmarks with model parameters of type T.
+template<typename T>
+nlohmann::json run_benchmarks(std::map<std::string, docopt::value> const& options)
+{
+    synthetic_corpus_config corpus_config;
+    corpus_config.doc_count = static_cast<std::size_t>(options.at("--docs").asLong());
+    corpus_config.word_count = static_cast<std::size_t>(options.at("--words").asLong());
+    corpus_config.topic_count = static_cast<std::size_t>(options.at("--topics").asLong());
+    corpus_config.doc_length = std::stod(options.at("--doc-length").asString());
+    corpus_config.doc_topic_prior = std::stod(options.at("--doc-topic-prior").asString());
+    corpus_config.topic_word_prior = std::stod(options.at("--topic-word-prior").asString());
+    corpus_config.seed = static_cast<std::uint64_t>(options.at("--seed").asLong());
+
+    lda_config config;
+    config.topic_count = corpus_config.topic_count;
+    config.doc_topic_prior = 1 / static_cast<double>(config.topic_count);
+    config.topic_word_prior = 1 / static_cast<double>(config.topic_count);
+    config.outer_iter_count = static_cast<int>(options.at("--max-iter").asLong());
+    config.inner_iter_count = config.outer_iter_count;
+    config.thread_count = static_cast<std::size_t>(options.at("--threads").asLong());
+    config.seed = corpus_config.seed;
+
+    std::string filter;
+    if (auto const filter_option = options.at("--filter")) {
+        filter = filter_option.asString();
+    }
+    benchmark_runner runner{std::stod(options.at("--min-time").asString()), filter};
+
+    synthetic_corpus const corpus = generate_synthetic_corpus(corpus_config);
+    sparse_matrix const& documents = corpus.documents;
+
+    run_math_benchmarks<T>(runner, config.topic_count);
+    run_tsv_benchmarks(runner, documents);
+
+    // Each fit starts from the same random topics.
+    basic_latent_dirichlet_allocation<T> lda{config};
+
+    runner.run("fit", "tokens", [&] {
+        lda = basic_latent_dirichlet_allocation<T>{config};
+        lda.fit(documents);
+        return corpus.token_count;
+    });
+
+    std::vector<std::string> const model_benchmarks = {
+        "transform", "inference_transform", "inference_small_batches", "score", "save_lda", "load_lda", "save_lda_binary", "load_lda_binary",
+    };
+    bool const uses_model = std::any_of(model_benchmarks.begin(), model_benchmarks.end(),
+                                        [&](std::string const& name) { return runner.selected(name); });
+
+    if (uses_model) {
+        if (lda.update_count() == 0) {
+            lda.fit(documents);
+        }
+
+        runner.run("transform", "tokens", [&] {
+            do_not_optimize(lda.transform(documents).size());
+            return corpus.token_count;
+        });
+
+        basic_lda_inference<T> const inference{lda};
+
+        runner.run("inference_transform", "tokens", [&] {
+            do_not_optimize(inference.transform(documents).size());
+            return corpus.token_count;
+        });
+
+        // Batches of a few documents, as served at low latency, with and
+        // without reusing a workspace.
+        std::size_t const small_batch_size = 8;
+        std::vector<sparse_matrix> small_batches;
+        for (std::size_t begin = 0; begin < documents.row_count(); begin += small_batch_size) {
+            small_batches.push_back(documents.rows(begin, std::min(begin + small_batch_size, documents.row_count())));
+        }
+
+        runner.run("inference_small_batches", "tokens", [&] {
+            for (sparse_matrix const& batch : small_batches) {
+                do_not_optimize(inference.transform(batch).size());
+            }
+            return corpus.token_count;
+        });
+
+        inference_workspace workspace;
+
+        runner.run("inference_small_batches_workspace", "tokens", [&] {
+            for (sparse_matrix const& batch : small_batches) {
+                do_not_optimize(inference.transform(batch, workspace)[0]);
+            }
+            return corpus.token_count;
+        });
+
+        runner.run("score", "tokens", [&] {
+            do_not_optimize(lda.score(documents));
+            return corpus.token_count;
+        });
+
+        run_model_io_benchmarks(runner, lda);
+    }
+
+    return {
+        {"config", {
+            {"docs", corpus_config.doc_count},
+            {"words", corpus_config.word_count},
+            {"topics", corpus_config.topic_count},
+            {"doc_length", corpus_config.doc_length},
+            {"doc_topic_prior", corpus_config.doc_topic_prior},
+            {"topic_word_prior", corpus_config.topic_word_prior},
+            {"seed", corpus_config.seed},
+            {"max_iter", config.outer_iter_count},
+            {"threads", config.thread_count},
+            {"scalar", sizeof(T) == sizeof(float) ? "float32" : "float64"},
+        }},
+        {"corpus", {
+            {"tokens", corpus.token_count},
+            {"nonzeros", documents.nonzero_count()},
+        }},
+        {"benchmarks", runner.results()},
+        {"peak_rss_bytes", peak_rss()},
+    };
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        auto const options = docopt::docopt(usage, {argv + 1, argv + argc}, true);
+
+        nlohmann::json const results = options.at("--float32").asBool()
+            ? run_benchmarks<float>(options)
+            : run_benchmarks<double>(options);
+
+        if (auto const output = options.at("--output")) {
+            std::ofstream file{output.asString()};
+            file << results.dump(2) << '\n';
+            if (!file) {
+                throw std::runtime_error("cannot write file: " + output.asString());
+            }
+        } else {
+            std::cout << results.dump(2) << '\n';
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "error: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/sparse_matrix.hpp"
+#include "synthetic.hpp"
+
+
+namespace
+{
+    // Draws a probability vector from the symmetric Dirichlet distribution.
+    // Gamma variables of a tiny shape underflow to zero, so at least one
+    // element is made positive.
+    template<typename Engine>
+    std::vector<double> draw_dirichlet(Engine& engine, double prior, std::size_t size)
+    {
+        std::gamma_distribution<double> gamma{prior, 1.0};
+        std::vector<double> probs(size);
+        double sum = 0;
+
+        for (double& prob : probs) {
+            prob = gamma(engine);
+            sum += prob;
+        }
+
+        if (sum == 0) {
+            probs[std::uniform_int_distribution<std::size_t>{0, size - 1}(engine)] = 1;
+            return probs;
+        }
+
+        for (double& prob : probs) {
+            prob /= sum;
+        }
+        return probs;
+    }
+}
+
+synthetic_corpus generate_synthetic_corpus(synthetic_corpus_config const& config)
+{
+    std::mt19937_64 engine{config.seed};
+
+    synthetic_corpus corpus;
+    corpus.topic_word_distributions = xt::xtensor<double, 2>::from_shape({config.topic_count, config.word_count});
+
+    std::vector<std::discrete_distribution<sparse_matrix::index_type>> topic_words;
+    topic_words.reserve(config.topic_count);
+
+    for (std::size_t topic = 0; topic < config.topic_count; ++topic) {
+        std::vector<double> const probs = draw_dirichlet(engine, config.topic_word_prior, config.word_count);
+        std::copy(probs.begin(), probs.end(), &corpus.topic_word_distributions(topic, 0));
+        topic_words.emplace_back(probs.begin(), probs.end());
+    }
+
+    std::poisson_distribution<std::size_t> doc_length{config.doc_length};
+
+    std::vector<sparse_matrix::offset_type> row_offsets = {0};
+    std::vector<sparse_matrix::index_type> col_indices;
+    std::vector<double> values;
+    std::vector<sparse_matrix::index_type> tokens;
+
+    for (std::size_t doc = 0; doc < config.doc_count; ++doc) {
+        std::vector<double> const topic_probs = draw_dirichlet(engine, config.doc_topic_prior, config.topic_count);
+        std::discrete_distribution<std::size_t> doc_topics{topic_probs.begin(), topic_probs.end()};
+
+        tokens.resize(doc_length(engine));
+        for (auto& token : tokens) {
+            token = topic_words[doc_topics(engine)](engine);
+        }
+        std::sort(tokens.begin(), tokens.end());
+
+        for (auto token = tokens.begin(); token != tokens.end(); ) {
+            auto const run_end = std::upper_bound(token, tokens.end(), *token);
+            col_indices.push_back(*token);
+            values.push_back(static_cast<double>(run_end - token));
+            token = run_end;
+        }
+
+        row_offsets.push_back(values.size());
+        corpus.token_count += tokens.size();
+    }
+
+    corpus.documents = sparse_matrix{config.word_count, std::move(row_offsets), std::move(col_indices), std::move(values)};
+    return corpus;
+}
@@ -0,0 +1,57 @@
+#ifndef INCLUDED_SYNTHETIC_HPP
+#define INCLUDED_SYNTHETIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/sparse_matrix.hpp"
+
+
+// Parameters of a synthetic corpus drawn from the LDA generative process.
+struct synthetic_corpus_config
+{
+    // The number of documents D, the vocabulary size W and the number of
+    // topics K.
+    std::size_t doc_count = 1000;
+    std::size_t word_count = 1000;
+    std::size_t topic_count = 10;
+
+    // Mean number of tokens per document. Document lengths follow the
+    // Poisson distribution, so this sets the density of the document-word
+    // matrix together with topic_word_prior.
+    double doc_length = 100;
+
+    // Symmetric Dirichlet priors of the topic proportions of documents and
+    // the word distributions of topics. Smaller priors make documents focus
+    // on fewer topics and topics on fewer words.
+    double doc_topic_prior = 0.1;
+    double topic_word_prior = 0.01;
+
+    // Seed of the random engine. The same config gives the same corpus.
+    std::uint64_t seed = 1;
+};
+
+// Synthetic corpus and the parameters it was drawn from.
+struct synthetic_corpus
+{
+    // Word counts of the documents, a D-by-W matrix.
+    sparse_matrix documents;
+
+    // The word distribution of each topic, a K-by-W matrix.
+    xt::xtensor<double, 2> topic_word_distributions;
+
+    // Sum of the word counts.
+    std::size_t token_count = 0;
+};
+
+// Draws a corpus from the LDA generative process. Each topic draws its word
+// distribution from Dirichlet(topic_word_prior), and each document draws
+// its topic proportions from Dirichlet(doc_topic_prior), its length from
+// Poisson(doc_length) and then a topic and a word of the topic for each
+// token.
+synthetic_corpus generate_synthetic_corpus(synthetic_corpus_config const& config);
+
+
+#endif
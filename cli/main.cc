@@ -1,17 +1,45 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <numeric>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <docopt.h>
+#include <json.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include "../lda/inference.hpp"
 #include "../lda/lda.hpp"
 #include "../lda/lda_io.hpp"
+#include "../lda/micro_batcher.hpp"
+#include "../lda/parallel.hpp"
+#include "../lda/profile.hpp"
+#include "../lda/sparse_matrix.hpp"
+#include "../lda/sparse_matrix_io.hpp"
+#include "../tsv/bow.hpp"
 #include "../tsv/tsv.hpp"
+#include "unix_socket.hpp"
 
 
 // Version of this command-line program.
@@ -27,9 +55,27 @@ lda - Latent Dirichlet Allocation
 Usage:
   lda train       [options] <doc> <model>
   lda classify    [options] <doc> <model>
-  lda show-topics <model>
+  lda score       [options] <doc> <model>
+  lda show-topics [options] <model>
+  lda export-json <model> <json>
+  lda convert     [options] <doc> <bin>
+  lda serve       [options] <model>
   lda -h
 
+Documents are read from the standard input if <doc> is -. Online training
+from the standard input requires --corpus-size and --passes 1.
+
+train --checkpoint saves the training state every --checkpoint-every
+iterations or online updates, and after --checkpoint-seconds since the last
+save. train --resume continues from a checkpoint with the configuration
+saved in it. Give the same documents, --threads and, in online training,
+--batch-size to continue exactly where training stopped.
+
+serve classifies documents sent as lines of the --format text, tsv or
+libsvm, and answers each with a line of the --output text, or with a line
+starting with "error:". Requests of all clients are batched together. The
+line "#stats" is answered with the request and latency counters in JSON.
+
 Options:
   -h --help                    Show this message
   --topics <number>            Topic count [default: 2]
@@ -38,6 +84,31 @@ Options:
   --max-iter <number>          Max iteration [default: 100]
   --threshold <number>         Convergence threshold [default: 0.1]
   --preconditions <file>       Topic-word preconditioning file
+  --online                     Train with online variational Bayes
+  --batch-size <number>        Documents per batch in online training, classification, scoring and serving [default: 256]
+  --passes <number>            Passes over documents in online training [default: 1]
+  --progress                   Print the progress of training to the standard error
+  --trace <file>               Write the progress of training to a file as JSON lines
+  --elbo                       Compute the evidence lower bound in each iteration of batch training
+  --checkpoint <file>          Save training checkpoints to a file
+  --checkpoint-every <number>  Iterations or online updates between checkpoints [default: 10]
+  --checkpoint-seconds <s>     Max seconds between checkpoints, 0 for no limit [default: 0]
+  --checkpoint-topics-only     Leave the document-topic parameters out of checkpoints of batch training
+  --resume <checkpoint>        Resume training from a checkpoint
+  --corpus-size <number>       Document count used in online training
+  --threads <number>           Number of threads [default: 1]
+  --float32                    Use single precision model parameters
+  --engine <name>              Training engine: variational or gibbs [default: variational]
+  --seed <number>              Seed of the random initialization in training [default: 0]
+  --format <name>              Document format: tsv, uci or libsvm [default: tsv]
+  --zero-based                 Word indices in libsvm documents start from zero
+  --output <format>            Output of classify: tsv, top or binary [default: tsv]
+  --proportions                Output normalized topic proportions in classify
+  --top <number>               Topics per document in the top output [default: 3]
+  --precision <digits>         Significant digits of output, 0 for the shortest exact form [default: 6]
+  --socket <path>              Serve on a Unix domain socket instead of the standard input and output
+  --max-latency <ms>           Max time a served request waits for others to join its batch [default: 2]
+  --profile <file>             Write the time spent in each phase and the work counts to a file as JSON
 )";
 
 // Creates LDA configuration based on docopt options.
@@ -67,6 +138,22 @@ latent_dirichlet_allocation::config make_lda_config(std::map<std::string, docopt
         config.convergence_threshold = std::stod(threshold.asString());
     }
 
+    if (auto const corpus_size = options.at("--corpus-size")) {
+        config.corpus_doc_count = static_cast<std::size_t>(corpus_size.asLong());
+    }
+
+    if (auto const threads = options.at("--threads")) {
+        config.thread_count = static_cast<std::size_t>(threads.asLong());
+    }
+
+    if (auto const seed = options.at("--seed")) {
+        config.seed = static_cast<std::uint64_t>(std::stoull(seed.asString()));
+    }
+
+    if (auto const engine = options.at("--engine")) {
+        config.engine = engine_from_string(engine.asString());
+    }
+
     if (auto const preconditions = options.at("--preconditions")) {
         std::ifstream preconditions_file{preconditions.asString()};
         config.topic_word_preconditions = load_tsv(preconditions_file);
@@ -75,62 +162,1242 @@ latent_dirichlet_allocation::config make_lda_config(std::map<std::string, docopt
     return config;
 }
 
+// Returns true if path is a corpus file in the binary format.
+bool is_binary_corpus(std::string const& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    return is_binary_sparse_matrix(file);
+}
+
+// Returns the thread count given by the options.
+std::size_t get_thread_count(std::map<std::string, docopt::value> const& options)
+{
+    return static_cast<std::size_t>(options.at("--threads").asLong());
+}
+
+// Document file and how to read it.
+struct document_source
+{
+    std::string path;
+
+    // "binary" for a binary corpus, which is detected from the content, or
+    // the text format given by --format: "tsv", "uci" or "libsvm".
+    std::string format;
+
+    // Threads parsing TSV.
+    std::size_t thread_count = 1;
+
+    // First index of the libsvm format.
+    std::size_t index_base = 1;
+
+    // Minimum column count of the libsvm format, which does not record the
+    // vocabulary size. Inference sets it to the vocabulary size of the model.
+    std::size_t word_count = 0;
+};
+
+// Creates a document source for the <doc> argument.
+document_source make_document_source(std::map<std::string, docopt::value> const& options,
+                                     std::size_t word_count = 0)
+{
+    document_source source;
+    source.path = options.at("<doc>").asString();
+    source.format = options.at("--format").asString();
+    source.thread_count = get_thread_count(options);
+    source.index_base = options.at("--zero-based").asBool() ? 0 : 1;
+    source.word_count = word_count;
+
+    if (source.path != "-" && is_binary_corpus(source.path)) {
+        source.format = "binary";
+    } else if (source.format != "tsv" && source.format != "uci" && source.format != "libsvm") {
+        throw std::domain_error("unknown document format: " + source.format);
+    }
+
+    return source;
+}
+
+// Opens the document file of a source into file, or returns the standard
+// input if the path is "-".
+std::istream& open_documents(document_source const& source, std::ifstream& file)
+{
+    if (source.path == "-") {
+        return std::cin;
+    }
+
+    file.open(source.path);
+    if (!file) {
+        throw std::runtime_error("cannot open file: " + source.path);
+    }
+    return file;
+}
+
+// Loads all the documents of a source in a sparse format. A binary corpus
+// is mapped, and the sparse text formats are read without densifying rows.
+sparse_matrix load_sparse_documents(document_source const& source)
+{
+    if (source.format == "binary") {
+        return map_sparse_matrix(source.path);
+    }
+
+    std::ifstream file;
+    std::istream& document_file = open_documents(source, file);
+
+    if (source.format == "uci") {
+        return uci_docword_reader{document_file}.read_all();
+    }
+    return libsvm_reader{document_file, source.index_base, source.word_count}.read_all();
+}
+
+// Counts the number of documents in a source.
+std::size_t count_documents(document_source const& source)
+{
+    if (source.format == "binary") {
+        return map_sparse_matrix(source.path).row_count();
+    }
+
+    std::ifstream file;
+    std::istream& document_file = open_documents(source, file);
+
+    if (source.format == "uci") {
+        return uci_docword_reader{document_file}.document_count();
+    }
+
+    std::size_t count = 0;
+
+    for (std::string line; std::getline(document_file, line); ) {
+        count++;
+    }
+
+    return count;
+}
+
+// Calls process(documents) with all the documents in a source. documents
+// is a sparse_matrix, or a tensor parsed from TSV.
+template<typename Function>
+void with_documents(document_source const& source, Function&& process)
+{
+    if (source.format != "tsv") {
+        process(load_sparse_documents(source));
+        return;
+    }
+
+    std::ifstream file;
+    std::istream& document_file = open_documents(source, file);
+    process(tsv_reader{document_file, source.thread_count}.read_all());
+}
+
+// Calls process(batch) for consecutive batches of at most batch_size
+// documents in a source. The batches are passed as rvalues. Only a batch
+// of a TSV or UCI file is kept in memory. A libsvm file without the
+// vocabulary size is loaded whole to fix the column count of the batches.
+template<typename Function>
+void for_each_batch(document_source const& source, std::size_t batch_size, Function&& process)
+{
+    if (batch_size == 0) {
+        throw std::domain_error("batch size must be a positive integer");
+    }
+
+    std::ifstream file;
+    std::istream& document_file = open_documents(source, file);
+
+    if (source.format == "tsv") {
+        tsv_reader reader{document_file, source.thread_count};
+
+        for (;;) {
+            auto batch = reader.read(batch_size);
+            if (batch.shape()[0] == 0) {
+                break;
+            }
+            process(std::move(batch));
+        }
+        return;
+    }
+
+    if (source.format == "uci" || (source.format == "libsvm" && source.word_count != 0)) {
+        auto const read_batches = [&](auto&& reader) {
+            for (;;) {
+                sparse_matrix batch = reader.read(batch_size);
+                if (batch.row_count() == 0) {
+                    break;
+                }
+                process(std::move(batch));
+            }
+        };
+
+        if (source.format == "uci") {
+            read_batches(uci_docword_reader{document_file});
+        } else {
+            read_batches(libsvm_reader{document_file, source.index_base, source.word_count});
+        }
+        return;
+    }
+
+    sparse_matrix const documents = load_sparse_documents(source);
+
+    for (std::size_t begin = 0; begin < documents.row_count(); begin += batch_size) {
+        process(documents.rows(begin, std::min(begin + batch_size, documents.row_count())));
+    }
+}
+
+// Reports the progress of training as requested by --progress and --trace.
+// A line per iteration or online update is printed to the standard error,
+// and a JSON object per line is written to the trace file.
+class training_reporter
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit training_reporter(std::map<std::string, docopt::value> const& options)
+        : print_{options.at("--progress").asBool()}
+        , compute_elbo_{options.at("--elbo").asBool()}
+        , start_time_{clock::now()}
+    {
+        if (auto const trace = options.at("--trace")) {
+            trace_.open(trace.asString());
+            if (!trace_) {
+                throw std::runtime_error("cannot open file: " + trace.asString());
+            }
+        }
+    }
+
+    // Returns an observer of fit reporting each iteration.
+    fit_observer observer()
+    {
+        fit_observer result;
+        result.compute_elbo = compute_elbo_;
+        if (print_ || trace_.is_open()) {
+            result.callback = [this](fit_progress const& progress) {
+                report(progress);
+                return true;
+            };
+        }
+        return result;
+    }
+
+    // Reports an iteration of batch training.
+    void report(fit_progress const& progress)
+    {
+        // The gibbs engine only reports the time of each sweep.
+        if (print_ && std::isnan(progress.max_delta)) {
+            std::cerr << "iteration " << progress.iteration + 1 << ": " << progress.estep_seconds << " s\n";
+        } else if (print_) {
+            std::cerr << "iteration " << progress.iteration + 1
+                      << ": max delta " << progress.max_delta
+                      << ", inner iterations " << progress.mean_inner_iterations
+                      << ", e-step " << progress.estep_seconds << " s"
+                      << ", m-step " << progress.mstep_seconds << " s";
+            if (compute_elbo_) {
+                std::cerr << ", elbo " << progress.elbo;
+            }
+            std::cerr << (progress.converged ? ", converged\n" : "\n");
+        }
+
+        write_trace({
+            {"iteration", progress.iteration + 1},
+            {"max_delta", progress.max_delta},
+            {"converged", progress.converged},
+            {"mean_inner_iterations", progress.mean_inner_iterations},
+            {"estep_seconds", progress.estep_seconds},
+            {"elbo_seconds", progress.elbo_seconds},
+            {"mstep_seconds", progress.mstep_seconds},
+            {"elbo", progress.elbo},
+        });
+    }
+
+    // Reports an update of online training with a minibatch.
+    void report_update(std::size_t update, long pass, std::size_t doc_count, double seconds)
+    {
+        if (print_) {
+            std::cerr << "update " << update << " (pass " << pass + 1 << "): "
+                      << doc_count << " documents, " << seconds << " s\n";
+        }
+
+        write_trace({
+            {"update", update},
+            {"pass", pass + 1},
+            {"documents", doc_count},
+            {"seconds", seconds},
+        });
+    }
+
+  private:
+    // Writes a trace record with the time since the start of training.
+    void write_trace(nlohmann::json record)
+    {
+        if (!trace_.is_open()) {
+            return;
+        }
+
+        record["elapsed_seconds"] = std::chrono::duration<double>(clock::now() - start_time_).count();
+        trace_ << record.dump() << std::endl;
+    }
+
+  private:
+    bool print_;
+    bool compute_elbo_;
+    std::ofstream trace_;
+    clock::time_point start_time_;
+};
+
+// Flushes a file or directory to the storage. Returns zero on success or
+// the errno of the failure.
+int sync_path(std::string const& path)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return errno;
+    }
+    int const error = ::fsync(fd) == 0 ? 0 : errno;
+    ::close(fd);
+    return error;
+}
+
+// Writes a file through a temporary file renamed over it, so that the file
+// has either the old or the new content if the process or the machine
+// stops while writing. The content is synced before the rename and the
+// directory entry after it.
+template<typename Write>
+void replace_file(std::string const& path, Write&& write)
+{
+    std::string const temp_path = path + ".tmp";
+    {
+        std::ofstream file{temp_path, std::ios::binary};
+        write(file);
+        file.flush();
+        if (!file) {
+            throw std::runtime_error("cannot write file: " + temp_path);
+        }
+    }
+
+    if (sync_path(temp_path) != 0 || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("cannot write file: " + path);
+    }
+
+    // Some file systems cannot sync directories and fail with EINVAL; the
+    // rename is as durable as they make it.
+    std::string::size_type const slash = path.rfind('/');
+    std::string const directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int const error = sync_path(directory);
+    if (error != 0 && error != EINVAL) {
+        throw std::runtime_error("cannot sync directory: " + directory);
+    }
+}
+
+// Saves training checkpoints as requested by --checkpoint.
+class checkpoint_writer
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit checkpoint_writer(std::map<std::string, docopt::value> const& options)
+        : interval_{options.at("--checkpoint-every").asLong()}
+        , max_seconds_{std::stod(options.at("--checkpoint-seconds").asString())}
+        , topics_only_{options.at("--checkpoint-topics-only").asBool()}
+        , last_save_time_{clock::now()}
+    {
+        if (auto const path = options.at("--checkpoint")) {
+            path_ = path.asString();
+        }
+        if (interval_ <= 0) {
+            throw std::domain_error("checkpoint interval must be a positive integer");
+        }
+    }
+
+    // Returns true if checkpoints are requested.
+    bool enabled() const
+    {
+        return !path_.empty();
+    }
+
+    // Counts an iteration or online update, after which lda and state are
+    // saved if a checkpoint is due.
+    template<typename T>
+    void step(basic_latent_dirichlet_allocation<T> const& lda, basic_fit_state<T> const& state)
+    {
+        if (!enabled()) {
+            return;
+        }
+
+        step_count_++;
+        double const seconds = std::chrono::duration<double>(clock::now() - last_save_time_).count();
+        if (step_count_ < interval_ && !(max_seconds_ > 0 && seconds >= max_seconds_)) {
+            return;
+        }
+
+        basic_fit_state<T> topics_only_state;
+        topics_only_state.iteration_count = state.iteration_count;
+
+        replace_file(path_, [&](std::ostream& output) {
+            save_lda_checkpoint(output, lda, topics_only_ ? topics_only_state : state);
+        });
+
+        step_count_ = 0;
+        last_save_time_ = clock::now();
+    }
+
+  private:
+    std::string path_;
+    long interval_;
+    double max_seconds_;
+    bool topics_only_;
+    long step_count_ = 0;
+    clock::time_point last_save_time_;
+};
+
+// Returns the number of documents in a dense or sparse batch.
+std::size_t batch_doc_count(tsv_tensor const& batch)
+{
+    return batch.shape()[0];
+}
+
+std::size_t batch_doc_count(sparse_matrix const& batch)
+{
+    return batch.row_count();
+}
+
+// Trains LDA model with minibatches streamed from given document file. The
+// batches of the updates lda has already gone through are skipped, so that
+// training resumed from a checkpoint continues with the next batch.
+template<typename T>
+void train_online(basic_latent_dirichlet_allocation<T>& lda,
+                  std::map<std::string, docopt::value> const& options,
+                  training_reporter& reporter,
+                  checkpoint_writer& checkpoints)
+{
+    auto const source = make_document_source(options);
+    auto const batch_size = static_cast<std::size_t>(options.at("--batch-size").asLong());
+    auto const pass_count = options.at("--passes").asLong();
+
+    std::size_t const skip_count = lda.update_count();
+    std::size_t batch_index = 0;
+    basic_fit_state<T> const online_state;
+
+    for (long pass = 0; pass < pass_count; ++pass) {
+        for_each_batch(source, batch_size, [&](auto const& batch) {
+            if (batch_index++ < skip_count) {
+                return;
+            }
+
+            auto const start = std::chrono::steady_clock::now();
+            lda.partial_fit(batch);
+            double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            reporter.report_update(lda.update_count(), pass, batch_doc_count(batch), seconds);
+            checkpoints.step(lda, online_state);
+        });
+    }
+}
+
+// Returns true if path has the .json extension.
+bool is_json_path(std::string const& path)
+{
+    std::string const extension = ".json";
+    return path.size() >= extension.size()
+        && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Saves LDA model in the JSON format if the path ends with .json, or in the
+// binary format otherwise.
+template<typename T>
+void save_model(std::string const& path, basic_latent_dirichlet_allocation<T> const& lda)
+{
+    std::ofstream model_file{path, std::ios::binary};
+
+    if (is_json_path(path)) {
+        save_lda(model_file, lda);
+    } else {
+        save_lda_binary(model_file, lda);
+    }
+}
+
 // Trains LDA model with given document.
+template<typename T>
 void train(std::map<std::string, docopt::value> const& options)
 {
-    latent_dirichlet_allocation lda{make_lda_config(options)};
+    auto config = make_lda_config(options);
+    bool const online = options.at("--online").asBool();
+    auto const resume = options.at("--resume");
+
+    // The standard input can be read only once, so it cannot be counted
+    // before training or read in another pass.
+    if (online && options.at("<doc>").asString() == "-"
+        && ((config.corpus_doc_count == 0 && !resume) || options.at("--passes").asLong() != 1)) {
+        throw std::domain_error("online training from the standard input requires --corpus-size and --passes 1");
+    }
+
+    if (online && config.corpus_doc_count == 0 && !resume) {
+        config.corpus_doc_count = count_documents(make_document_source(options));
+    }
+
+    basic_latent_dirichlet_allocation<T> lda{config};
+    basic_fit_state<T> state;
+
+    if (resume) {
+        std::ifstream checkpoint_file{resume.asString(), std::ios::binary};
+        if (!checkpoint_file) {
+            throw std::runtime_error("cannot open file: " + resume.asString());
+        }
+        auto checkpoint = load_lda_checkpoint<T>(checkpoint_file);
+
+        // Batch training saves checkpoints after iterations and online
+        // training after updates.
+        if (online != (checkpoint.state.iteration_count == 0)) {
+            throw std::runtime_error(online ? "checkpoint is not of online training"
+                                            : "checkpoint is of online training; resume it with --online");
+        }
+
+        config = checkpoint.model.get_config();
+        config.thread_count = get_thread_count(options);
+        lda = basic_latent_dirichlet_allocation<T>{
+            config, checkpoint.model.topic_word_dirichlets(), checkpoint.model.update_count()
+        };
+        state = std::move(checkpoint.state);
+    }
+
+    if (online && config.engine != lda_engine::variational) {
+        throw std::domain_error("online training requires the variational engine");
+    }
+
+    training_reporter reporter{options};
+    checkpoint_writer checkpoints{options};
+
+    if (config.engine == lda_engine::gibbs && (checkpoints.enabled() || resume)) {
+        throw std::domain_error("checkpoints require the variational engine");
+    }
+
+    if (online) {
+        train_online(lda, options, reporter, checkpoints);
+    } else if (config.engine == lda_engine::gibbs) {
+        with_documents(make_document_source(options), [&](auto const& documents) {
+            lda.fit(documents, reporter.observer());
+        });
+    } else {
+        with_documents(make_document_source(options), [&](auto const& documents) {
+            fit_observer observer = reporter.observer();
+            auto const report = observer.callback;
+
+            // The model and state are complete after each iteration, when
+            // the observer is called.
+            observer.callback = [&](fit_progress const& progress) {
+                bool const proceed = !report || report(progress);
+                if (!progress.converged) {
+                    checkpoints.step(lda, state);
+                }
+                return proceed;
+            };
+            lda.fit(documents, observer, state);
+        });
+    }
+
+    save_model(options.at("<model>").asString(), lda);
+}
+
+// Loads a trained LDA model and applies runtime options to it.
+template<typename T>
+basic_latent_dirichlet_allocation<T> load_model(std::map<std::string, docopt::value> const& options)
+{
+    std::ifstream model_file{options.at("<model>").asString(), std::ios::binary};
+    auto const lda = load_lda<T>(model_file);
+
+    auto config = lda.get_config();
+    config.thread_count = get_thread_count(options);
+
+    return basic_latent_dirichlet_allocation<T>{config, lda.topic_word_dirichlets(), lda.update_count()};
+}
+
+// Loads a trained LDA model for inference. A binary model file is mapped
+// and its inference table is used in place.
+template<typename T>
+basic_lda_inference<T> load_inference(std::map<std::string, docopt::value> const& options)
+{
+    std::string const path = options.at("<model>").asString();
+    std::ifstream model_file{path, std::ios::binary};
+
+    if (!is_binary_lda(model_file)) {
+        return basic_lda_inference<T>{load_model<T>(options)};
+    }
 
-    std::ifstream document_file{options.at("<doc>").asString()};
-    auto const document = load_tsv(document_file);
-    lda.fit(document);
+    basic_lda_inference<T> inference{std::make_shared<mapped_lda const>(path)};
+    inference.set_thread_count(get_thread_count(options));
+    return inference;
+}
+
+// Batch of documents in either representation, passed between the stages
+// of classify.
+struct document_batch
+{
+    bool is_sparse = false;
+    tsv_tensor dense;
+    sparse_matrix sparse;
+};
+
+document_batch make_document_batch(tsv_tensor dense)
+{
+    document_batch batch;
+    batch.dense = std::move(dense);
+    return batch;
+}
+
+document_batch make_document_batch(sparse_matrix sparse)
+{
+    document_batch batch;
+    batch.is_sparse = true;
+    batch.sparse = std::move(sparse);
+    return batch;
+}
+
+// How classify writes the document-topic parameters.
+struct output_options
+{
+    // "tsv", "top" for the largest topics of each document as sparse
+    // topic:weight pairs, or "binary" for raw float32 arrays.
+    std::string format;
+
+    // Whether to normalize the parameters to topic proportions. The top
+    // format always writes proportions.
+    bool proportions = false;
+
+    // The number of topics per document in the top format.
+    std::size_t top_count = 3;
+
+    // Significant digits of the numbers in text, or 0 for the shortest.
+    int precision = 6;
+};
+
+// Creates output options based on docopt options.
+output_options make_output_options(std::map<std::string, docopt::value> const& options)
+{
+    output_options output;
+    output.format = options.at("--output").asString();
+    output.proportions = options.at("--proportions").asBool() || output.format == "top";
+    output.top_count = static_cast<std::size_t>(options.at("--top").asLong());
+    output.precision = static_cast<int>(options.at("--precision").asLong());
+
+    if (output.format != "tsv" && output.format != "top" && output.format != "binary") {
+        throw std::domain_error("unknown output format: " + output.format);
+    }
 
-    std::ofstream model_file{options.at("<model>").asString()};
-    save_lda(model_file, lda);
+    return output;
 }
 
-// Classifies given document using a trained LDA model.
+// Writes document-topic parameters, topic_count values for each document in
+// row-major order, in given format.
+template<typename T>
+void write_doc_topics(tsv_writer& writer,
+                      T const* doc_topics,
+                      std::size_t doc_count,
+                      std::size_t topic_count,
+                      output_options const& output)
+{
+    std::size_t const top_count = std::min(output.top_count, topic_count);
+
+    std::vector<T> row(topic_count);
+    std::vector<float> binary_row(topic_count);
+    std::vector<std::size_t> order(topic_count);
+
+    for (std::size_t doc = 0; doc < doc_count; ++doc) {
+        T const* params = doc_topics + doc * topic_count;
+        std::copy(params, params + topic_count, row.begin());
+
+        if (output.proportions) {
+            T const sum = std::accumulate(row.begin(), row.end(), T(0));
+            for (T& value : row) {
+                value /= sum;
+            }
+        }
+
+        if (output.format == "binary") {
+            std::copy(row.begin(), row.end(), binary_row.begin());
+            writer.write(reinterpret_cast<char const*>(binary_row.data()), topic_count * sizeof(float));
+            continue;
+        }
+
+        if (output.format == "top") {
+            std::iota(order.begin(), order.end(), std::size_t{0});
+            std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(top_count), order.end(),
+                              [&](std::size_t a, std::size_t b) { return row[a] > row[b] || (row[a] == row[b] && a < b); });
+
+            for (std::size_t i = 0; i < top_count; ++i) {
+                writer.write(order[i]);
+                writer.put(':');
+                writer.write(row[order[i]]);
+                writer.put(i + 1 == top_count ? '\n' : '\t');
+            }
+            if (top_count == 0) {
+                writer.put('\n');
+            }
+            continue;
+        }
+
+        for (std::size_t topic = 0; topic < topic_count; ++topic) {
+            writer.write(row[topic]);
+            writer.put(topic + 1 == topic_count ? '\n' : '\t');
+        }
+    }
+}
+
+// Thrown in the reading stage of classify to stop reading after a later
+// stage has stopped.
+struct pipeline_stopped
+{
+};
+
+// Classifies given document using a trained LDA model. Batches of documents
+// go through a three-stage pipeline: reading and parsing, inference, and
+// output, each on its own thread. At most two batches wait between stages,
+// so memory use does not grow with the input and the results of each batch
+// are written as soon as they are ready.
+template<typename T>
 void classify(std::map<std::string, docopt::value> const& options)
 {
-    std::ifstream model_file{options.at("<model>").asString()};
-    auto const lda = load_lda(model_file);
+    basic_lda_inference<T> const inference = load_inference<T>(options);
+    auto const source = make_document_source(options, inference.word_count());
+    auto const batch_size = static_cast<std::size_t>(options.at("--batch-size").asLong());
+    auto const output = make_output_options(options);
+
+    bounded_queue<document_batch> parsed{2};
+    bounded_queue<xt::xtensor<T, 2>> classified{2};
 
-    std::ifstream document_file{options.at("<doc>").asString()};
-    auto const document = load_tsv(document_file);
+    auto reading = std::async(std::launch::async, [&] {
+        try {
+            for_each_batch(source, batch_size, [&](auto&& batch) {
+                if (!parsed.push(make_document_batch(std::move(batch)))) {
+                    throw pipeline_stopped{};
+                }
+            });
+        } catch (pipeline_stopped const&) {
+        } catch (...) {
+            parsed.close();
+            throw;
+        }
+        parsed.close();
+    });
+
+    auto writing = std::async(std::launch::async, [&] {
+        try {
+            tsv_writer writer{std::cout, output.precision};
+
+            for (xt::xtensor<T, 2> result; classified.pop(result); ) {
+                write_doc_topics(writer, result.raw_data(), result.shape()[0], result.shape()[1], output);
+                writer.flush();
+            }
+        } catch (...) {
+            classified.close();
+            throw;
+        }
+    });
+
+    std::exception_ptr error;
+    try {
+        for (document_batch batch; parsed.pop(batch); ) {
+            auto result = batch.is_sparse ? inference.transform(batch.sparse) : inference.transform(batch.dense);
+            if (!classified.push(std::move(result))) {
+                break;
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
 
-    save_tsv(std::cout, lda.transform(document));
+    parsed.close();
+    classified.close();
+    reading.get();
+    writing.get();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Estimates the document terms of log-likelihood of a dense or sparse batch.
+// Sparse batches are scored in workspace, which keeps its buffers and
+// threads between batches.
+template<typename T>
+double document_score(basic_latent_dirichlet_allocation<T> const& lda,
+                      xt::xtensor<double, 2> const& batch,
+                      inference_workspace&)
+{
+    return lda.document_score(batch);
+}
+
+template<typename T>
+double document_score(basic_latent_dirichlet_allocation<T> const& lda,
+                      sparse_matrix const& batch,
+                      inference_workspace& workspace)
+{
+    return lda.document_score(batch, workspace);
+}
+
+// Estimates the log-likelihood of given document using a trained LDA model.
+// Documents are streamed in batches, so only a batch is kept in memory.
+template<typename T>
+void score(std::map<std::string, docopt::value> const& options)
+{
+    auto const lda = load_model<T>(options);
+    auto const batch_size = static_cast<std::size_t>(options.at("--batch-size").asLong());
+
+    double log_likelihood = lda.topic_score();
+
+    auto const source = make_document_source(options, lda.topic_word_dirichlets().shape()[1]);
+
+    inference_workspace workspace;
+    for_each_batch(source, batch_size, [&](auto const& batch) {
+        log_likelihood += document_score(lda, batch, workspace);
+    });
+
+    std::cout.precision(std::numeric_limits<double>::max_digits10);
+    std::cout << log_likelihood << '\n';
+}
+
+// Parses a request line of serve into a document with word_count columns.
+// The line is a TSV row of word counts, or a libsvm line if the source
+// format is libsvm.
+sparse_matrix parse_request(std::string const& line, document_source const& source)
+{
+    if (source.format == "libsvm") {
+        std::istringstream input{line};
+        sparse_matrix document = libsvm_reader{input, source.index_base, source.word_count}.read(1);
+
+        if (document.col_count() != source.word_count) {
+            throw std::runtime_error("word index out of range");
+        }
+        if (document.row_count() == 0) {
+            return sparse_matrix{source.word_count, {0, 0}, {}, {}};
+        }
+        return document;
+    }
+
+    std::vector<sparse_matrix::index_type> col_indices;
+    std::vector<double> values;
+    std::size_t col_count = 0;
+
+    auto const is_delim = [](char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; };
+    char const* p = line.data();
+    char const* const end = p + line.size();
+
+    for (;;) {
+        char const* const token_begin = std::find_if_not(p, end, is_delim);
+        if (token_begin == end) {
+            break;
+        }
+        p = std::find_if(token_begin, end, is_delim);
+
+        double value;
+        if (!parse_tsv_number(token_begin, p, value)) {
+            throw std::runtime_error("malformed number");
+        }
+        if (value != 0 && col_count < source.word_count) {
+            col_indices.push_back(static_cast<sparse_matrix::index_type>(col_count));
+            values.push_back(value);
+        }
+        col_count++;
+    }
+
+    if (col_count != source.word_count) {
+        throw std::runtime_error("expected " + std::to_string(source.word_count) + " columns");
+    }
+
+    sparse_matrix::offset_type const nonzero_count = values.size();
+    return sparse_matrix{col_count, {0, nonzero_count}, std::move(col_indices), std::move(values)};
+}
+
+// Inference server of serve. Requests from all the connections go through
+// a micro_batcher, so concurrent requests share a call to transform.
+template<typename T>
+class inference_server
+{
+  public:
+    explicit inference_server(std::map<std::string, docopt::value> const& options)
+        : inference_{load_inference<T>(options)}
+        , output_{make_output_options(options)}
+        , batcher_{static_cast<std::size_t>(options.at("--batch-size").asLong()),
+                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                       std::chrono::duration<double, std::milli>{std::stod(options.at("--max-latency").asString())}),
+                   [this](std::vector<sparse_matrix>& documents) { return classify(documents); }}
+    {
+        source_.format = options.at("--format").asString();
+        source_.index_base = options.at("--zero-based").asBool() ? 0 : 1;
+        source_.word_count = inference_.word_count();
+
+        if (source_.format != "tsv" && source_.format != "libsvm") {
+            throw std::domain_error("serve reads tsv or libsvm requests: " + source_.format);
+        }
+        if (output_.format == "binary") {
+            throw std::domain_error("serve writes tsv or top responses");
+        }
+    }
+
+    // Returns the response to a request line, without the newline. The
+    // future throws if the request is malformed or fails.
+    std::future<std::string> handle(std::string const& line)
+    {
+        std::promise<std::string> response;
+
+        try {
+            if (line == "#stats") {
+                response.set_value(stats());
+            } else {
+                return batcher_.submit(parse_request(line, source_));
+            }
+        } catch (...) {
+            response.set_exception(std::current_exception());
+        }
+        return response.get_future();
+    }
+
+    // Returns the request and latency counters as a JSON object.
+    std::string stats() const
+    {
+        batcher_stats const stats = batcher_.stats();
+        double const request_count = static_cast<double>(stats.request_count);
+        double const elapsed = std::max(stats.elapsed_seconds, 1e-9);
+
+        return nlohmann::json{
+            {"requests", stats.request_count},
+            {"batches", stats.batch_count},
+            {"errors", stats.error_count},
+            {"mean_batch_size", stats.batch_count == 0 ? 0 : request_count / static_cast<double>(stats.batch_count)},
+            {"requests_per_second", request_count / elapsed},
+            {"busy_fraction", stats.busy_seconds / elapsed},
+            {"latency_ms", {
+                {"mean", stats.mean_latency * 1e3},
+                {"p50", stats.p50_latency * 1e3},
+                {"p99", stats.p99_latency * 1e3},
+                {"max", stats.max_latency * 1e3},
+            }},
+        }.dump();
+    }
+
+  private:
+    // Classifies a batch of one-row documents into response lines.
+    std::vector<std::string> classify(std::vector<sparse_matrix> const& documents)
+    {
+        std::vector<sparse_matrix::offset_type> row_offsets = {0};
+        std::vector<sparse_matrix::index_type> col_indices;
+        std::vector<double> values;
+
+        for (sparse_matrix const& document : documents) {
+            auto const row = document.row(0);
+            col_indices.insert(col_indices.end(), row.indices, row.indices + row.size);
+            values.insert(values.end(), row.values, row.values + row.size);
+            row_offsets.push_back(values.size());
+        }
+
+        sparse_matrix const batch{source_.word_count, std::move(row_offsets), std::move(col_indices), std::move(values)};
+        T const* const doc_topics = inference_.transform(batch, workspace_);
+
+        std::stringstream text;
+        tsv_writer writer{text, output_.precision};
+        write_doc_topics(writer, doc_topics, batch.row_count(), inference_.topic_count(), output_);
+        writer.flush();
+
+        std::vector<std::string> responses;
+        responses.reserve(documents.size());
+
+        for (std::string line; std::getline(text, line); ) {
+            responses.push_back(std::move(line));
+        }
+        return responses;
+    }
+
+  private:
+    basic_lda_inference<T> const inference_;
+    output_options const output_;
+    document_source source_;
+
+    // Buffers of classify, which runs only on the batching thread.
+    inference_workspace workspace_;
+
+    // Declared last to stop the batching thread before the rest is
+    // destroyed.
+    micro_batcher<sparse_matrix, std::string> batcher_;
+};
+
+// Serves the requests of a connection. Lines are read by read_line(line)
+// and each response line is passed to write(response). Requests are
+// submitted as soon as they are read and responses are written in order on
+// another thread, so a client can send many requests without waiting and
+// they are batched together.
+template<typename T, typename ReadLine, typename Write>
+void serve_connection(inference_server<T>& server, ReadLine&& read_line, Write&& write)
+{
+    bounded_queue<std::future<std::string>> responses{4096};
+
+    auto writing = std::async(std::launch::async, [&] {
+        try {
+            for (std::future<std::string> response; responses.pop(response); ) {
+                std::string text;
+                try {
+                    text = response.get();
+                } catch (std::exception const& e) {
+                    text = std::string{"error: "} + e.what();
+                }
+                write(std::move(text));
+            }
+        } catch (...) {
+            responses.close();
+            throw;
+        }
+    });
+
+    std::exception_ptr error;
+    try {
+        for (std::string line; read_line(line); ) {
+            if (!responses.push(server.handle(line))) {
+                break;
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    responses.close();
+    writing.get();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Listener stopped by SIGINT and SIGTERM.
+static std::atomic<unix_listener*> signaled_listener{nullptr};
+
+extern "C" void stop_listener(int)
+{
+    if (unix_listener* const listener = signaled_listener.load()) {
+        listener->stop();
+    }
+}
+
+// Serves the clients connecting to a Unix domain socket on a thread per
+// connection until SIGINT or SIGTERM.
+template<typename T>
+void serve_socket(inference_server<T>& server, std::string const& path)
+{
+    unix_listener listener{path};
+
+    signaled_listener = &listener;
+    std::signal(SIGINT, stop_listener);
+    std::signal(SIGTERM, stop_listener);
+
+    struct client
+    {
+        std::shared_ptr<unix_connection> connection;
+        std::future<void> serving;
+    };
+    std::vector<client> clients;
+
+    auto const finish = [](client& c) {
+        try {
+            c.serving.get();
+        } catch (std::exception const& e) {
+            std::cerr << "error: " << e.what() << '\n';
+        }
+    };
+
+    std::exception_ptr error;
+    try {
+        while (std::shared_ptr<unix_connection> connection = listener.accept()) {
+            auto const finished = std::partition(clients.begin(), clients.end(), [](client const& c) {
+                return c.serving.wait_for(std::chrono::seconds{0}) != std::future_status::ready;
+            });
+            std::for_each(finished, clients.end(), finish);
+            clients.erase(finished, clients.end());
+
+            auto serving = std::async(std::launch::async, [&server, connection] {
+                serve_connection(server,
+                                 [&](std::string& line) { return connection->read_line(line); },
+                                 [&](std::string response) {
+                                     response += '\n';
+                                     connection->write(response.data(), response.size());
+                                 });
+            });
+            clients.push_back({connection, std::move(serving)});
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    signaled_listener = nullptr;
+
+    for (client& c : clients) {
+        c.connection->shutdown();
+        finish(c);
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Serves classification requests with a trained LDA model loaded once. The
+// requests are read from the standard input until its end, or from the
+// clients of a Unix domain socket until SIGINT or SIGTERM. The counters are
+// printed to the standard error at exit.
+template<typename T>
+void serve(std::map<std::string, docopt::value> const& options)
+{
+    inference_server<T> server{options};
+
+    if (options.at("--socket")) {
+        serve_socket(server, options.at("--socket").asString());
+    } else {
+        serve_connection(server,
+                         [](std::string& line) { return static_cast<bool>(std::getline(std::cin, line)); },
+                         [](std::string const& response) {
+                             if (!(std::cout << response << '\n' << std::flush)) {
+                                 throw std::runtime_error("cannot write output");
+                             }
+                         });
+    }
+
+    std::cerr << server.stats() << '\n';
 }
 
 // Prints the topic-word diciehlet parameters of a trained LDA model.
 void show_topics(std::map<std::string, docopt::value> const& options)
 {
-    std::ifstream model_file{options.at("<model>").asString()};
+    std::ifstream model_file{options.at("<model>").asString(), std::ios::binary};
     auto const lda = load_lda(model_file);
 
-    save_tsv(std::cout, lda.topic_word_dirichlets());
+    save_tsv(std::cout, lda.topic_word_dirichlets(), static_cast<int>(options.at("--precision").asLong()));
+}
+
+// Saves a trained LDA model in the JSON format.
+void export_json(std::map<std::string, docopt::value> const& options)
+{
+    std::string const path = options.at("<model>").asString();
+    std::ifstream model_file{path, std::ios::binary};
+
+    // Keep the precision of a binary model.
+    bool const float32 = is_binary_lda(model_file) && mapped_lda{path}.scalar_size() == sizeof(float);
+
+    std::ofstream json_file{options.at("<json>").asString()};
+    if (float32) {
+        save_lda(json_file, load_lda<float>(model_file));
+    } else {
+        save_lda(json_file, load_lda<double>(model_file));
+    }
+}
+
+// Converts a document file to the binary corpus format. The file is read
+// in chunks and only the nonzero elements are kept in memory.
+void convert(std::map<std::string, docopt::value> const& options)
+{
+    auto const source = make_document_source(options);
+
+    if (source.format != "tsv") {
+        std::ofstream bin_file{options.at("<bin>").asString(), std::ios::binary};
+        save_sparse_matrix(bin_file, load_sparse_documents(source));
+        return;
+    }
+
+    std::size_t const chunk_size = 4096;
+    std::size_t col_count = 0;
+    std::vector<sparse_matrix::offset_type> row_offsets = {0};
+    std::vector<sparse_matrix::index_type> col_indices;
+    std::vector<double> values;
+
+    std::ifstream file;
+    tsv_reader reader{open_documents(source, file), source.thread_count};
+
+    for (;;) {
+        auto const chunk = reader.read(chunk_size);
+        if (chunk.shape()[0] == 0) {
+            break;
+        }
+
+        if (row_offsets.size() == 1) {
+            col_count = chunk.shape()[1];
+        } else if (chunk.shape()[1] != col_count) {
+            throw std::runtime_error("inconsistent number of columns");
+        }
+
+        for (std::size_t row = 0; row < chunk.shape()[0]; ++row) {
+            for (std::size_t col = 0; col < col_count; ++col) {
+                if (chunk(row, col) != 0) {
+                    col_indices.push_back(static_cast<sparse_matrix::index_type>(col));
+                    values.push_back(chunk(row, col));
+                }
+            }
+            row_offsets.push_back(values.size());
+        }
+    }
+
+    sparse_matrix const corpus{col_count, std::move(row_offsets), std::move(col_indices), std::move(values)};
+
+    std::ofstream bin_file{options.at("<bin>").asString(), std::ios::binary};
+    save_sparse_matrix(bin_file, corpus);
+}
+
+// Writes the profiling report requested by --profile.
+void write_profile(std::string const& path)
+{
+    std::ofstream file{path};
+    profiling::write_report(file);
+    if (!file) {
+        throw std::runtime_error("cannot write file: " + path);
+    }
 }
 
 // Analyzes docopt options and run the appropriate subcommand.
 void dispatch(std::map<std::string, docopt::value> const& options)
 {
+    bool const float32 = options.at("--float32").asBool();
+
     if (options.at("train").asBool()) {
-        return train(options);
+        return float32 ? train<float>(options) : train<double>(options);
     }
 
     if (options.at("classify").asBool()) {
-        return classify(options);
+        return float32 ? classify<float>(options) : classify<double>(options);
+    }
+
+    if (options.at("score").asBool()) {
+        return float32 ? score<float>(options) : score<double>(options);
     }
 
     if (options.at("show-topics").asBool()) {
         return show_topics(options);
     }
 
+    if (options.at("export-json").asBool()) {
+        return export_json(options);
+    }
+
+    if (options.at("convert").asBool()) {
+        return convert(options);
+    }
+
+    if (options.at("serve").asBool()) {
+        return float32 ? serve<float>(options) : serve<double>(options);
+    }
+
     throw std::logic_error("unhandled subcommand");
 }
 
 int main(int argc, char** argv)
 {
+    // Buffered standard streams let the TSV reader take the input as it
+    // arrives through a pipe. Untying std::cin keeps the reading thread of
+    // classify from flushing std::cout while another thread writes to it.
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
     try {
-        dispatch(docopt::docopt(usage, {argv + 1, argv + argc}, true, version));
+        auto const options = docopt::docopt(usage, {argv + 1, argv + argc}, true, version);
+
+        auto const profile = options.at("--profile");
+        if (profile && !profiling::enabled()) {
+            throw std::runtime_error("--profile requires a build with LDA_PROFILE");
+        }
+
+        dispatch(options);
+
+        if (profile) {
+            write_profile(profile.asString());
+        }
     } catch (std::exception const& e)  {
         std::cerr << "error: " << e.what() << '\n';
         return EXIT_FAILURE;
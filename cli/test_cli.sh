@@ -0,0 +1,41 @@
+#!/bin/sh
+# Tests of the lda command line. Usage: test_cli.sh <lda executable>
+
+lda="$1"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failures=0
+
+# Reports a failure of the test named $1.
+fail()
+{
+    echo "FAILED: $1"
+    failures=$((failures + 1))
+}
+
+printf '4\t0\t1\t0\n3\t1\t0\t0\n0\t0\t5\t2\n0\t1\t4\t3\n5\t1\t0\t1\n0\t0\t3\t4\n' > "$work/docs.tsv"
+
+# Online training reads the standard input once, so it needs the corpus
+# size and a single pass.
+if "$lda" train --online --topics 2 - "$work/model.json" < "$work/docs.tsv" 2> "$work/error.txt"; then
+    fail "online training from stdin without --corpus-size"
+elif ! grep -q -- "--corpus-size" "$work/error.txt"; then
+    fail "error message of online training from stdin"
+fi
+
+if "$lda" train --online --topics 2 --corpus-size 6 --passes 2 - "$work/model.json" < "$work/docs.tsv" 2> /dev/null; then
+    fail "online training from stdin with --passes 2"
+fi
+
+cat "$work/docs.tsv" | "$lda" train --online --topics 2 --batch-size 2 --corpus-size 6 - "$work/stdin.json" \
+    || fail "online training from stdin with --corpus-size"
+"$lda" train --online --topics 2 --batch-size 2 "$work/docs.tsv" "$work/file.json" \
+    || fail "online training from a file"
+cmp -s "$work/stdin.json" "$work/file.json" \
+    || fail "online training from stdin and from a file give the same model"
+
+"$lda" train --online --topics 2 --passes 2 "$work/docs.tsv" "$work/passes.json" \
+    || fail "online training from a file in two passes"
+
+exit $((failures != 0))
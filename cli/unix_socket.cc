@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "unix_socket.hpp"
+
+
+namespace
+{
+    std::string error_message(std::string const& what)
+    {
+        return what + ": " + std::strerror(errno);
+    }
+}
+
+unix_connection::unix_connection(int fd)
+    : fd_{fd}
+    , buffer_(1 << 16)
+{
+}
+
+unix_connection::~unix_connection()
+{
+    ::close(fd_);
+}
+
+bool unix_connection::read_line(std::string& line)
+{
+    for (;;) {
+        auto const begin = buffer_.begin() + static_cast<std::ptrdiff_t>(begin_);
+        auto const end = buffer_.begin() + static_cast<std::ptrdiff_t>(end_);
+        auto const newline = std::find(begin, end, '\n');
+
+        if (newline != end) {
+            line.assign(begin, newline);
+            begin_ = static_cast<std::size_t>(newline - buffer_.begin()) + 1;
+            return true;
+        }
+
+        // Move the partial line to the front, growing the buffer if the line
+        // fills it.
+        std::copy(begin, end, buffer_.begin());
+        end_ -= begin_;
+        begin_ = 0;
+        if (end_ == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+
+        ssize_t const size = ::recv(fd_, buffer_.data() + end_, buffer_.size() - end_, 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0) {
+            throw std::runtime_error(error_message("cannot read socket"));
+        }
+
+        if (size == 0) {
+            if (end_ == 0) {
+                return false;
+            }
+            line.assign(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(end_));
+            end_ = 0;
+            return true;
+        }
+
+        end_ += static_cast<std::size_t>(size);
+    }
+}
+
+void unix_connection::write(char const* data, std::size_t size)
+{
+    while (size != 0) {
+        // MSG_NOSIGNAL reports a closed peer as EPIPE instead of SIGPIPE.
+        ssize_t const written = ::send(fd_, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            throw std::runtime_error(error_message("cannot write socket"));
+        }
+
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+void unix_connection::shutdown()
+{
+    ::shutdown(fd_, SHUT_RDWR);
+}
+
+unix_listener::unix_listener(std::string path)
+    : path_{std::move(path)}
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof address.sun_path) {
+        throw std::runtime_error("socket path is too long: " + path_);
+    }
+    std::copy(path_.begin(), path_.end(), address.sun_path);
+
+    // A socket file left by a killed server would make bind fail.
+    struct stat status;
+    if (::lstat(path_.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        ::unlink(path_.c_str());
+    }
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error(error_message("cannot create socket"));
+    }
+
+    if (::bind(fd_, reinterpret_cast<sockaddr const*>(&address), sizeof address) != 0
+        || ::listen(fd_, SOMAXCONN) != 0) {
+        std::string const message = error_message("cannot listen at " + path_);
+        ::close(fd_);
+        throw std::runtime_error(message);
+    }
+
+    if (::pipe2(stop_pipe_, O_CLOEXEC) != 0) {
+        std::string const message = error_message("cannot create pipe");
+        ::close(fd_);
+        ::unlink(path_.c_str());
+        throw std::runtime_error(message);
+    }
+}
+
+unix_listener::~unix_listener()
+{
+    ::close(fd_);
+    ::close(stop_pipe_[0]);
+    ::close(stop_pipe_[1]);
+    ::unlink(path_.c_str());
+}
+
+std::unique_ptr<unix_connection> unix_listener::accept()
+{
+    for (;;) {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(error_message("cannot wait for connections"));
+        }
+
+        if (fds[1].revents != 0) {
+            return nullptr;
+        }
+
+        int const connection = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection >= 0) {
+            return std::make_unique<unix_connection>(connection);
+        }
+
+        // The peer may have given up before the connection was accepted.
+        if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+            throw std::runtime_error(error_message("cannot accept connection"));
+        }
+    }
+}
+
+void unix_listener::stop() noexcept
+{
+    char const byte = 0;
+    ssize_t const written = ::write(stop_pipe_[1], &byte, 1);
+    static_cast<void>(written);
+}
@@ -0,0 +1,74 @@
+#ifndef INCLUDED_UNIX_SOCKET_HPP
+#define INCLUDED_UNIX_SOCKET_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Connected Unix domain stream socket carrying a line protocol.
+class unix_connection
+{
+  public:
+    // Takes ownership of a connected socket.
+    explicit unix_connection(int fd);
+
+    // Closes the socket.
+    ~unix_connection();
+
+    unix_connection(unix_connection const&) = delete;
+    unix_connection& operator=(unix_connection const&) = delete;
+
+    // Reads a line without the '\n'. Returns false at the end of the
+    // stream. Throws std::runtime_error if reading fails.
+    bool read_line(std::string& line);
+
+    // Writes size bytes of data. Throws std::runtime_error if writing
+    // fails, such as when the peer has closed the connection.
+    void write(char const* data, std::size_t size);
+
+    // Shuts down both directions of the connection, so that read_line in
+    // another thread returns false.
+    void shutdown();
+
+  private:
+    int fd_;
+
+    // Received text not returned yet is in [begin_, end_) of buffer_.
+    std::vector<char> buffer_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+};
+
+// Unix domain stream socket listening at a path.
+class unix_listener
+{
+  public:
+    // Listens at path, replacing a stale socket left there. Throws
+    // std::runtime_error if the socket cannot be created.
+    explicit unix_listener(std::string path);
+
+    // Closes the socket and removes it from the file system.
+    ~unix_listener();
+
+    unix_listener(unix_listener const&) = delete;
+    unix_listener& operator=(unix_listener const&) = delete;
+
+    // Waits for a connection. Returns nullptr after stop is called.
+    std::unique_ptr<unix_connection> accept();
+
+    // Makes accept return nullptr. It is async-signal-safe, so a signal
+    // handler can call it.
+    void stop() noexcept;
+
+  private:
+    std::string path_;
+    int fd_ = -1;
+
+    // Pipe written by stop to wake up accept.
+    int stop_pipe_[2] = {-1, -1};
+};
+
+
+#endif
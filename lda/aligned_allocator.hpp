@@ -0,0 +1,60 @@
+#ifndef INCLUDED_ALIGNED_ALLOCATOR_HPP
+#define INCLUDED_ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+
+// Allocator returning memory aligned to Alignment bytes, e.g. to a cache
+// line. The pointer obtained from operator new is stored right before the
+// aligned block.
+template<typename T, std::size_t Alignment>
+class aligned_allocator
+{
+  public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    template<typename U>
+    aligned_allocator(aligned_allocator<U, Alignment> const&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        void* const block = ::operator new(n * sizeof(T) + Alignment + sizeof(void*));
+
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+        address = (address + Alignment - 1) / Alignment * Alignment;
+        reinterpret_cast<void**>(address)[-1] = block;
+
+        return reinterpret_cast<T*>(address);
+    }
+
+    void deallocate(T* ptr, std::size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+    }
+};
+
+template<typename T, typename U, std::size_t Alignment>
+bool operator==(aligned_allocator<T, Alignment> const&, aligned_allocator<U, Alignment> const&)
+{
+    return true;
+}
+
+template<typename T, typename U, std::size_t Alignment>
+bool operator!=(aligned_allocator<T, Alignment> const&, aligned_allocator<U, Alignment> const&)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "arena.hpp"
+
+
+namespace
+{
+    // Size of the first block in bytes.
+    constexpr std::size_t min_block_size = 4096;
+}
+
+void arena::reset()
+{
+    if (blocks_.size() > 1) {
+        std::size_t const size = total_used_;
+        blocks_.clear();
+        add_block(size);
+    }
+    block_used_ = 0;
+    total_used_ = 0;
+}
+
+std::size_t arena::capacity() const
+{
+    std::size_t result = 0;
+    for (block const& b : blocks_) {
+        result += b.size();
+    }
+    return result;
+}
+
+std::size_t arena::heap_allocation_count() const
+{
+    return heap_allocation_count_;
+}
+
+void* arena::allocate_bytes(std::size_t size)
+{
+    size = (size + alignment - 1) / alignment * alignment;
+
+    if (blocks_.empty() || blocks_.back().size() - block_used_ < size) {
+        // Blocks grow geometrically, so a growing sequence of allocations
+        // takes a logarithmic number of blocks.
+        add_block(std::max({size, capacity(), min_block_size}));
+        block_used_ = 0;
+    }
+
+    void* const result = blocks_.back().data() + block_used_;
+    block_used_ += size;
+    total_used_ += size;
+    return result;
+}
+
+void arena::add_block(std::size_t size)
+{
+    blocks_.emplace_back(size);
+    heap_allocation_count_++;
+}
@@ -0,0 +1,66 @@
+#ifndef INCLUDED_ARENA_HPP
+#define INCLUDED_ARENA_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+
+
+// Bump allocator of scratch buffers that are released all at once. Each
+// allocation starts at a cache line boundary. Memory is kept on reset, and
+// when the allocations since the last reset did not fit in one block, the
+// next reset replaces the blocks with one block of their total size. So
+// repeating a sequence of allocations of the same or smaller sizes between
+// resets allocates nothing from the heap.
+class arena
+{
+  public:
+    // Alignment of every allocation in bytes.
+    static constexpr std::size_t alignment = 64;
+
+    arena() = default;
+
+    arena(arena&&) = default;
+    arena& operator=(arena&&) = default;
+
+    // Returns uninitialized storage for count values of type T, valid until
+    // the next reset.
+    template<typename T>
+    T* allocate(std::size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena does not destroy values");
+        static_assert(alignof(T) <= alignment, "T is overaligned");
+        return static_cast<T*>(allocate_bytes(count * sizeof(T)));
+    }
+
+    // Releases all the allocations.
+    void reset();
+
+    // Returns the total size of the blocks in bytes.
+    std::size_t capacity() const;
+
+    // Returns the number of blocks allocated from the heap so far.
+    std::size_t heap_allocation_count() const;
+
+  private:
+    using block = std::vector<unsigned char, aligned_allocator<unsigned char, alignment>>;
+
+    void* allocate_bytes(std::size_t size);
+
+    // Appends a block of given size.
+    void add_block(std::size_t size);
+
+  private:
+    std::vector<block> blocks_;
+
+    // Bytes used in the last block and in all the blocks since the last
+    // reset.
+    std::size_t block_used_ = 0;
+    std::size_t total_used_ = 0;
+
+    std::size_t heap_allocation_count_ = 0;
+};
+
+#endif
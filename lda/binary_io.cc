@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary_io.hpp"
+
+
+std::size_t align_binary_size(std::size_t size)
+{
+    return (size + binary_alignment - 1) / binary_alignment * binary_alignment;
+}
+
+memory_map::memory_map(std::string const& path)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || status.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot map file: " + path);
+    }
+
+    size_ = static_cast<std::size_t>(status.st_size);
+    address_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (address_ == MAP_FAILED) {
+        throw std::runtime_error("cannot map file: " + path);
+    }
+}
+
+memory_map::~memory_map()
+{
+    ::munmap(address_, size_);
+}
+
+unsigned char const* memory_map::data() const
+{
+    return static_cast<unsigned char const*>(address_);
+}
+
+std::size_t memory_map::size() const
+{
+    return size_;
+}
+
+void checksum_builder::add(unsigned char const* data, std::size_t size)
+{
+    std::size_t i = 0;
+
+    if (pending_size_ != 0) {
+        i = std::min(size, sizeof pending_ - pending_size_);
+        std::memcpy(pending_ + pending_size_, data, i);
+        pending_size_ += i;
+
+        if (pending_size_ == sizeof pending_) {
+            mix(pending_);
+            pending_size_ = 0;
+        }
+    }
+
+    for (; i + sizeof pending_ <= size; i += sizeof pending_) {
+        mix(data + i);
+    }
+
+    // pending_ is empty here unless all the data has been consumed.
+    if (i < size) {
+        pending_size_ = size - i;
+        std::memcpy(pending_, data + i, pending_size_);
+    }
+}
+
+std::uint64_t checksum_builder::value() const
+{
+    return hash_;
+}
+
+void checksum_builder::mix(unsigned char const* bytes)
+{
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof word);
+    hash_ = (hash_ ^ word) * 0x100000001b3;
+}
+
+std::uint64_t compute_checksum(unsigned char const* data, std::size_t size)
+{
+    checksum_builder checksum;
+    checksum.add(data, size);
+    return checksum.value();
+}
@@ -0,0 +1,67 @@
+#ifndef INCLUDED_BINARY_IO_HPP
+#define INCLUDED_BINARY_IO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Helpers shared by the binary model and corpus formats.
+
+// Alignment of the arrays in binary files in bytes.
+constexpr std::size_t binary_alignment = 64;
+
+// Rounds size up to a multiple of binary_alignment.
+std::size_t align_binary_size(std::size_t size);
+
+// Read-only memory mapping of a whole file.
+class memory_map
+{
+  public:
+    // Maps a file. Throws std::runtime_error if the file cannot be opened or
+    // mapped, or is empty.
+    explicit memory_map(std::string const& path);
+
+    // Unmaps the file.
+    ~memory_map();
+
+    memory_map(memory_map const&) = delete;
+    memory_map& operator=(memory_map const&) = delete;
+
+    // Returns the first byte of the file, which is aligned to a page.
+    unsigned char const* data() const;
+
+    // Returns the size of the file in bytes.
+    std::size_t size() const;
+
+  private:
+    void* address_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// 64-bit FNV-1a hash taking 8-byte words instead of bytes, so that the
+// checksum of a large file is computed at memory speed. Data can be added
+// in pieces of any size but the total size must be a multiple of 8 bytes.
+class checksum_builder
+{
+  public:
+    // Adds size bytes of data.
+    void add(unsigned char const* data, std::size_t size);
+
+    // Returns the checksum of the data added so far.
+    std::uint64_t value() const;
+
+  private:
+    // Mixes an 8-byte word into the hash.
+    void mix(unsigned char const* bytes);
+
+  private:
+    std::uint64_t hash_ = 0xcbf29ce484222325;
+    unsigned char pending_[8] = {};
+    std::size_t pending_size_ = 0;
+};
+
+// Computes the checksum of size bytes, which is a multiple of 8.
+std::uint64_t compute_checksum(unsigned char const* data, std::size_t size);
+
+#endif
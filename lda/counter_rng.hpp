@@ -0,0 +1,48 @@
+#ifndef INCLUDED_COUNTER_RNG_HPP
+#define INCLUDED_COUNTER_RNG_HPP
+
+#include <cstdint>
+#include <limits>
+
+
+// Counter-based random numbers. The n-th number of the stream of a key is a
+// pure function of the key and n, so a stream has no state to share or
+// lock, and its numbers can be drawn on any thread in any order with the
+// same result.
+namespace counter_rng
+{
+    // Scrambles the bits of x with the SplitMix64 finalizer, a bijection in
+    // which every input bit affects every output bit.
+    inline std::uint64_t mix(std::uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+
+    // Returns the key of the substream of key identified by value.
+    inline std::uint64_t derive_key(std::uint64_t key, std::uint64_t value)
+    {
+        return mix(key ^ mix(value + 0x9e3779b97f4a7c15));
+    }
+
+    // Returns the n-th number of the stream of key, uniformly distributed
+    // in [0, 1). T is float or double.
+    template<typename T>
+    T uniform(std::uint64_t key, std::uint64_t n)
+    {
+        constexpr int digits = std::numeric_limits<T>::digits;
+        std::uint64_t const bits = mix(key + 0x9e3779b97f4a7c15 * (n + 1));
+        return static_cast<T>(bits >> (64 - digits)) / static_cast<T>(std::uint64_t{1} << digits);
+    }
+
+    // Substreams of the seed of a model, one for each use of random numbers.
+    enum stream_id : std::uint64_t
+    {
+        topic_word_stream = 1,
+        document_stream = 2,
+        gibbs_stream = 3,
+    };
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "counter_rng.hpp"
+#include "estep.hpp"
+#include "simd_math.hpp"
+#include "sparse_matrix.hpp"
+
+
+namespace
+{
+    // Adds a nonzero word count to the key of a document.
+    std::uint64_t add_word_count(std::uint64_t key, std::size_t index, double count)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &count, sizeof bits);
+        return counter_rng::derive_key(counter_rng::derive_key(key, index), bits);
+    }
+
+    // Number of independent partial sums in the reductions of the fixed-size
+    // kernels. It is a multiple of the SIMD width of every supported
+    // instruction set, so each partial sum maps to a vector lane.
+    constexpr std::size_t lane_count = 8;
+
+    // Computes the dot product of two arrays of K elements. The loops have
+    // constant trip counts and no dependency between the lanes, so the
+    // compiler unrolls them and keeps the partial sums in vector registers.
+    template<typename T, std::size_t K>
+    T fixed_dot(T const* a, T const* b)
+    {
+        static_assert(K % lane_count == 0, "K must be a multiple of lane_count");
+
+        T partial[lane_count] = {};
+        for (std::size_t k = 0; k < K; k += lane_count) {
+            for (std::size_t lane = 0; lane < lane_count; ++lane) {
+                partial[lane] += a[k + lane] * b[k + lane];
+            }
+        }
+
+        for (std::size_t width = lane_count / 2; width > 0; width /= 2) {
+            for (std::size_t lane = 0; lane < width; ++lane) {
+                partial[lane] += partial[lane + width];
+            }
+        }
+        return partial[0];
+    }
+
+    // accumulate_doc_topic_counts for a topic count known at compile time.
+    template<typename T, std::size_t K>
+    void fixed_accumulate_doc_topic_counts(sparse_matrix::row_view const& doc,
+                                           T const* doc_topic_geoexp,
+                                           T const* word_topic_geoexp,
+                                           std::size_t word_stride,
+                                           T* doc_topic_counts)
+    {
+        for (std::size_t i = 0; i < doc.size; ++i) {
+            T const* word_geoexp = word_topic_geoexp + std::size_t{doc.indices[i]} * word_stride;
+
+            T const norm = fixed_dot<T, K>(doc_topic_geoexp, word_geoexp);
+            T const scale = static_cast<T>(doc.values[i] / (norm + estep::epsilon));
+
+            for (std::size_t k = 0; k < K; ++k) {
+                doc_topic_counts[k] += scale * word_geoexp[k];
+            }
+        }
+    }
+
+    // fit_sparse_document for a topic count known at compile time. The
+    // per-document state is kept in stack arrays during the iteration.
+    template<typename T, std::size_t K>
+    int fixed_fit_sparse_document(sparse_matrix::row_view const& doc,
+                                   T const* word_topic_geoexp,
+                                   std::size_t word_stride,
+                                   estep::iteration_options const& options,
+                                   T* dirichlets,
+                                   T* geoexp)
+    {
+        alignas(64) std::array<T, K> local_dirichlets;
+        alignas(64) std::array<T, K> local_geoexp;
+        alignas(64) std::array<T, K> local_counts;
+
+        std::copy(dirichlets, dirichlets + K, local_dirichlets.begin());
+
+        int iter_count = 0;
+        while (iter_count < options.max_iter_count) {
+            iter_count++;
+            estep::dirichlet_geometric_expect(local_dirichlets.data(), K, local_geoexp.data());
+
+            local_counts.fill(T(0));
+            fixed_accumulate_doc_topic_counts<T, K>(
+                doc, local_geoexp.data(), word_topic_geoexp, word_stride, local_counts.data());
+
+            double const max_delta = estep::update_doc_topic_dirichlets(
+                options.doc_topic_prior, local_geoexp.data(), local_counts.data(), K, local_dirichlets.data());
+            if (max_delta <= options.convergence_threshold) {
+                break;
+            }
+        }
+
+        std::copy(local_dirichlets.begin(), local_dirichlets.end(), dirichlets);
+        std::copy(local_geoexp.begin(), local_geoexp.end(), geoexp);
+        return iter_count;
+    }
+}
+
+std::uint64_t estep::document_key(std::uint64_t seed, sparse_matrix::row_view const& doc)
+{
+    std::uint64_t key = counter_rng::derive_key(seed, counter_rng::document_stream);
+    for (std::size_t i = 0; i < doc.size; ++i) {
+        if (doc.values[i] != 0) {
+            key = add_word_count(key, doc.indices[i], doc.values[i]);
+        }
+    }
+    return key;
+}
+
+std::uint64_t estep::document_key(std::uint64_t seed, double const* counts, std::size_t word_count)
+{
+    std::uint64_t key = counter_rng::derive_key(seed, counter_rng::document_stream);
+    for (std::size_t w = 0; w < word_count; ++w) {
+        if (counts[w] != 0) {
+            key = add_word_count(key, w, counts[w]);
+        }
+    }
+    return key;
+}
+
+template<typename T>
+void estep::init_doc_topic_dirichlets(std::uint64_t key, double prior, std::size_t topic_count, T* dirichlets)
+{
+    T const typed_prior = static_cast<T>(prior);
+    for (std::size_t k = 0; k < topic_count; ++k) {
+        dirichlets[k] = typed_prior + counter_rng::uniform<T>(key, k);
+    }
+}
+
+template<typename T>
+void estep::dirichlet_log_expect(T const* params, std::size_t size, T* logexp)
+{
+    math_functions<T> const& functions = cpu_math_functions<T>();
+
+    T param_sum = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        param_sum += params[i];
+    }
+
+    functions.digamma(&param_sum, 1, &param_sum);
+    functions.digamma(params, size, logexp);
+
+    for (std::size_t i = 0; i < size; ++i) {
+        logexp[i] -= param_sum;
+    }
+}
+
+template<typename T>
+void estep::dirichlet_geometric_expect(T const* params, std::size_t size, T* geoexp)
+{
+    dirichlet_log_expect(params, size, geoexp);
+    cpu_math_functions<T>().exp(geoexp, size, geoexp);
+}
+
+template<typename T>
+double estep::dirichlet_log_likelihood(T const* params,
+                                       std::size_t row_count,
+                                       std::size_t size,
+                                       double prior,
+                                       T* scratch)
+{
+    math_functions<T> const& functions = cpu_math_functions<T>();
+
+    auto const dsize = static_cast<double>(size);
+
+    double const log_beta_prior = dsize * std::lgamma(prior) - std::lgamma(dsize * prior);
+
+    T* const logexp = scratch;
+    T* const lgammas = scratch + size;
+    double result = 0;
+
+    for (std::size_t row = 0; row < row_count; ++row) {
+        T const* row_params = params + row * size;
+
+        dirichlet_log_expect(row_params, size, logexp);
+        functions.lgamma(row_params, size, lgammas);
+
+        double param_sum = 0;
+        for (std::size_t i = 0; i < size; ++i) {
+            param_sum += row_params[i];
+            result += (prior - row_params[i]) * double{logexp[i]} + double{lgammas[i]};
+        }
+        result -= std::lgamma(param_sum) + log_beta_prior;
+    }
+
+    return result;
+}
+
+template<typename T>
+double estep::word_log_likelihood(sparse_matrix::row_view const& doc,
+                                  T const* doc_topic_geoexp,
+                                  T const* word_topic_geoexp,
+                                  std::size_t word_stride,
+                                  std::size_t topic_count)
+{
+    double result = 0;
+
+    for (std::size_t i = 0; i < doc.size; ++i) {
+        T const* word_geoexp = word_topic_geoexp + std::size_t{doc.indices[i]} * word_stride;
+
+        T norm = 0;
+        for (std::size_t k = 0; k < topic_count; ++k) {
+            norm += doc_topic_geoexp[k] * word_geoexp[k];
+        }
+        result += doc.values[i] * std::log(norm + epsilon);
+    }
+
+    return result;
+}
+
+template<typename T>
+double estep::update_doc_topic_dirichlets(double prior,
+                                          T const* geoexp,
+                                          T const* counts,
+                                          std::size_t topic_count,
+                                          T* dirichlets)
+{
+    T const typed_prior = static_cast<T>(prior);
+    T max_delta = 0;
+
+    for (std::size_t k = 0; k < topic_count; ++k) {
+        T const new_dirichlet = typed_prior + geoexp[k] * counts[k];
+        max_delta = std::max(max_delta, std::fabs(new_dirichlet - dirichlets[k]));
+        dirichlets[k] = new_dirichlet;
+    }
+
+    return max_delta;
+}
+
+template<typename T>
+void estep::accumulate_doc_topic_counts(sparse_matrix::row_view const& doc,
+                                        T const* doc_topic_geoexp,
+                                        T const* word_topic_geoexp,
+                                        std::size_t word_stride,
+                                        std::size_t topic_count,
+                                        T* doc_topic_counts)
+{
+    switch (topic_count) {
+      case 8:
+        return fixed_accumulate_doc_topic_counts<T, 8>(doc, doc_topic_geoexp, word_topic_geoexp, word_stride, doc_topic_counts);
+      case 16:
+        return fixed_accumulate_doc_topic_counts<T, 16>(doc, doc_topic_geoexp, word_topic_geoexp, word_stride, doc_topic_counts);
+      case 32:
+        return fixed_accumulate_doc_topic_counts<T, 32>(doc, doc_topic_geoexp, word_topic_geoexp, word_stride, doc_topic_counts);
+      case 64:
+        return fixed_accumulate_doc_topic_counts<T, 64>(doc, doc_topic_geoexp, word_topic_geoexp, word_stride, doc_topic_counts);
+      default:
+        break;
+    }
+
+    for (std::size_t i = 0; i < doc.size; ++i) {
+        T const* word_geoexp = word_topic_geoexp + std::size_t{doc.indices[i]} * word_stride;
+
+        T norm = 0;
+        for (std::size_t k = 0; k < topic_count; ++k) {
+            norm += doc_topic_geoexp[k] * word_geoexp[k];
+        }
+        T const scale = static_cast<T>(doc.values[i] / (norm + epsilon));
+
+        for (std::size_t k = 0; k < topic_count; ++k) {
+            doc_topic_counts[k] += scale * word_geoexp[k];
+        }
+    }
+}
+
+template<typename T>
+int estep::fit_sparse_document(sparse_matrix::row_view const& doc,
+                                T const* word_topic_geoexp,
+                                std::size_t word_stride,
+                                std::size_t topic_count,
+                                iteration_options const& options,
+                                T* dirichlets,
+                                T* geoexp,
+                                T* counts)
+{
+    switch (topic_count) {
+      case 8:
+        return fixed_fit_sparse_document<T, 8>(doc, word_topic_geoexp, word_stride, options, dirichlets, geoexp);
+      case 16:
+        return fixed_fit_sparse_document<T, 16>(doc, word_topic_geoexp, word_stride, options, dirichlets, geoexp);
+      case 32:
+        return fixed_fit_sparse_document<T, 32>(doc, word_topic_geoexp, word_stride, options, dirichlets, geoexp);
+      case 64:
+        return fixed_fit_sparse_document<T, 64>(doc, word_topic_geoexp, word_stride, options, dirichlets, geoexp);
+      default:
+        break;
+    }
+
+    int iter_count = 0;
+    while (iter_count < options.max_iter_count) {
+        iter_count++;
+        dirichlet_geometric_expect(dirichlets, topic_count, geoexp);
+
+        std::fill(counts, counts + topic_count, T(0));
+        accumulate_doc_topic_counts(doc, geoexp, word_topic_geoexp, word_stride, topic_count, counts);
+
+        double const max_delta = update_doc_topic_dirichlets(
+            options.doc_topic_prior, geoexp, counts, topic_count, dirichlets);
+        if (max_delta <= options.convergence_threshold) {
+            break;
+        }
+    }
+    return iter_count;
+}
+
+#define INSTANTIATE(T)                                                                 \
+    template void estep::init_doc_topic_dirichlets(std::uint64_t, double, std::size_t, T*); \
+    template void estep::dirichlet_log_expect(T const*, std::size_t, T*);              \
+    template void estep::dirichlet_geometric_expect(T const*, std::size_t, T*);        \
+    template double estep::dirichlet_log_likelihood(                                   \
+        T const*, std::size_t, std::size_t, double, T*);                               \
+    template double estep::word_log_likelihood(                                        \
+        sparse_matrix::row_view const&, T const*, T const*, std::size_t, std::size_t); \
+    template double estep::update_doc_topic_dirichlets(                                \
+        double, T const*, T const*, std::size_t, T*);                                  \
+    template void estep::accumulate_doc_topic_counts(                                  \
+        sparse_matrix::row_view const&, T const*, T const*, std::size_t, std::size_t, T*); \
+    template int estep::fit_sparse_document(                                           \
+        sparse_matrix::row_view const&, T const*, std::size_t, std::size_t,            \
+        iteration_options const&, T*, T*, T*)
+
+INSTANTIATE(float);
+INSTANTIATE(double);
+
+#undef INSTANTIATE
@@ -0,0 +1,121 @@
+#ifndef INCLUDED_ESTEP_HPP
+#define INCLUDED_ESTEP_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sparse_matrix.hpp"
+
+
+// Building blocks of the variational E-step shared by the trainer and the
+// inference-only model. Parameters and expectations are contiguous rows of
+// scalar type T, which is float or double.
+//
+// Topic counts of 8, 16, 32 and 64 are dispatched to kernels specialized at
+// compile time, which keep the per-document state in stack arrays and use
+// unrolled reductions. Other topic counts use the generic loops. The two
+// differ only in the summation order of the reductions.
+namespace estep
+{
+    // epsilon value used to prevent zero division and zero logarithm.
+    constexpr double epsilon = 1e-6;
+
+    // Options of the per-document fixed-point iteration.
+    struct iteration_options
+    {
+        double doc_topic_prior;
+        int max_iter_count;
+        double convergence_threshold;
+    };
+
+    // Returns the key of the random stream of a document, derived from seed
+    // and the indices and values of its nonzero word counts. The initial
+    // parameters of a document thus depend only on the seed and the
+    // document, not on the other documents in a batch or the threads.
+    std::uint64_t document_key(std::uint64_t seed, sparse_matrix::row_view const& doc);
+
+    // Returns the key of a dense document of word_count counts, which is the
+    // same as the key of the document in the sparse form.
+    std::uint64_t document_key(std::uint64_t seed, double const* counts, std::size_t word_count);
+
+    // Initializes document-topic dirichlet parameters to prior plus numbers
+    // uniform in [0, 1) drawn from the stream of key.
+    template<typename T>
+    void init_doc_topic_dirichlets(std::uint64_t key, double prior, std::size_t topic_count, T* dirichlets);
+
+    // Computes the expectation of the logarithm of Dirichlet variables with
+    // given parameters.
+    template<typename T>
+    void dirichlet_log_expect(T const* params, std::size_t size, T* logexp);
+
+    // Computes the geometric expectation of Dirichlet variables with given
+    // parameters.
+    template<typename T>
+    void dirichlet_geometric_expect(T const* params, std::size_t size, T* geoexp);
+
+    // Computes the sum over rows of
+    //
+    //     sum_i (prior - params_i) E[log x_i] + log B(params) - log B(prior)
+    //
+    // where x follows the Dirichlet distribution with the parameters in the
+    // row and B is the multivariate beta function. This is the Dirichlet part
+    // of the evidence lower bound with a symmetric prior. scratch is a buffer
+    // of 2 * size elements.
+    template<typename T>
+    double dirichlet_log_likelihood(T const* params,
+                                    std::size_t row_count,
+                                    std::size_t size,
+                                    double prior,
+                                    T* scratch);
+
+    // Computes the word term of the evidence lower bound of a sparse
+    // document, sum_w count(w) log sum_k doc_topic_geoexp[k] word_topic_geoexp[w, k],
+    // which it reduces to with the optimal document-word-topic distribution.
+    // The topic values of word w start at word_topic_geoexp + w * word_stride.
+    template<typename T>
+    double word_log_likelihood(sparse_matrix::row_view const& doc,
+                               T const* doc_topic_geoexp,
+                               T const* word_topic_geoexp,
+                               std::size_t word_stride,
+                               std::size_t topic_count);
+
+    // Updates the document-topic dirichlet parameters of a document with the
+    // expected topic counts accumulated without the geoexp factor. Returns
+    // the maximum absolute change of the parameters.
+    template<typename T>
+    double update_doc_topic_dirichlets(double prior,
+                                       T const* geoexp,
+                                       T const* counts,
+                                       std::size_t topic_count,
+                                       T* dirichlets);
+
+    // Accumulates the expected topic counts of a sparse document. The
+    // document-word-topic distribution of word w is proportional to the
+    // product of doc_topic_geoexp[k] and word_topic_geoexp[w, k]. The counts
+    // are accumulated without the doc_topic_geoexp[k] factor, which is common
+    // to all the words in the document. The topic values of word w start at
+    // word_topic_geoexp + w * word_stride.
+    template<typename T>
+    void accumulate_doc_topic_counts(sparse_matrix::row_view const& doc,
+                                     T const* doc_topic_geoexp,
+                                     T const* word_topic_geoexp,
+                                     std::size_t word_stride,
+                                     std::size_t topic_count,
+                                     T* doc_topic_counts);
+
+    // Fits the document-topic dirichlet parameters of a sparse document,
+    // starting from the values in dirichlets. The geometric expectation used
+    // in the last iteration is stored to geoexp. counts is a scratch buffer
+    // of topic_count elements. Returns the number of iterations run.
+    template<typename T>
+    int fit_sparse_document(sparse_matrix::row_view const& doc,
+                             T const* word_topic_geoexp,
+                             std::size_t word_stride,
+                             std::size_t topic_count,
+                             iteration_options const& options,
+                             T* dirichlets,
+                             T* geoexp,
+                             T* counts);
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include "gemm.hpp"
+
+
+namespace
+{
+    // Block sizes chosen so that a block of B (and the corresponding row of
+    // C) stays in L1/L2 cache.
+    constexpr std::size_t block_n = 256;
+    constexpr std::size_t block_k = 128;
+
+    std::atomic<gemm_function> current_backend{&builtin_gemm};
+    std::atomic<sgemm_function> current_sbackend{&builtin_sgemm};
+
+    // Scales C by beta.
+    template<typename T>
+    void scale_matrix(std::size_t m, std::size_t n, T beta, T* c, std::size_t ldc)
+    {
+        for (std::size_t i = 0; i < m; ++i) {
+            T* c_row = c + i * ldc;
+
+            if (beta == 0) {
+                std::fill(c_row, c_row + n, T(0));
+            } else if (beta != 1) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    c_row[j] *= beta;
+                }
+            }
+        }
+    }
+
+    // C += alpha op(A) B. Row p of B is scaled by op(A)(i, p) and added to
+    // row i of C, so the innermost loop runs over contiguous memory.
+    template<typename T>
+    void gemm_xn(bool trans_a,
+                 std::size_t m, std::size_t n, std::size_t k,
+                 T alpha,
+                 T const* a, std::size_t lda,
+                 T const* b, std::size_t ldb,
+                 T* c, std::size_t ldc)
+    {
+        for (std::size_t p0 = 0; p0 < k; p0 += block_k) {
+            std::size_t const p1 = std::min(p0 + block_k, k);
+
+            for (std::size_t j0 = 0; j0 < n; j0 += block_n) {
+                std::size_t const j1 = std::min(j0 + block_n, n);
+
+                for (std::size_t i = 0; i < m; ++i) {
+                    T* c_row = c + i * ldc;
+
+                    for (std::size_t p = p0; p < p1; ++p) {
+                        T const a_ip = alpha * (trans_a ? a[p * lda + i] : a[i * lda + p]);
+                        T const* b_row = b + p * ldb;
+
+                        for (std::size_t j = j0; j < j1; ++j) {
+                            c_row[j] += a_ip * b_row[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // C += alpha A B^T. Each element is a dot product of two contiguous rows.
+    template<typename T>
+    void gemm_nt(std::size_t m, std::size_t n, std::size_t k,
+                 T alpha,
+                 T const* a, std::size_t lda,
+                 T const* b, std::size_t ldb,
+                 T* c, std::size_t ldc)
+    {
+        for (std::size_t p0 = 0; p0 < k; p0 += block_k) {
+            std::size_t const p1 = std::min(p0 + block_k, k);
+
+            for (std::size_t i = 0; i < m; ++i) {
+                T const* a_row = a + i * lda;
+                T* c_row = c + i * ldc;
+
+                for (std::size_t j = 0; j < n; ++j) {
+                    T const* b_row = b + j * ldb;
+
+                    T sum = 0;
+                    for (std::size_t p = p0; p < p1; ++p) {
+                        sum += a_row[p] * b_row[p];
+                    }
+                    c_row[j] += alpha * sum;
+                }
+            }
+        }
+    }
+
+    // C += alpha A^T B^T. Rarely used, so it is not optimized.
+    template<typename T>
+    void gemm_tt(std::size_t m, std::size_t n, std::size_t k,
+                 T alpha,
+                 T const* a, std::size_t lda,
+                 T const* b, std::size_t ldb,
+                 T* c, std::size_t ldc)
+    {
+        for (std::size_t i = 0; i < m; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                T sum = 0;
+                for (std::size_t p = 0; p < k; ++p) {
+                    sum += a[p * lda + i] * b[j * ldb + p];
+                }
+                c[i * ldc + j] += alpha * sum;
+            }
+        }
+    }
+
+    template<typename T>
+    void builtin_gemm_impl(bool trans_a, bool trans_b,
+                           std::size_t m, std::size_t n, std::size_t k,
+                           T alpha,
+                           T const* a, std::size_t lda,
+                           T const* b, std::size_t ldb,
+                           T beta,
+                           T* c, std::size_t ldc)
+    {
+        scale_matrix(m, n, beta, c, ldc);
+
+        if (!trans_b) {
+            gemm_xn(trans_a, m, n, k, alpha, a, lda, b, ldb, c, ldc);
+        } else if (!trans_a) {
+            gemm_nt(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+        } else {
+            gemm_tt(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+        }
+    }
+}
+
+void gemm(bool trans_a, bool trans_b,
+          std::size_t m, std::size_t n, std::size_t k,
+          double alpha,
+          double const* a, std::size_t lda,
+          double const* b, std::size_t ldb,
+          double beta,
+          double* c, std::size_t ldc)
+{
+    current_backend.load()(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+void gemm(bool trans_a, bool trans_b,
+          std::size_t m, std::size_t n, std::size_t k,
+          float alpha,
+          float const* a, std::size_t lda,
+          float const* b, std::size_t ldb,
+          float beta,
+          float* c, std::size_t ldc)
+{
+    current_sbackend.load()(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+void builtin_gemm(bool trans_a, bool trans_b,
+                  std::size_t m, std::size_t n, std::size_t k,
+                  double alpha,
+                  double const* a, std::size_t lda,
+                  double const* b, std::size_t ldb,
+                  double beta,
+                  double* c, std::size_t ldc)
+{
+    builtin_gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+void builtin_sgemm(bool trans_a, bool trans_b,
+                   std::size_t m, std::size_t n, std::size_t k,
+                   float alpha,
+                   float const* a, std::size_t lda,
+                   float const* b, std::size_t ldb,
+                   float beta,
+                   float* c, std::size_t ldc)
+{
+    builtin_gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+gemm_function set_gemm_backend(gemm_function backend)
+{
+    return current_backend.exchange(backend ? backend : &builtin_gemm);
+}
+
+sgemm_function set_sgemm_backend(sgemm_function backend)
+{
+    return current_sbackend.exchange(backend ? backend : &builtin_sgemm);
+}
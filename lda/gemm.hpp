@@ -0,0 +1,75 @@
+#ifndef INCLUDED_GEMM_HPP
+#define INCLUDED_GEMM_HPP
+
+#include <cstddef>
+
+
+// Signature of a general matrix multiplication routine on scalar type T. It
+// computes
+//
+//     C = alpha op(A) op(B) + beta C
+//
+// where op(A) is m-by-k, op(B) is k-by-n and C is m-by-n. All matrices are
+// stored in the row-major order with leading dimensions lda, ldb and ldc.
+// op(X) is the transpose of X if the corresponding trans flag is set. This
+// is the same convention as cblas_dgemm with CblasRowMajor, so a BLAS library
+// can be plugged in with a thin wrapper. The routine is called concurrently
+// from multiple threads when latent_dirichlet_allocation uses threads.
+template<typename T>
+using basic_gemm_function = void (*)(bool trans_a, bool trans_b,
+                                     std::size_t m, std::size_t n, std::size_t k,
+                                     T alpha,
+                                     T const* a, std::size_t lda,
+                                     T const* b, std::size_t ldb,
+                                     T beta,
+                                     T* c, std::size_t ldc);
+
+// Double and single precision routines, like cblas_dgemm and cblas_sgemm.
+using gemm_function = basic_gemm_function<double>;
+using sgemm_function = basic_gemm_function<float>;
+
+// Computes a matrix product using the current backend.
+void gemm(bool trans_a, bool trans_b,
+          std::size_t m, std::size_t n, std::size_t k,
+          double alpha,
+          double const* a, std::size_t lda,
+          double const* b, std::size_t ldb,
+          double beta,
+          double* c, std::size_t ldc);
+
+// Computes a single precision matrix product using the current backend.
+void gemm(bool trans_a, bool trans_b,
+          std::size_t m, std::size_t n, std::size_t k,
+          float alpha,
+          float const* a, std::size_t lda,
+          float const* b, std::size_t ldb,
+          float beta,
+          float* c, std::size_t ldc);
+
+// Built-in cache-blocked implementation of gemm_function.
+void builtin_gemm(bool trans_a, bool trans_b,
+                  std::size_t m, std::size_t n, std::size_t k,
+                  double alpha,
+                  double const* a, std::size_t lda,
+                  double const* b, std::size_t ldb,
+                  double beta,
+                  double* c, std::size_t ldc);
+
+// Built-in cache-blocked implementation of sgemm_function.
+void builtin_sgemm(bool trans_a, bool trans_b,
+                   std::size_t m, std::size_t n, std::size_t k,
+                   float alpha,
+                   float const* a, std::size_t lda,
+                   float const* b, std::size_t ldb,
+                   float beta,
+                   float* c, std::size_t ldc);
+
+// Replaces the backend used by gemm and returns the previous one. Passing
+// nullptr restores the built-in implementation.
+gemm_function set_gemm_backend(gemm_function backend);
+
+// Replaces the backend used by single precision gemm and returns the
+// previous one. Passing nullptr restores the built-in implementation.
+sgemm_function set_sgemm_backend(sgemm_function backend);
+
+#endif
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "gibbs.hpp"
+#include "sparse_matrix.hpp"
+
+
+namespace
+{
+    // Removes value from an unordered list.
+    void remove_value(std::vector<std::uint32_t>& values, std::uint32_t value)
+    {
+        auto const pos = std::find(values.begin(), values.end(), value);
+        *pos = values.back();
+        values.pop_back();
+    }
+}
+
+gibbs_sampler::gibbs_sampler(sparse_matrix const& data,
+                             std::size_t topic_count,
+                             double doc_topic_prior,
+                             double topic_word_prior,
+                             std::uint64_t seed)
+    : topic_count_{topic_count}
+    , word_count_{data.col_count()}
+    , alpha_{doc_topic_prior}
+    , beta_{topic_word_prior}
+    , beta_sum_{topic_word_prior * static_cast<double>(data.col_count())}
+    , engine_{seed}
+{
+    if (topic_count_ == 0) {
+        throw std::invalid_argument("topic_count must be a positive integer");
+    }
+
+    if (alpha_ <= 0 || beta_ <= 0) {
+        throw std::invalid_argument("priors must be positive");
+    }
+
+    doc_offsets_.reserve(data.row_count() + 1);
+    doc_offsets_.push_back(0);
+
+    for (std::size_t doc = 0; doc < data.row_count(); ++doc) {
+        sparse_matrix::row_view const row = data.row(doc);
+
+        for (std::size_t i = 0; i < row.size; ++i) {
+            if (row.values[i] < 0) {
+                throw std::invalid_argument("counts must be nonnegative");
+            }
+            auto const count = static_cast<std::size_t>(std::llround(row.values[i]));
+            token_words_.insert(token_words_.end(), count, row.indices[i]);
+        }
+        doc_offsets_.push_back(token_words_.size());
+    }
+
+    word_topic_counts_.assign(word_count_ * topic_count_, 0);
+    word_topics_.resize(word_count_);
+    topic_counts_.assign(topic_count_, 0);
+    doc_topic_counts_.assign(topic_count_, 0);
+    word_coefficients_.resize(topic_count_);
+
+    std::uniform_int_distribution<std::uint32_t> random_topic{0, static_cast<std::uint32_t>(topic_count_ - 1)};
+    token_topics_.resize(token_words_.size());
+
+    for (std::size_t i = 0; i < token_words_.size(); ++i) {
+        std::uint32_t const topic = random_topic(engine_);
+        std::uint32_t const word = token_words_[i];
+
+        token_topics_[i] = topic;
+        if (word_topic_counts_[word * topic_count_ + topic]++ == 0) {
+            word_topics_[word].push_back(topic);
+        }
+        topic_counts_[topic]++;
+    }
+}
+
+void gibbs_sampler::sweep()
+{
+    // The bucket sums are recomputed from scratch on each sweep so that
+    // rounding errors of the incremental updates do not accumulate.
+    smoothing_sum_ = 0;
+    for (std::size_t topic = 0; topic < topic_count_; ++topic) {
+        smoothing_sum_ += smoothing_term(topic);
+        word_coefficients_[topic] = alpha_ / (beta_sum_ + topic_counts_[topic]);
+    }
+
+    for (std::size_t doc = 0; doc + 1 < doc_offsets_.size(); ++doc) {
+        sweep_document(doc);
+    }
+}
+
+std::size_t gibbs_sampler::token_count() const
+{
+    return token_words_.size();
+}
+
+xt::xtensor<double, 2> gibbs_sampler::topic_word_counts() const
+{
+    xt::xtensor<double, 2> counts{xt::static_shape<std::size_t, 2>{topic_count_, word_count_}};
+
+    for (std::size_t word = 0; word < word_count_; ++word) {
+        for (std::size_t topic = 0; topic < topic_count_; ++topic) {
+            counts(topic, word) = word_topic_counts_[word * topic_count_ + topic];
+        }
+    }
+
+    return counts;
+}
+
+void gibbs_sampler::sweep_document(std::size_t doc)
+{
+    std::size_t const begin = doc_offsets_[doc];
+    std::size_t const end = doc_offsets_[doc + 1];
+
+    for (std::size_t i = begin; i < end; ++i) {
+        if (doc_topic_counts_[token_topics_[i]]++ == 0) {
+            doc_topics_.push_back(token_topics_[i]);
+        }
+    }
+
+    doc_sum_ = 0;
+    for (std::uint32_t const topic : doc_topics_) {
+        double const denom = beta_sum_ + topic_counts_[topic];
+        doc_sum_ += doc_topic_counts_[topic] * beta_ / denom;
+        word_coefficients_[topic] = (alpha_ + doc_topic_counts_[topic]) / denom;
+    }
+
+    std::uniform_real_distribution<double> uniform;
+
+    for (std::size_t i = begin; i < end; ++i) {
+        std::uint32_t const word = token_words_[i];
+        update_counts(token_topics_[i], word, -1);
+
+        // Topic-word bucket. Its terms are kept for the walk below.
+        std::vector<std::uint32_t> const& word_topics = word_topics_[word];
+        std::uint32_t const* word_counts = &word_topic_counts_[word * topic_count_];
+
+        word_weights_.resize(word_topics.size());
+        double word_sum = 0;
+        for (std::size_t j = 0; j < word_topics.size(); ++j) {
+            word_weights_[j] = word_coefficients_[word_topics[j]] * word_counts[word_topics[j]];
+            word_sum += word_weights_[j];
+        }
+
+        double u = uniform(engine_) * (word_sum + doc_sum_ + smoothing_sum_);
+        std::uint32_t new_topic = static_cast<std::uint32_t>(topic_count_ - 1);
+
+        if (u < word_sum && !word_topics.empty()) {
+            new_topic = word_topics.back();
+            for (std::size_t j = 0; j < word_topics.size(); ++j) {
+                u -= word_weights_[j];
+                if (u < 0) {
+                    new_topic = word_topics[j];
+                    break;
+                }
+            }
+        } else if ((u -= word_sum) < doc_sum_ && !doc_topics_.empty()) {
+            new_topic = doc_topics_.back();
+            for (std::uint32_t const topic : doc_topics_) {
+                u -= doc_topic_counts_[topic] * beta_ / (beta_sum_ + topic_counts_[topic]);
+                if (u < 0) {
+                    new_topic = topic;
+                    break;
+                }
+            }
+        } else {
+            u -= doc_sum_;
+            for (std::size_t topic = 0; topic < topic_count_; ++topic) {
+                u -= smoothing_term(topic);
+                if (u < 0) {
+                    new_topic = static_cast<std::uint32_t>(topic);
+                    break;
+                }
+            }
+        }
+
+        update_counts(new_topic, word, 1);
+        token_topics_[i] = new_topic;
+    }
+
+    // Leave the document state empty for the next document.
+    for (std::uint32_t const topic : doc_topics_) {
+        doc_topic_counts_[topic] = 0;
+        word_coefficients_[topic] = alpha_ / (beta_sum_ + topic_counts_[topic]);
+    }
+    doc_topics_.clear();
+}
+
+void gibbs_sampler::update_counts(std::size_t topic, std::size_t word, int delta)
+{
+    auto const topic_index = static_cast<std::uint32_t>(topic);
+    std::uint32_t& doc_count = doc_topic_counts_[topic];
+    std::uint32_t& word_count = word_topic_counts_[word * topic_count_ + topic];
+    std::uint32_t& topic_total = topic_counts_[topic];
+
+    smoothing_sum_ -= smoothing_term(topic);
+    doc_sum_ -= doc_count * beta_ / (beta_sum_ + topic_total);
+
+    if (delta > 0) {
+        if (doc_count++ == 0) {
+            doc_topics_.push_back(topic_index);
+        }
+        if (word_count++ == 0) {
+            word_topics_[word].push_back(topic_index);
+        }
+        topic_total++;
+    } else {
+        if (--doc_count == 0) {
+            remove_value(doc_topics_, topic_index);
+        }
+        if (--word_count == 0) {
+            remove_value(word_topics_[word], topic_index);
+        }
+        topic_total--;
+    }
+
+    double const denom = beta_sum_ + topic_total;
+    smoothing_sum_ += smoothing_term(topic);
+    doc_sum_ += doc_count * beta_ / denom;
+    word_coefficients_[topic] = (alpha_ + doc_count) / denom;
+}
+
+double gibbs_sampler::smoothing_term(std::size_t topic) const
+{
+    return alpha_ * beta_ / (beta_sum_ + topic_counts_[topic]);
+}
@@ -0,0 +1,95 @@
+#ifndef INCLUDED_GIBBS_HPP
+#define INCLUDED_GIBBS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "sparse_matrix.hpp"
+
+
+// Collapsed Gibbs sampler for latent Dirichlet allocation. Each token of
+// the corpus holds a topic assignment, which is resampled from
+//
+//     p(k) ∝ (alpha + n_dk) (beta + n_kw) / (V beta + n_k)
+//
+// with the token itself excluded from the counts. The sum is split into the
+// three buckets of SparseLDA [1]:
+//
+//     s = sum_k alpha beta / (V beta + n_k)
+//     r = sum_k n_dk beta / (V beta + n_k)
+//     q = sum_k (alpha + n_dk) n_kw / (V beta + n_k)
+//
+// r and q have terms only for the topics of the document and the word, so
+// a token costs time proportional to those topic counts instead of K once
+// the assignments become sparse. s is maintained incrementally.
+//
+// [1]: L. Yao, D. Mimno and A. McCallum. Efficient methods for topic model
+//      inference on streaming document collections. KDD 2009.
+class gibbs_sampler
+{
+  public:
+    // Initializes the sampler with random topic assignments. Each element
+    // of data is rounded to the nearest integer and taken as that many
+    // tokens.
+    gibbs_sampler(sparse_matrix const& data,
+                  std::size_t topic_count,
+                  double doc_topic_prior,
+                  double topic_word_prior,
+                  std::uint64_t seed);
+
+    // Resamples the topic assignments of all the tokens once.
+    void sweep();
+
+    // Returns the number of tokens.
+    std::size_t token_count() const;
+
+    // Returns the topic-word counts of the current assignments as a
+    // topic_count-by-word_count tensor.
+    xt::xtensor<double, 2> topic_word_counts() const;
+
+  private:
+    // Resamples the tokens of a document.
+    void sweep_document(std::size_t doc);
+
+    // Adds delta to the counts of a token with given topic and word in the
+    // current document.
+    void update_counts(std::size_t topic, std::size_t word, int delta);
+
+    // Returns the smoothing bucket term of a topic.
+    double smoothing_term(std::size_t topic) const;
+
+  private:
+    std::size_t topic_count_;
+    std::size_t word_count_;
+    double alpha_;
+    double beta_;
+    double beta_sum_;
+    std::mt19937_64 engine_;
+
+    // Tokens of document d are [doc_offsets_[d], doc_offsets_[d + 1]).
+    std::vector<std::size_t> doc_offsets_;
+    std::vector<std::uint32_t> token_words_;
+    std::vector<std::uint32_t> token_topics_;
+
+    // Topic-word counts stored word-major, and the topics with nonzero
+    // counts for each word in no particular order.
+    std::vector<std::uint32_t> word_topic_counts_;
+    std::vector<std::vector<std::uint32_t>> word_topics_;
+    std::vector<std::uint32_t> topic_counts_;
+
+    // State of the document being resampled: the document-topic counts, the
+    // topics with nonzero counts, the bucket sums and the q coefficients
+    // (alpha + n_dk) / (V beta + n_k).
+    std::vector<std::uint32_t> doc_topic_counts_;
+    std::vector<std::uint32_t> doc_topics_;
+    double smoothing_sum_ = 0;
+    double doc_sum_ = 0;
+    std::vector<double> word_coefficients_;
+    std::vector<double> word_weights_;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <xtensor/xshape.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "arena.hpp"
+#include "estep.hpp"
+#include "inference.hpp"
+#include "lda.hpp"
+#include "lda_io.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "sparse_matrix.hpp"
+
+
+namespace
+{
+    // Number of documents a thread claims at once.
+    constexpr std::size_t chunk_size = 16;
+
+    // Copies the topic-word dirichlet parameters of a mapped model of scalar
+    // type U into a tensor of type T.
+    template<typename T, typename U>
+    xt::xtensor<T, 2> mapped_topic_word_dirichlets(mapped_lda const& model)
+    {
+        U const* values = model.topic_word_dirichlets<U>();
+
+        xt::xtensor<T, 2> result{xt::static_shape<std::size_t, 2>{model.topic_count(), model.word_count()}};
+        std::transform(values, values + result.size(), result.begin(),
+                       [](U value) { return static_cast<T>(value); });
+        return result;
+    }
+}
+
+std::size_t inference_workspace::capacity() const
+{
+    return arena_.capacity();
+}
+
+thread_pool& inference_workspace::pool(std::size_t thread_count)
+{
+    if (!pool_ || pool_->size() != thread_count) {
+        pool_.reset();
+        pool_ = std::make_unique<thread_pool>(thread_count);
+    }
+    return *pool_;
+}
+
+template<typename T>
+basic_inference_table<T>::basic_inference_table(lda_config const& config,
+                                                std::size_t word_count,
+                                                std::size_t word_stride,
+                                                T const* word_topic_geoexp)
+    : config_{config}
+    , word_count_{word_count}
+    , word_stride_{word_stride}
+    , word_topic_geoexp_{word_topic_geoexp}
+{
+}
+
+template<typename T>
+T const* basic_inference_table<T>::transform(sparse_matrix const& data, inference_workspace& workspace) const
+{
+    return fit(data, workspace, false).doc_topic_dirichlets;
+}
+
+template<typename T>
+double basic_inference_table<T>::document_score(sparse_matrix const& data, inference_workspace& workspace) const
+{
+    auto const topic_count = config_.topic_count;
+
+    fitted_batch const batch = fit(data, workspace, true);
+
+    LDA_PROFILE_SCOPE("inference.document_likelihood");
+
+    thread_pool& pool = workspace.pool(config_.thread_count);
+
+    // Partial sums of fixed ranges of documents, added in order so that the
+    // result does not depend on thread scheduling.
+    double* const partial_sums = workspace.arena_.allocate<double>(pool.size());
+
+    auto const score_documents = [&](std::size_t thread) {
+        std::size_t const begin = batch.bounds[thread];
+        std::size_t const end = batch.bounds[thread + 1];
+        double sum = 0;
+
+        for (std::size_t doc = begin; doc < end; ++doc) {
+            sum += estep::word_log_likelihood(data.row(doc), batch.doc_topic_geoexp + doc * topic_count,
+                                              word_topic_geoexp_, word_stride_, topic_count);
+        }
+        if (begin < end) {
+            sum += estep::dirichlet_log_likelihood(batch.doc_topic_dirichlets + begin * topic_count, end - begin,
+                                                   topic_count, config_.doc_topic_prior,
+                                                   batch.scratch + thread * 2 * word_stride_);
+        }
+
+        partial_sums[thread] = sum;
+    };
+    pool.run([&score_documents](std::size_t thread) { score_documents(thread); });
+
+    return std::accumulate(partial_sums, partial_sums + pool.size(), 0.0);
+}
+
+template<typename T>
+auto basic_inference_table<T>::fit(sparse_matrix const& data, inference_workspace& workspace, bool keep_geoexp) const
+    -> fitted_batch
+{
+    auto const doc_count = data.row_count();
+    auto const topic_count = config_.topic_count;
+
+    if (data.col_count() != word_count_) {
+        throw std::logic_error("word count mismatch");
+    }
+
+    LDA_PROFILE_SCOPE("inference.estep");
+    LDA_PROFILE_COUNT("inference.documents", doc_count);
+    LDA_PROFILE_COUNT("inference.nonzeros", data.nonzero_count());
+
+    thread_pool& pool = workspace.pool(config_.thread_count);
+    arena& buffers = workspace.arena_;
+    buffers.reset();
+
+    fitted_batch batch;
+    batch.doc_topic_dirichlets = buffers.allocate<T>(doc_count * topic_count);
+    batch.doc_topic_geoexp = keep_geoexp ? buffers.allocate<T>(doc_count * topic_count) : nullptr;
+    batch.bounds = buffers.allocate<std::size_t>(pool.size() + 1);
+    batch.scratch = buffers.allocate<T>(pool.size() * 2 * word_stride_);
+
+    std::size_t* const weights = buffers.allocate<std::size_t>(doc_count);
+    for (std::size_t doc = 0; doc < doc_count; ++doc) {
+        weights[doc] = data.row(doc).size + 1;
+    }
+    balanced_partition(weights, doc_count, pool.size(), batch.bounds);
+
+    estep::iteration_options const options = {
+        config_.doc_topic_prior, config_.inner_iter_count, config_.convergence_threshold
+    };
+
+    auto const fit_documents = [&](std::size_t begin, std::size_t end, std::size_t thread) {
+        // The geometric expectation, unless kept per document, and the topic
+        // counts. word_stride_ keeps the scratch of each thread on its own
+        // cache lines.
+        T* const scratch = batch.scratch + thread * 2 * word_stride_;
+        T* const counts = scratch + word_stride_;
+        int iteration_count = 0;
+
+        for (std::size_t doc = begin; doc < end; ++doc) {
+            T* const dirichlets = batch.doc_topic_dirichlets + doc * topic_count;
+            T* const geoexp = keep_geoexp ? batch.doc_topic_geoexp + doc * topic_count : scratch;
+
+            estep::init_doc_topic_dirichlets(estep::document_key(config_.seed, data.row(doc)),
+                                             config_.doc_topic_prior, topic_count, dirichlets);
+            iteration_count += estep::fit_sparse_document(data.row(doc), word_topic_geoexp_, word_stride_,
+                                                          topic_count, options, dirichlets, geoexp, counts);
+        }
+        LDA_PROFILE_COUNT("inference.inner_iterations", iteration_count);
+    };
+
+    // The body captures a single reference, which std::function stores
+    // without allocating.
+    parallel_for(pool, batch.bounds, pool.size(), chunk_size,
+                 [&fit_documents](std::size_t begin, std::size_t end, std::size_t thread) {
+                     fit_documents(begin, end, thread);
+                 });
+
+    return batch;
+}
+
+template<typename T>
+basic_lda_inference<T>::basic_lda_inference(basic_latent_dirichlet_allocation<T> const& lda)
+    : config_{lda.get_config()}
+{
+    tensor_type const topic_word_dirichlets = lda.topic_word_dirichlets();
+
+    if (topic_word_dirichlets.shape()[0] != config_.topic_count) {
+        throw std::logic_error("model is not trained");
+    }
+
+    word_count_ = topic_word_dirichlets.shape()[1];
+    word_stride_ = word_stride(config_.topic_count);
+
+    owned_geoexp_.resize(word_count_ * word_stride_);
+    compute_word_topic_geoexp(topic_word_dirichlets, word_stride_, owned_geoexp_.data());
+    word_topic_geoexp_ = owned_geoexp_.data();
+}
+
+template<typename T>
+basic_lda_inference<T>::basic_lda_inference(std::shared_ptr<mapped_lda const> model)
+    : config_{model->get_config()}
+    , word_count_{model->word_count()}
+    , word_stride_{model->word_stride()}
+{
+    if (model->scalar_size() == sizeof(T) && word_stride_ == word_stride(config_.topic_count)) {
+        mapped_model_ = std::move(model);
+        word_topic_geoexp_ = mapped_model_->word_topic_geoexp<T>();
+        return;
+    }
+
+    tensor_type const topic_word_dirichlets = model->scalar_size() == sizeof(float)
+        ? mapped_topic_word_dirichlets<T, float>(*model)
+        : mapped_topic_word_dirichlets<T, double>(*model);
+
+    word_stride_ = word_stride(config_.topic_count);
+    owned_geoexp_.resize(word_count_ * word_stride_);
+    compute_word_topic_geoexp(topic_word_dirichlets, word_stride_, owned_geoexp_.data());
+    word_topic_geoexp_ = owned_geoexp_.data();
+}
+
+template<typename T>
+auto basic_lda_inference<T>::transform(xt::xtensor<double, 2> const& data) const -> tensor_type
+{
+    return transform(sparse_matrix{data});
+}
+
+template<typename T>
+auto basic_lda_inference<T>::transform(sparse_matrix const& data) const -> tensor_type
+{
+    inference_workspace workspace;
+    T const* const doc_topic_dirichlets = transform(data, workspace);
+
+    tensor_type result{xt::static_shape<std::size_t, 2>{data.row_count(), config_.topic_count}};
+    std::copy(doc_topic_dirichlets, doc_topic_dirichlets + result.size(), result.raw_data());
+    return result;
+}
+
+template<typename T>
+T const* basic_lda_inference<T>::transform(sparse_matrix const& data, inference_workspace& workspace) const
+{
+    return table().transform(data, workspace);
+}
+
+template<typename T>
+double basic_lda_inference<T>::document_score(sparse_matrix const& data, inference_workspace& workspace) const
+{
+    return table().document_score(data, workspace);
+}
+
+template<typename T>
+std::size_t basic_lda_inference<T>::topic_count() const
+{
+    return config_.topic_count;
+}
+
+template<typename T>
+std::size_t basic_lda_inference<T>::word_count() const
+{
+    return word_count_;
+}
+
+template<typename T>
+void basic_lda_inference<T>::set_thread_count(std::size_t thread_count)
+{
+    config_.thread_count = thread_count;
+}
+
+template<typename T>
+lda_config const& basic_lda_inference<T>::get_config() const
+{
+    return config_;
+}
+
+template<typename T>
+basic_inference_table<T> basic_lda_inference<T>::table() const
+{
+    return basic_inference_table<T>{config_, word_count_, word_stride_, word_topic_geoexp_};
+}
+
+template<typename T>
+std::size_t basic_lda_inference<T>::word_stride(std::size_t topic_count)
+{
+    // Pad each row to a multiple of the cache line.
+    std::size_t const line_size = alignment / sizeof(T);
+    return (topic_count + line_size - 1) / line_size * line_size;
+}
+
+template<typename T>
+void basic_lda_inference<T>::compute_word_topic_geoexp(tensor_type const& topic_word_dirichlets,
+                                                       std::size_t stride,
+                                                       T* word_topic_geoexp)
+{
+    auto const topic_count = topic_word_dirichlets.shape()[0];
+    auto const word_count = topic_word_dirichlets.shape()[1];
+
+    std::fill(word_topic_geoexp, word_topic_geoexp + word_count * stride, T(0));
+
+    std::vector<T> topic_geoexp(word_count);
+
+    for (std::size_t k = 0; k < topic_count; ++k) {
+        estep::dirichlet_geometric_expect(&topic_word_dirichlets(k, 0), word_count, topic_geoexp.data());
+
+        for (std::size_t w = 0; w < word_count; ++w) {
+            word_topic_geoexp[w * stride + k] = topic_geoexp[w];
+        }
+    }
+}
+
+template class basic_inference_table<double>;
+template class basic_inference_table<float>;
+template class basic_lda_inference<double>;
+template class basic_lda_inference<float>;
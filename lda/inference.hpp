@@ -0,0 +1,192 @@
+#ifndef INCLUDED_INFERENCE_HPP
+#define INCLUDED_INFERENCE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "aligned_allocator.hpp"
+#include "arena.hpp"
+#include "lda.hpp"
+#include "parallel.hpp"
+#include "sparse_matrix.hpp"
+
+
+class mapped_lda;
+
+template<typename T>
+class basic_inference_table;
+
+// Buffers and threads reused by the inference calls given the workspace.
+// The buffers are carved from an arena that grows to the largest batch
+// seen, and the thread pool is kept between calls, so once warmed up a call
+// allocates nothing from the heap. A workspace serves one call at a
+// time; concurrent callers each need their own.
+class inference_workspace
+{
+  public:
+    inference_workspace() = default;
+
+    inference_workspace(inference_workspace&&) = default;
+    inference_workspace& operator=(inference_workspace&&) = default;
+
+    // Returns the size of the buffers in bytes.
+    std::size_t capacity() const;
+
+  private:
+    template<typename T>
+    friend class basic_inference_table;
+
+    // Returns a pool of thread_count threads, replacing the current pool if
+    // its size differs.
+    thread_pool& pool(std::size_t thread_count);
+
+  private:
+    arena arena_;
+    std::unique_ptr<thread_pool> pool_;
+};
+
+// Inference table of a model, the geometric expectation of the topic-word
+// distributions stored word-major with rows of word_stride values, and the
+// fitting and scoring of sparse batches against it in a workspace. The
+// table is owned by basic_lda_inference or basic_latent_dirichlet_allocation
+// and must outlive this object.
+template<typename T>
+class basic_inference_table
+{
+  public:
+    basic_inference_table(lda_config const& config,
+                          std::size_t word_count,
+                          std::size_t word_stride,
+                          T const* word_topic_geoexp);
+
+    // Computes the document-topic dirichlet parameters for given sparse data
+    // in workspace. Returns topic_count parameters for each document in
+    // row-major order, which are valid until the next call with workspace.
+    T const* transform(sparse_matrix const& data, inference_workspace& workspace) const;
+
+    // Estimates the terms of log-likelihood that depend on given sparse
+    // documents, using workspace.
+    double document_score(sparse_matrix const& data, inference_workspace& workspace) const;
+
+  private:
+    // Buffers of a batch fitted in a workspace.
+    struct fitted_batch
+    {
+        // The document-topic dirichlet parameters and, if requested, the
+        // geometric expectations used in the last iteration, a row per
+        // document.
+        T* doc_topic_dirichlets;
+        T* doc_topic_geoexp;
+
+        // The boundaries of the documents assigned to each thread.
+        std::size_t* bounds;
+
+        // Scratch of 2 * word_stride_ values for each thread.
+        T* scratch;
+    };
+
+    // Fits the document-topic dirichlet parameters of data in workspace,
+    // keeping the geometric expectations if keep_geoexp is true.
+    fitted_batch fit(sparse_matrix const& data, inference_workspace& workspace, bool keep_geoexp) const;
+
+  private:
+    lda_config const& config_;
+    std::size_t word_count_;
+    std::size_t word_stride_;
+    T const* word_topic_geoexp_;
+};
+
+// Frozen, inference-only form of a trained latent_dirichlet_allocation.
+// The geometric expectation of the topic-word distributions is computed
+// once on construction and stored word-major, with the topics of each word
+// starting at a cache line boundary. So transforming a small batch costs
+// time proportional to its nonzero elements instead of the vocabulary size.
+//
+// When built from a mapped_lda of the same scalar type, the table stored in
+// the model file is used in place instead of being computed.
+template<typename T>
+class basic_lda_inference
+{
+  public:
+    using value_type = T;
+    using tensor_type = xt::xtensor<T, 2>;
+
+    // Builds the inference tables of a trained model.
+    explicit basic_lda_inference(basic_latent_dirichlet_allocation<T> const& lda);
+
+    // Uses the inference tables of a mapped model file, which is kept
+    // mapped while this object exists. If the file stores another scalar
+    // type, the tables are computed from the converted parameters.
+    explicit basic_lda_inference(std::shared_ptr<mapped_lda const> model);
+
+    basic_lda_inference(basic_lda_inference&&) = default;
+    basic_lda_inference& operator=(basic_lda_inference&&) = default;
+
+    // Computes the document-topic dirichlet parameters for given data.
+    tensor_type transform(xt::xtensor<double, 2> const& data) const;
+
+    // Computes the document-topic dirichlet parameters for given sparse data.
+    tensor_type transform(sparse_matrix const& data) const;
+
+    // Computes the document-topic dirichlet parameters for given sparse data
+    // in workspace. Returns topic_count parameters for each document in
+    // row-major order, which are valid until the next call with workspace.
+    T const* transform(sparse_matrix const& data, inference_workspace& workspace) const;
+
+    // Estimates the terms of log-likelihood that depend on given sparse
+    // documents like basic_latent_dirichlet_allocation::document_score,
+    // using workspace.
+    double document_score(sparse_matrix const& data, inference_workspace& workspace) const;
+
+    // Returns the number of topics.
+    std::size_t topic_count() const;
+
+    // Returns the number of words in the vocabulary.
+    std::size_t word_count() const;
+
+    // Sets the number of threads used by transform.
+    void set_thread_count(std::size_t thread_count);
+
+    // Returns the config object of the model.
+    lda_config const& get_config() const;
+
+    // Returns the distance between the rows of the inference table.
+    static std::size_t word_stride(std::size_t topic_count);
+
+    // Computes the inference table of topic-word dirichlet parameters: the
+    // geometric expectation stored word-major, with rows of given stride and
+    // zero padding.
+    static void compute_word_topic_geoexp(tensor_type const& topic_word_dirichlets,
+                                          std::size_t stride,
+                                          T* word_topic_geoexp);
+
+  private:
+    // Alignment of the rows of word_topic_geoexp_ in bytes.
+    static constexpr std::size_t alignment = 64;
+
+    using aligned_vector = std::vector<T, aligned_allocator<T, alignment>>;
+
+    // Returns the inference table of this object.
+    basic_inference_table<T> table() const;
+
+  private:
+    lda_config config_;
+    std::size_t word_count_;
+    std::size_t word_stride_;
+    aligned_vector owned_geoexp_;
+    std::shared_ptr<mapped_lda const> mapped_model_;
+    T const* word_topic_geoexp_;
+};
+
+using lda_inference = basic_lda_inference<double>;
+using float_lda_inference = basic_lda_inference<float>;
+
+extern template class basic_inference_table<double>;
+extern template class basic_inference_table<float>;
+extern template class basic_lda_inference<double>;
+extern template class basic_lda_inference<float>;
+
+#endif
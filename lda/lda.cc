@@ -1,44 +1,165 @@
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <numeric>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
+#include <xtensor/xbuilder.hpp>
 #include <xtensor/xmath.hpp>
 #include <xtensor/xnoalias.hpp>
-#include <xtensor/xrandom.hpp>
 #include <xtensor/xshape.hpp>
 #include <xtensor/xstrided_view.hpp>
 #include <xtensor/xtensor.hpp>
+#include <xtensor/xview.hpp>
 
+#include "counter_rng.hpp"
+#include "estep.hpp"
+#include "gemm.hpp"
+#include "gibbs.hpp"
+#include "inference.hpp"
 #include "lda.hpp"
-#include "math.hpp"
-#include "reindex.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "sparse_matrix.hpp"
 
 
 namespace
 {
-    // epsilon value used to prevent zero division and zero logarithm.
-    constexpr double epsilon = 1e-6;
+    // Computes estep::dirichlet_log_likelihood with a scratch buffer of its
+    // own.
+    template<typename T>
+    double dirichlet_log_likelihood(T const* params, std::size_t row_count, std::size_t size, double prior)
+    {
+        std::vector<T> scratch(2 * size);
+        return estep::dirichlet_log_likelihood(params, row_count, size, prior, scratch.data());
+    }
+
+    // Number of documents processed at once in the dense E-step. Buffers of
+    // this many rows times the word count are used instead of the whole
+    // document-word matrix. A block is also the unit of work for threads.
+    constexpr std::size_t dense_block_size = 256;
+
+    // Number of sparse documents a thread claims at once.
+    constexpr std::size_t sparse_chunk_size = 16;
+
+    // Number of documents scored at once. The document-topic parameters are
+    // only kept for a batch.
+    constexpr std::size_t score_batch_size = 16 * dense_block_size;
 
-    // Computes the expectation of the logarithm of Dirichlet variables with
-    // given parameters on the last axis.
-    template<typename E>
-    auto dirichlet_log_expect(E&& params)
+    // Copies rows [begin, end) of dense data.
+    xt::xtensor<double, 2> batch_rows(xt::xtensor<double, 2> const& data, std::size_t begin, std::size_t end)
     {
-        return digamma(+params)
-                - xt::view(digamma(xt::sum(+params, {params.dimension() - 1})),
-                           xt::all(), xt::newaxis());
+        return xt::view(data, xt::range(begin, end), xt::all());
+    }
+
+    // Returns the number of dense blocks for doc_count documents.
+    std::size_t dense_block_count(std::size_t doc_count)
+    {
+        return (doc_count + dense_block_size - 1) / dense_block_size;
+    }
+
+    // Returns the relative costs of processing sparse documents, which are
+    // used to balance work among threads.
+    std::vector<std::size_t> document_weights(sparse_matrix const& data)
+    {
+        std::vector<std::size_t> weights(data.row_count());
+        for (std::size_t doc = 0; doc < weights.size(); ++doc) {
+            weights[doc] = data.row(doc).size + 1;
+        }
+        return weights;
+    }
+
+    // Computes the normalized counts
+    //
+    //     ratio(d, w) = data(d, w) / sum_k doc_topic_geoexp(d, k) topic_word_geoexp(k, w)
+    //
+    // for the documents in [begin, end). The document-word-topic distribution
+    // is the outer product of doc_topic_geoexp and topic_word_geoexp scaled by
+    // this ratio divided by data, so the E-step and the M-step statistics
+    // reduce to products of this ratio and the geometric expectations.
+    template<typename T>
+    void compute_doc_word_ratio(xt::xtensor<double, 2> const& data,
+                                xt::xtensor<T, 2> const& doc_topic_geoexp,
+                                xt::xtensor<T, 2> const& topic_word_geoexp,
+                                std::size_t begin,
+                                std::size_t end,
+                                T* ratio)
+    {
+        auto const topic_count = topic_word_geoexp.shape()[0];
+        auto const word_count = topic_word_geoexp.shape()[1];
+        auto const size = (end - begin) * word_count;
+
+        gemm(false, false, end - begin, word_count, topic_count,
+             T(1), doc_topic_geoexp.raw_data() + begin * topic_count, topic_count,
+             topic_word_geoexp.raw_data(), word_count,
+             T(0), ratio, word_count);
+
+        double const* counts = data.raw_data() + begin * word_count;
+
+        for (std::size_t i = 0; i < size; ++i) {
+            ratio[i] = static_cast<T>(counts[i] / (ratio[i] + estep::epsilon));
+        }
+    }
+
+    // Computes the same ratio for the documents listed in docs. Row i of
+    // doc_topic_geoexp and of ratio corresponds to document docs[i].
+    template<typename T>
+    void compute_doc_word_ratio(xt::xtensor<double, 2> const& data,
+                                T const* doc_topic_geoexp,
+                                xt::xtensor<T, 2> const& topic_word_geoexp,
+                                std::size_t const* docs,
+                                std::size_t doc_count,
+                                T* ratio)
+    {
+        auto const topic_count = topic_word_geoexp.shape()[0];
+        auto const word_count = topic_word_geoexp.shape()[1];
+
+        gemm(false, false, doc_count, word_count, topic_count,
+             T(1), doc_topic_geoexp, topic_count,
+             topic_word_geoexp.raw_data(), word_count,
+             T(0), ratio, word_count);
+
+        for (std::size_t i = 0; i < doc_count; ++i) {
+            double const* counts = data.raw_data() + docs[i] * word_count;
+            T* ratio_row = ratio + i * word_count;
+
+            for (std::size_t w = 0; w < word_count; ++w) {
+                ratio_row[w] = static_cast<T>(counts[w] / (ratio_row[w] + estep::epsilon));
+            }
+        }
+    }
+
+    // Returns the number of tokens in documents, rounded down. Only used in
+    // profiling counters.
+    std::size_t token_count(xt::xtensor<double, 2> const& data)
+    {
+        return static_cast<std::size_t>(std::accumulate(data.begin(), data.end(), 0.0));
+    }
+
+    std::size_t token_count(sparse_matrix const& data)
+    {
+        double sum = 0;
+        for (std::size_t doc = 0; doc < data.row_count(); ++doc) {
+            sparse_matrix::row_view const row = data.row(doc);
+            sum = std::accumulate(row.values, row.values + row.size, sum);
+        }
+        return static_cast<std::size_t>(sum);
     }
 
-    // Computes the geometric expectation of Dirichlet variables with given
-    // parameters on the last axis.
-    template<typename E>
-    auto dirichlet_geometric_expect(E&& params)
+    // Returns the seconds elapsed since start.
+    double seconds_since(std::chrono::steady_clock::time_point start)
     {
-        return xt::exp(dirichlet_log_expect(std::forward<E>(params)));
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
 
     // Validates LDA configuration.
-    void validate(latent_dirichlet_allocation::config const& conf)
+    void validate(lda_config const& conf)
     {
         if (!(conf.convergence_threshold > 0)) {
             throw std::domain_error("convergence_threshold must be a positive number");
@@ -60,6 +181,22 @@ namespace
             throw std::domain_error("inner_iter_count must be a positive integer");
         }
 
+        if (!(conf.restart_iter_count >= 0)) {
+            throw std::domain_error("restart_iter_count must be a non-negative integer");
+        }
+
+        if (!(conf.thread_count > 0)) {
+            throw std::domain_error("thread_count must be a positive integer");
+        }
+
+        if (!(conf.learning_offset >= 0)) {
+            throw std::domain_error("learning_offset must be a non-negative number");
+        }
+
+        if (!(conf.learning_decay > 0 && conf.learning_decay <= 1)) {
+            throw std::domain_error("learning_decay must be in (0, 1]");
+        }
+
         if (conf.topic_word_preconditions.size()
             && conf.topic_word_preconditions.shape()[0] != conf.topic_count) {
             throw std::domain_error("topic_word_preconditions shape inconsistent with topic_count");
@@ -67,174 +204,840 @@ namespace
     }
 }
 
-latent_dirichlet_allocation::latent_dirichlet_allocation(config const& conf)
+template<typename T>
+basic_latent_dirichlet_allocation<T>::basic_latent_dirichlet_allocation(config const& conf)
     : config_{conf}
 {
     validate(config_);
 }
 
 
-latent_dirichlet_allocation::latent_dirichlet_allocation(config const& conf,
-                                                         xt::xtensor<double, 2> const& topic_word_dirichlets)
+template<typename T>
+basic_latent_dirichlet_allocation<T>::basic_latent_dirichlet_allocation(config const& conf,
+                                                                     tensor_type const& topic_word_dirichlets,
+                                                                     std::size_t update_count)
     : config_{conf}
     , topic_word_dirichlets_{topic_word_dirichlets}
+    , update_count_{update_count}
 {
+    update_topic_word_geoexp();
 }
 
-void latent_dirichlet_allocation::fit(xt::xtensor<double, 2> const& data)
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(xt::xtensor<double, 2> const& data)
 {
-    auto const data_shape = data.shape();
-    auto const doc_count = data_shape[0];
-    auto const word_count = data_shape[1];
-    auto const topic_count = config_.topic_count;
+    fit(data, fit_observer{});
+}
 
-    init_topic_word_dirichlets(topic_count, word_count);
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(sparse_matrix const& data)
+{
+    fit(data, fit_observer{});
+}
 
-    xt::xtensor<double, 3> doc_word_topic_distr{xt::static_shape<std::size_t, 3>{doc_count, word_count, topic_count}};
-    xt::xtensor<double, 2> prev_topic_word_dirichlets = topic_word_dirichlets_;
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(xt::xtensor<double, 2> const& data, fit_observer const& observer)
+{
+    if (config_.engine == lda_engine::gibbs) {
+        return train_gibbs(sparse_matrix{data}, observer);
+    }
+    fit_state state;
+    train(data, data.shape()[0], data.shape()[1], observer, state);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(sparse_matrix const& data, fit_observer const& observer)
+{
+    if (config_.engine == lda_engine::gibbs) {
+        return train_gibbs(data, observer);
+    }
+    fit_state state;
+    train(data, data.row_count(), data.col_count(), observer, state);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(xt::xtensor<double, 2> const& data,
+                                               fit_observer const& observer,
+                                               fit_state& state)
+{
+    if (config_.engine == lda_engine::gibbs) {
+        throw std::invalid_argument("the gibbs engine cannot resume training");
+    }
+    train(data, data.shape()[0], data.shape()[1], observer, state);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::fit(sparse_matrix const& data,
+                                               fit_observer const& observer,
+                                               fit_state& state)
+{
+    if (config_.engine == lda_engine::gibbs) {
+        throw std::invalid_argument("the gibbs engine cannot resume training");
+    }
+    train(data, data.row_count(), data.col_count(), observer, state);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::train_gibbs(sparse_matrix const& data, fit_observer const& observer)
+{
+    gibbs_sampler sampler{data, config_.topic_count, config_.doc_topic_prior, config_.topic_word_prior,
+                          counter_rng::derive_key(config_.seed, counter_rng::gibbs_stream)};
 
     for (int iter = 0; iter < config_.outer_iter_count; ++iter) {
-        transform(data, doc_word_topic_distr);
+        auto const sweep_start = std::chrono::steady_clock::now();
+        {
+            LDA_PROFILE_SCOPE("lda.gibbs_sweep");
+            sampler.sweep();
+        }
+
+        if (observer.callback) {
+            fit_progress progress;
+            progress.iteration = iter;
+            progress.estep_seconds = seconds_since(sweep_start);
 
-        xt::transpose(topic_word_dirichlets_) = config_.topic_word_prior
-                                              + xt::sum(ijk::ij(data) * doc_word_topic_distr, {0});
+            if (!observer.callback(progress)) {
+                break;
+            }
+        }
+    }
+
+    xt::xtensor<double, 2> const topic_word_dirichlets = config_.topic_word_prior + sampler.topic_word_counts();
+
+    topic_word_dirichlets_.resize(topic_word_dirichlets.shape());
+    std::transform(topic_word_dirichlets.begin(), topic_word_dirichlets.end(), topic_word_dirichlets_.begin(),
+                   [](double value) { return static_cast<T>(value); });
+    update_topic_word_geoexp();
+    update_count_ = 0;
+}
+
+template<typename T>
+template<typename Data>
+void basic_latent_dirichlet_allocation<T>::train(Data const& data,
+                                                 std::size_t doc_count,
+                                                 std::size_t word_count,
+                                                 fit_observer const& observer,
+                                                 fit_state& state)
+{
+    auto const topic_count = config_.topic_count;
+
+    if (state.iteration_count == 0) {
+        init_topic_word_dirichlets(topic_count, word_count);
+        update_count_ = 0;
+        state.doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+    } else {
+        bool const valid = state.iteration_count > 0
+                        && topic_word_dirichlets_.shape()[0] == topic_count
+                        && topic_word_dirichlets_.shape()[1] == word_count
+                        && (state.doc_topic_dirichlets.size() == 0
+                            || (state.doc_topic_dirichlets.shape()[0] == doc_count
+                                && state.doc_topic_dirichlets.shape()[1] == topic_count));
+        if (!valid) {
+            throw std::invalid_argument("training state does not match the data");
+        }
+        if (state.doc_topic_dirichlets.size() == 0) {
+            state.doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+        }
+    }
+
+    // The first restart_iter_count iterations start the document-topic
+    // parameters from their initial values. Later ones start from the
+    // previous estimate.
+    xt::xtensor<T, 2>& doc_topic_dirichlets = state.doc_topic_dirichlets;
+    xt::xtensor<T, 2> doc_topic_geoexp;
+    xt::xtensor<T, 2> prev_topic_word_dirichlets = topic_word_dirichlets_;
+
+    thread_pool pool{config_.thread_count};
+
+    for (int iter = state.iteration_count; iter < config_.outer_iter_count; ++iter) {
+        fit_progress progress;
+        progress.iteration = iter;
+
+        auto phase_start = std::chrono::steady_clock::now();
+        std::size_t inner_iteration_count = 0;
+        if (iter > 0 && iter < config_.restart_iter_count) {
+            doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+        }
+        transform(pool, data, doc_topic_dirichlets, doc_topic_geoexp, &inner_iteration_count);
+        progress.estep_seconds = seconds_since(phase_start);
+        progress.mean_inner_iterations = doc_count == 0 ? 0.0
+            : static_cast<double>(inner_iteration_count) / static_cast<double>(doc_count);
+
+        // The bound is evaluated before the topics move, so the statistics
+        // of the E-step are used as they are.
+        if (observer.compute_elbo) {
+            phase_start = std::chrono::steady_clock::now();
+            progress.elbo = topic_score()
+                          + estimate_document_log_likelihood(pool, data, doc_topic_dirichlets, doc_topic_geoexp);
+            progress.elbo_seconds = seconds_since(phase_start);
+        }
+
+        phase_start = std::chrono::steady_clock::now();
+        topic_word_dirichlets_ = static_cast<T>(config_.topic_word_prior)
+                               + topic_word_statistics(pool, data, doc_topic_geoexp);
+        update_topic_word_geoexp();
 
         double const max_delta = xt::amax(xt::abs(topic_word_dirichlets_ - prev_topic_word_dirichlets))();
-        if (max_delta <= config_.convergence_threshold) {
+        progress.mstep_seconds = seconds_since(phase_start);
+        progress.max_delta = max_delta;
+        progress.converged = max_delta <= config_.convergence_threshold;
+        state.iteration_count = iter + 1;
+
+        bool const stop_requested = observer.callback && !observer.callback(progress);
+        if (progress.converged || stop_requested) {
             break;
         }
         prev_topic_word_dirichlets = topic_word_dirichlets_;
     }
 }
 
-xt::xtensor<double, 2> latent_dirichlet_allocation::transform(
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::partial_fit(xt::xtensor<double, 2> const& data)
+{
+    update(data, data.shape()[0], data.shape()[1]);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::partial_fit(sparse_matrix const& data)
+{
+    update(data, data.row_count(), data.col_count());
+}
+
+template<typename T>
+template<typename Data>
+void basic_latent_dirichlet_allocation<T>::update(Data const& data, std::size_t doc_count, std::size_t word_count)
+{
+    if (topic_word_dirichlets_.size() == 0) {
+        init_topic_word_dirichlets(config_.topic_count, word_count);
+        update_count_ = 0;
+    }
+
+    thread_pool pool{config_.thread_count};
+
+    xt::xtensor<T, 2> doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+    xt::xtensor<T, 2> doc_topic_geoexp;
+    transform(pool, data, doc_topic_dirichlets, doc_topic_geoexp);
+
+    // Natural gradient step towards the estimate obtained by regarding the
+    // minibatch as a sample of the whole corpus.
+    double const rate = std::min(1.0, std::pow(config_.learning_offset + static_cast<double>(update_count_),
+                                               -config_.learning_decay));
+    double const scale = config_.corpus_doc_count && doc_count
+                         ? static_cast<double>(config_.corpus_doc_count) / static_cast<double>(doc_count)
+                         : 1.0;
+
+    T const typed_rate = static_cast<T>(rate);
+
+    topic_word_dirichlets_ = (T(1) - typed_rate) * topic_word_dirichlets_
+                           + typed_rate * (static_cast<T>(config_.topic_word_prior)
+                                           + static_cast<T>(scale) * topic_word_statistics(pool, data, doc_topic_geoexp));
+    update_topic_word_geoexp();
+    update_count_++;
+}
+
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::transform(
         xt::xtensor<double, 2> const& data) const
 {
-    auto const topic_count = config_.topic_count;
+    thread_pool pool{config_.thread_count};
+
+    xt::xtensor<T, 2> doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+    xt::xtensor<T, 2> doc_topic_geoexp;
+    transform(pool, data, doc_topic_dirichlets, doc_topic_geoexp);
+    return doc_topic_dirichlets;
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::transform(
+        thread_pool& pool,
+        xt::xtensor<double, 2> const& data,
+        xt::xtensor<T, 2>& doc_topic_dirichlets,
+        xt::xtensor<T, 2>& doc_topic_geoexp,
+        std::size_t* inner_iteration_count) const
+{
     auto const doc_count = data.shape()[0];
     auto const word_count = data.shape()[1];
+    auto const topic_count = config_.topic_count;
+
+    if (topic_word_dirichlets_.shape()[1] != word_count) {
+        throw std::logic_error("word count mismatch");
+    }
+
+    assert(doc_topic_dirichlets.shape()[0] == doc_count);
+    assert(doc_topic_dirichlets.shape()[1] == topic_count);
+
+    LDA_PROFILE_SCOPE("lda.estep");
+    LDA_PROFILE_COUNT("lda.estep.documents", doc_count);
+    LDA_PROFILE_COUNT("lda.estep.tokens", token_count(data));
+
+    xt::xtensor<T, 2> const& topic_word_geoexp = topic_word_geoexp_;
+
+    doc_topic_geoexp.resize({doc_count, topic_count});
 
-    xt::xtensor<double, 3> doc_word_topic_distr{xt::static_shape<std::size_t, 3>{doc_count, word_count, topic_count}};
+    std::size_t const block_rows = std::min(dense_block_size, doc_count);
+    std::vector<std::size_t> const bounds = balanced_partition(
+        std::vector<std::size_t>(dense_block_count(doc_count), 1), pool.size());
 
-    return transform(data, doc_word_topic_distr);
+    // Per-thread buffers.
+    std::vector<xt::xtensor<T, 2>> doc_word_ratios(
+        pool.size(), xt::xtensor<T, 2>{xt::static_shape<std::size_t, 2>{block_rows, word_count}});
+    std::vector<xt::xtensor<T, 2>> doc_topic_counts(
+        pool.size(), xt::xtensor<T, 2>{xt::static_shape<std::size_t, 2>{block_rows, topic_count}});
+    std::vector<xt::xtensor<T, 2>> active_geoexps(
+        pool.size(), xt::xtensor<T, 2>{xt::static_shape<std::size_t, 2>{block_rows, topic_count}});
+    std::vector<std::vector<std::size_t>> active_docs(pool.size());
+    std::vector<std::size_t> iteration_counts(pool.size());
+
+    // Documents are independent given the topics, so each block is iterated
+    // on its own. Converged documents are dropped from the active set and the
+    // matrix products only cover the remaining ones.
+    parallel_for(pool, bounds, 1, [&](std::size_t block_begin, std::size_t block_end, std::size_t thread) {
+        T* ratio = doc_word_ratios[thread].raw_data();
+        T* counts = doc_topic_counts[thread].raw_data();
+        T* active_geoexp = active_geoexps[thread].raw_data();
+        std::vector<std::size_t>& active = active_docs[thread];
+
+        for (std::size_t block = block_begin; block < block_end; ++block) {
+            std::size_t const begin = block * dense_block_size;
+            std::size_t const end = std::min(begin + dense_block_size, doc_count);
+
+            active.clear();
+            for (std::size_t doc = begin; doc < end; ++doc) {
+                active.push_back(doc);
+            }
+
+            for (int inner_iter = 0; inner_iter < config_.inner_iter_count && !active.empty(); ++inner_iter) {
+                std::size_t const active_count = active.size();
+                iteration_counts[thread] += active_count;
+
+                {
+                    LDA_PROFILE_SCOPE("lda.estep.doc_geoexp");
+                    for (std::size_t i = 0; i < active_count; ++i) {
+                        T* geoexp = &doc_topic_geoexp(active[i], 0);
+                        estep::dirichlet_geometric_expect(&doc_topic_dirichlets(active[i], 0), topic_count, geoexp);
+                        std::copy(geoexp, geoexp + topic_count, active_geoexp + i * topic_count);
+                    }
+                }
+                {
+                    LDA_PROFILE_SCOPE("lda.estep.word_ratio");
+                    compute_doc_word_ratio(data, active_geoexp, topic_word_geoexp, active.data(), active_count,
+                                           ratio);
+                }
+                {
+                    LDA_PROFILE_SCOPE("lda.estep.gemm");
+                    gemm(false, true, active_count, topic_count, word_count,
+                         T(1), ratio, word_count,
+                         topic_word_geoexp.raw_data(), word_count,
+                         T(0), counts, topic_count);
+                }
+
+                std::size_t remaining_count = 0;
+
+                for (std::size_t i = 0; i < active_count; ++i) {
+                    std::size_t const doc = active[i];
+                    double const max_delta = estep::update_doc_topic_dirichlets(
+                        config_.doc_topic_prior, active_geoexp + i * topic_count,
+                        counts + i * topic_count, topic_count,
+                        &doc_topic_dirichlets(doc, 0));
+
+                    if (max_delta > config_.convergence_threshold) {
+                        active[remaining_count++] = doc;
+                    }
+                }
+                active.resize(remaining_count);
+            }
+        }
+    });
+
+    std::size_t const total_iteration_count = std::accumulate(iteration_counts.begin(), iteration_counts.end(),
+                                                              std::size_t{0});
+    LDA_PROFILE_COUNT("lda.estep.inner_iterations", total_iteration_count);
+
+    if (inner_iteration_count) {
+        *inner_iteration_count = total_iteration_count;
+    }
 }
 
-xt::xtensor<double, 2> latent_dirichlet_allocation::transform(
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::topic_word_statistics(
+        thread_pool& pool,
         xt::xtensor<double, 2> const& data,
-        xt::xtensor<double, 3>& doc_word_topic_distr) const
+        xt::xtensor<T, 2> const& doc_topic_geoexp) const
 {
     auto const doc_count = data.shape()[0];
     auto const word_count = data.shape()[1];
     auto const topic_count = config_.topic_count;
 
-    xt::xtensor<double, 2> doc_topic_dirichlets = config_.doc_topic_prior
-                                                + xt::random::rand<double>(xt::static_shape<std::size_t, 2>{doc_count, topic_count});
-    xt::xtensor<double, 2> prev_doc_topic_dirichlets{doc_topic_dirichlets.shape()};
+    LDA_PROFILE_SCOPE("lda.mstep");
 
-    xt::xtensor<double, 2> doc_topic_geoexp{xt::static_shape<std::size_t, 2>{doc_count, topic_count}};
-    xt::xtensor<double, 2> doc_word_topic_norm{xt::static_shape<std::size_t, 2>{doc_count, word_count}};
-    xt::xtensor<double, 2> const topic_word_geoexp = dirichlet_geometric_expect(topic_word_dirichlets_);
+    xt::xtensor<T, 2> const& topic_word_geoexp = topic_word_geoexp_;
 
-    for (int inner_iter = 0; inner_iter < config_.inner_iter_count; ++inner_iter) {
-        xt::noalias(doc_topic_geoexp) = dirichlet_geometric_expect(doc_topic_dirichlets);
+    std::size_t const block_rows = std::min(dense_block_size, doc_count);
+    std::vector<std::size_t> const bounds = balanced_partition(
+        std::vector<std::size_t>(dense_block_count(doc_count), 1), pool.size());
 
-        xt::noalias(doc_word_topic_distr) = ijk::ik(doc_topic_geoexp) * ijk::kj(topic_word_geoexp);
-        xt::noalias(doc_word_topic_norm) = 1 / (xt::sum(doc_word_topic_distr, {2}) + epsilon);
-        xt::noalias(doc_word_topic_distr) *= ijk::ij(doc_word_topic_norm);
+    // Each thread accumulates the statistics of a fixed range of blocks and
+    // the partial sums are reduced in order, so the result does not depend
+    // on thread scheduling.
+    std::vector<xt::xtensor<T, 2>> partial_stats(pool.size());
 
-        xt::noalias(doc_topic_dirichlets) = config_.doc_topic_prior
-                                          + xt::sum(ijk::ij(data) * doc_word_topic_distr, {1});
+    pool.run([&](std::size_t thread) {
+        xt::xtensor<T, 2> doc_word_ratio{xt::static_shape<std::size_t, 2>{block_rows, word_count}};
+        xt::xtensor<T, 2> topic_word_stats = xt::zeros<T>({topic_count, word_count});
 
-        double const max_delta = xt::amax(xt::abs(doc_topic_dirichlets - prev_doc_topic_dirichlets))();
-        if (max_delta <= config_.convergence_threshold) {
-            break;
+        for (std::size_t block = bounds[thread]; block < bounds[thread + 1]; ++block) {
+            std::size_t const begin = block * dense_block_size;
+            std::size_t const end = std::min(begin + dense_block_size, doc_count);
+
+            compute_doc_word_ratio(data, doc_topic_geoexp, topic_word_geoexp, begin, end, doc_word_ratio.raw_data());
+
+            gemm(true, false, topic_count, word_count, end - begin,
+                 T(1), doc_topic_geoexp.raw_data() + begin * topic_count, topic_count,
+                 doc_word_ratio.raw_data(), word_count,
+                 T(1), topic_word_stats.raw_data(), word_count);
         }
-        xt::noalias(prev_doc_topic_dirichlets) = doc_topic_dirichlets;
+
+        partial_stats[thread] = std::move(topic_word_stats);
+    });
+
+    xt::xtensor<T, 2> topic_word_stats = std::move(partial_stats[0]);
+    for (std::size_t thread = 1; thread < partial_stats.size(); ++thread) {
+        topic_word_stats += partial_stats[thread];
     }
 
-    return doc_topic_dirichlets;
+    return topic_word_stats * topic_word_geoexp;
 }
 
-double latent_dirichlet_allocation::score(
-        xt::xtensor<double, 2> const& data) const
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::transform(
+        sparse_matrix const& data) const
 {
-    auto const doc_count = data.shape()[0];
-    auto const word_count = data.shape()[1];
+    inference_workspace workspace;
+    T const* const doc_topic_dirichlets = transform(data, workspace);
+
+    xt::xtensor<T, 2> result{xt::static_shape<std::size_t, 2>{data.row_count(), config_.topic_count}};
+    std::copy(doc_topic_dirichlets, doc_topic_dirichlets + result.size(), result.raw_data());
+    return result;
+}
+
+template<typename T>
+T const* basic_latent_dirichlet_allocation<T>::transform(sparse_matrix const& data,
+                                                         inference_workspace& workspace) const
+{
+    return inference_table().transform(data, workspace);
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::transform(
+        thread_pool& pool,
+        sparse_matrix const& data,
+        xt::xtensor<T, 2>& doc_topic_dirichlets,
+        xt::xtensor<T, 2>& doc_topic_geoexp,
+        std::size_t* inner_iteration_count) const
+{
+    auto const doc_count = data.row_count();
+    auto const word_count = data.col_count();
     auto const topic_count = config_.topic_count;
 
-    xt::xtensor<double, 3> doc_word_topic_distr{xt::static_shape<std::size_t, 3>{doc_count, word_count, topic_count}};
-    xt::xtensor<double, 2> doc_topic_dirichlets = transform(data, doc_word_topic_distr);
+    if (topic_word_dirichlets_.shape()[1] != word_count) {
+        throw std::logic_error("word count mismatch");
+    }
+
+    assert(doc_topic_dirichlets.shape()[0] == doc_count);
+    assert(doc_topic_dirichlets.shape()[1] == topic_count);
+
+    LDA_PROFILE_SCOPE("lda.estep");
+    LDA_PROFILE_COUNT("lda.estep.documents", doc_count);
+    LDA_PROFILE_COUNT("lda.estep.tokens", token_count(data));
+    LDA_PROFILE_COUNT("lda.estep.nonzeros", data.nonzero_count());
+
+    doc_topic_geoexp.resize({doc_count, topic_count});
+
+    std::vector<std::size_t> const bounds = balanced_partition(document_weights(data), pool.size());
+
+    // Per-thread buffers.
+    std::vector<xt::xtensor<T, 1>> doc_topic_counts(
+        pool.size(), xt::xtensor<T, 1>{xt::static_shape<std::size_t, 1>{topic_count}});
+
+    estep::iteration_options const options = {
+        config_.doc_topic_prior, config_.inner_iter_count, config_.convergence_threshold
+    };
+
+    std::vector<std::size_t> iteration_counts(pool.size());
+
+    // Each document is iterated until its own parameters converge.
+    parallel_for(pool, bounds, sparse_chunk_size, [&](std::size_t begin, std::size_t end, std::size_t thread) {
+        T* counts = doc_topic_counts[thread].raw_data();
+        std::size_t iteration_count = 0;
+
+        for (std::size_t doc = begin; doc < end; ++doc) {
+            int const iter_count = estep::fit_sparse_document(
+                data.row(doc), word_topic_geoexp_.data(), word_stride_, topic_count,
+                options, &doc_topic_dirichlets(doc, 0), &doc_topic_geoexp(doc, 0), counts);
+            iteration_count += static_cast<std::size_t>(iter_count);
+        }
+        iteration_counts[thread] += iteration_count;
+    });
+
+    std::size_t const total_iteration_count = std::accumulate(iteration_counts.begin(), iteration_counts.end(),
+                                                              std::size_t{0});
+    LDA_PROFILE_COUNT("lda.estep.inner_iterations", total_iteration_count);
+
+    if (inner_iteration_count) {
+        *inner_iteration_count = total_iteration_count;
+    }
+}
+
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::topic_word_statistics(
+        thread_pool& pool,
+        sparse_matrix const& data,
+        xt::xtensor<T, 2> const& doc_topic_geoexp) const
+{
+    auto const word_count = data.col_count();
+    auto const topic_count = config_.topic_count;
+
+    LDA_PROFILE_SCOPE("lda.mstep");
+
+    std::vector<std::size_t> const bounds = balanced_partition(document_weights(data), pool.size());
+
+    // Each thread accumulates the statistics of a fixed range of documents
+    // and the partial sums are reduced in order, so the result does not
+    // depend on thread scheduling.
+    std::vector<xt::xtensor<T, 2>> partial_stats(pool.size());
+
+    pool.run([&](std::size_t thread) {
+        xt::xtensor<T, 2> word_topic_stats = xt::zeros<T>({word_count, topic_count});
+
+        for (std::size_t doc = bounds[thread]; doc < bounds[thread + 1]; ++doc) {
+            sparse_matrix::row_view const row = data.row(doc);
+            T const* geoexp = &doc_topic_geoexp(doc, 0);
+
+            for (std::size_t i = 0; i < row.size; ++i) {
+                T const* word_geoexp = word_topic_geoexp_.data() + row.indices[i] * word_stride_;
+                T* stats = &word_topic_stats(row.indices[i], 0);
+
+                T norm = 0;
+                for (std::size_t k = 0; k < topic_count; ++k) {
+                    norm += geoexp[k] * word_geoexp[k];
+                }
+                T const scale = static_cast<T>(row.values[i] / (norm + estep::epsilon));
+
+                for (std::size_t k = 0; k < topic_count; ++k) {
+                    stats[k] += scale * geoexp[k] * word_geoexp[k];
+                }
+            }
+        }
+
+        partial_stats[thread] = std::move(word_topic_stats);
+    });
+
+    xt::xtensor<T, 2> word_topic_stats = std::move(partial_stats[0]);
+    for (std::size_t thread = 1; thread < partial_stats.size(); ++thread) {
+        word_topic_stats += partial_stats[thread];
+    }
+
+    return xt::transpose(word_topic_stats);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::score(
+        xt::xtensor<double, 2> const& data) const
+{
+    return topic_score() + document_score(data);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::score(sparse_matrix const& data) const
+{
+    return topic_score() + document_score(data);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::document_score(
+        xt::xtensor<double, 2> const& data) const
+{
+    thread_pool pool{config_.thread_count};
+    return score_batch(pool, data);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::document_score(sparse_matrix const& data) const
+{
+    inference_workspace workspace;
+    return document_score(data, workspace);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::document_score(sparse_matrix const& data,
+                                                            inference_workspace& workspace) const
+{
+    basic_inference_table<T> const table = inference_table();
+    std::size_t const doc_count = data.row_count();
+
+    // Large data is scored in batches, so that the buffers of workspace
+    // stay proportional to the batch size.
+    if (doc_count <= score_batch_size) {
+        return table.document_score(data, workspace);
+    }
+
+    double result = 0;
+    for (std::size_t begin = 0; begin < doc_count; begin += score_batch_size) {
+        std::size_t const end = std::min(begin + score_batch_size, doc_count);
+        result += table.document_score(data.rows(begin, end), workspace);
+    }
+    return result;
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::topic_score() const
+{
+    return dirichlet_log_likelihood(topic_word_dirichlets_.raw_data(),
+                                    topic_word_dirichlets_.shape()[0],
+                                    topic_word_dirichlets_.shape()[1],
+                                    config_.topic_word_prior);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::score_batch(thread_pool& pool,
+                                                        xt::xtensor<double, 2> const& data) const
+{
+    std::size_t const doc_count = data.shape()[0];
+
+    // Small data is scored without copying.
+    if (doc_count <= score_batch_size) {
+        xt::xtensor<T, 2> doc_topic_dirichlets = init_doc_topic_dirichlets(data);
+        xt::xtensor<T, 2> doc_topic_geoexp;
+        transform(pool, data, doc_topic_dirichlets, doc_topic_geoexp);
+
+        return estimate_document_log_likelihood(pool, data, doc_topic_dirichlets, doc_topic_geoexp);
+    }
 
-    return estimate_log_likelihood(data, doc_topic_dirichlets, doc_word_topic_distr);
+    double result = 0;
+    for (std::size_t begin = 0; begin < doc_count; begin += score_batch_size) {
+        std::size_t const end = std::min(begin + score_batch_size, doc_count);
+        result += score_batch(pool, batch_rows(data, begin, end));
+    }
+    return result;
+}
+
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::init_doc_topic_dirichlets(
+        xt::xtensor<double, 2> const& data) const
+{
+    std::size_t const doc_count = data.shape()[0];
+    std::size_t const word_count = data.shape()[1];
+
+    xt::xtensor<T, 2> doc_topic_dirichlets{xt::static_shape<std::size_t, 2>{doc_count, config_.topic_count}};
+    for (std::size_t doc = 0; doc < doc_count; ++doc) {
+        std::uint64_t const key = estep::document_key(config_.seed, &data(doc, 0), word_count);
+        estep::init_doc_topic_dirichlets(key, config_.doc_topic_prior, config_.topic_count,
+                                         &doc_topic_dirichlets(doc, 0));
+    }
+    return doc_topic_dirichlets;
 }
 
-xt::xtensor<double, 2> latent_dirichlet_allocation::topic_word_dirichlets() const
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::init_doc_topic_dirichlets(sparse_matrix const& data) const
+{
+    std::size_t const doc_count = data.row_count();
+
+    xt::xtensor<T, 2> doc_topic_dirichlets{xt::static_shape<std::size_t, 2>{doc_count, config_.topic_count}};
+    for (std::size_t doc = 0; doc < doc_count; ++doc) {
+        std::uint64_t const key = estep::document_key(config_.seed, data.row(doc));
+        estep::init_doc_topic_dirichlets(key, config_.doc_topic_prior, config_.topic_count,
+                                         &doc_topic_dirichlets(doc, 0));
+    }
+    return doc_topic_dirichlets;
+}
+
+template<typename T>
+xt::xtensor<T, 2> basic_latent_dirichlet_allocation<T>::topic_word_dirichlets() const
 {
     return topic_word_dirichlets_;
 }
 
-void latent_dirichlet_allocation::init_topic_word_dirichlets(
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::init_topic_word_dirichlets(
         std::size_t topic_count, std::size_t word_count)
 {
     xt::xtensor<double, 2> const& preconditions = config_.topic_word_preconditions;
 
     if (preconditions.size() == 0) {
         randomize_topic_word_dirichlets(topic_count, word_count);
+        update_topic_word_geoexp();
         return;
     }
 
-    if (config_.topic_word_preconditions.shape()[1] != word_count) {
+    if (preconditions.shape()[1] != word_count) {
         throw std::domain_error(
             "training word count is inconsistent with the shape of "
             "topic_word_preconditions");
     }
 
-    topic_word_dirichlets_ = config_.topic_word_prior + config_.topic_word_preconditions;
+    double const prior = config_.topic_word_prior;
+
+    topic_word_dirichlets_.resize(preconditions.shape());
+    std::transform(preconditions.begin(), preconditions.end(), topic_word_dirichlets_.begin(),
+                   [=](double value) { return static_cast<T>(prior + value); });
+    update_topic_word_geoexp();
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::update_topic_word_geoexp()
+{
+    LDA_PROFILE_SCOPE("lda.topic_word_geoexp");
+
+    word_stride_ = basic_lda_inference<T>::word_stride(topic_word_dirichlets_.shape()[0]);
+    word_topic_geoexp_.resize(topic_word_dirichlets_.shape()[1] * word_stride_);
+    basic_lda_inference<T>::compute_word_topic_geoexp(topic_word_dirichlets_, word_stride_,
+                                                      word_topic_geoexp_.data());
+
+    auto const topic_count = topic_word_dirichlets_.shape()[0];
+    auto const word_count = topic_word_dirichlets_.shape()[1];
+
+    topic_word_geoexp_.resize({topic_count, word_count});
+    for (std::size_t w = 0; w < word_count; ++w) {
+        for (std::size_t k = 0; k < topic_count; ++k) {
+            topic_word_geoexp_(k, w) = word_topic_geoexp_[w * word_stride_ + k];
+        }
+    }
 }
 
-void latent_dirichlet_allocation::randomize_topic_word_dirichlets(
+template<typename T>
+basic_inference_table<T> basic_latent_dirichlet_allocation<T>::inference_table() const
+{
+    return basic_inference_table<T>{config_, topic_word_dirichlets_.shape()[1], word_stride_,
+                                    word_topic_geoexp_.data()};
+}
+
+template<typename T>
+void basic_latent_dirichlet_allocation<T>::randomize_topic_word_dirichlets(
         std::size_t topic_count, std::size_t word_count)
 {
-    topic_word_dirichlets_ = config_.topic_word_prior
-                           + xt::random::rand<double>(xt::static_shape<std::size_t, 2>{topic_count, word_count});
+    std::uint64_t const key = counter_rng::derive_key(config_.seed, counter_rng::topic_word_stream);
+    T const prior = static_cast<T>(config_.topic_word_prior);
+
+    topic_word_dirichlets_.resize({topic_count, word_count});
+    T* values = topic_word_dirichlets_.raw_data();
+    for (std::size_t i = 0; i < topic_count * word_count; ++i) {
+        values[i] = prior + counter_rng::uniform<T>(key, i);
+    }
 }
 
-double latent_dirichlet_allocation::estimate_log_likelihood(
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::estimate_document_log_likelihood(
+        thread_pool& pool,
         xt::xtensor<double, 2> const& data,
-        xt::xtensor<double, 2> const& doc_topic_dirichlets,
-        xt::xtensor<double, 3> const& doc_word_topic_distr) const
+        xt::xtensor<T, 2> const& doc_topic_dirichlets,
+        xt::xtensor<T, 2> const& doc_topic_geoexp) const
 {
-    auto const topic_word_shape = topic_word_dirichlets_.shape();
-    auto const topic_count = topic_word_shape[0];
-    auto const word_count = topic_word_shape[1];
+    auto const doc_count = data.shape()[0];
+    auto const topic_count = topic_word_dirichlets_.shape()[0];
+    auto const word_count = topic_word_dirichlets_.shape()[1];
 
     if (data.shape()[1] != word_count) {
         throw std::logic_error("word count mismatch");
     }
 
-    xt::xtensor<double, 2> const doc_topic_logexp = dirichlet_log_expect(doc_topic_dirichlets);
-    xt::xtensor<double, 2> const topic_word_logexp = dirichlet_log_expect(topic_word_dirichlets_);
+    LDA_PROFILE_SCOPE("lda.document_likelihood");
+
+    xt::xtensor<T, 2> const& topic_word_geoexp = topic_word_geoexp_;
+
+    std::size_t const block_rows = std::min(dense_block_size, doc_count);
+    std::vector<std::size_t> const bounds = balanced_partition(
+        std::vector<std::size_t>(dense_block_count(doc_count), 1), pool.size());
+
+    // Partial sums of fixed ranges of blocks, added in order so that the
+    // result does not depend on thread scheduling.
+    std::vector<double> partial_sums(pool.size());
+
+    pool.run([&](std::size_t thread) {
+        xt::xtensor<T, 2> doc_word_norm{xt::static_shape<std::size_t, 2>{block_rows, word_count}};
+        double sum = 0;
+
+        for (std::size_t block = bounds[thread]; block < bounds[thread + 1]; ++block) {
+            std::size_t const begin = block * dense_block_size;
+            std::size_t const end = std::min(begin + dense_block_size, doc_count);
+
+            gemm(false, false, end - begin, word_count, topic_count,
+                 T(1), doc_topic_geoexp.raw_data() + begin * topic_count, topic_count,
+                 topic_word_geoexp.raw_data(), word_count,
+                 T(0), doc_word_norm.raw_data(), word_count);
+
+            // With the optimal document-word-topic distribution the word term
+            // of the lower bound reduces to sum_dw data(d, w) log norm(d, w),
+            // where norm is the normalizer of the distribution.
+            double const* counts = data.raw_data() + begin * word_count;
+            T const* norms = doc_word_norm.raw_data();
+
+            for (std::size_t i = 0; i < (end - begin) * word_count; ++i) {
+                if (counts[i] != 0) {
+                    sum += counts[i] * std::log(norms[i] + estep::epsilon);
+                }
+            }
+
+            sum += dirichlet_log_likelihood(&doc_topic_dirichlets(begin, 0), end - begin, topic_count,
+                                            config_.doc_topic_prior);
+        }
+
+        partial_sums[thread] = sum;
+    });
+
+    return std::accumulate(partial_sums.begin(), partial_sums.end(), 0.0);
+}
+
+template<typename T>
+double basic_latent_dirichlet_allocation<T>::estimate_document_log_likelihood(
+        thread_pool& pool,
+        sparse_matrix const& data,
+        xt::xtensor<T, 2> const& doc_topic_dirichlets,
+        xt::xtensor<T, 2> const& doc_topic_geoexp) const
+{
+    auto const topic_count = topic_word_dirichlets_.shape()[0];
+    auto const word_count = topic_word_dirichlets_.shape()[1];
+
+    if (data.col_count() != word_count) {
+        throw std::logic_error("word count mismatch");
+    }
+
+    LDA_PROFILE_SCOPE("lda.document_likelihood");
 
-    xt::xtensor<double, 1> const doc_topic_prior(xt::static_shape<std::size_t, 1>{topic_count}, config_.doc_topic_prior);
-    xt::xtensor<double, 1> const topic_word_prior(xt::static_shape<std::size_t, 1>{word_count}, config_.topic_word_prior);
+    std::vector<std::size_t> const bounds = balanced_partition(document_weights(data), pool.size());
 
-    auto const L_dt = xt::sum(xt::sum((config_.doc_topic_prior - doc_topic_dirichlets) * doc_topic_logexp, {1})
-                              + log_beta(doc_topic_dirichlets)
-                              - log_beta(doc_topic_prior));
+    std::vector<double> partial_sums(pool.size());
 
-    auto const L_tw = xt::sum(xt::sum((config_.topic_word_prior - topic_word_dirichlets_) * topic_word_logexp, {1})
-                              + log_beta(topic_word_dirichlets_)
-                              - log_beta(topic_word_prior));
+    pool.run([&](std::size_t thread) {
+        double sum = 0;
 
-    auto const doc_word_topic_X = doc_word_topic_distr * ijk::ij(data);
-    auto const L_dwt = xt::sum(doc_word_topic_X * (ijk::ik(doc_topic_logexp)
-                               + ijk::kj(topic_word_logexp)
-                               - xt::log(doc_word_topic_distr + epsilon)));
+        for (std::size_t doc = bounds[thread]; doc < bounds[thread + 1]; ++doc) {
+            sum += estep::word_log_likelihood(data.row(doc), &doc_topic_geoexp(doc, 0),
+                                              word_topic_geoexp_.data(), word_stride_, topic_count);
+        }
+
+        std::size_t const begin = bounds[thread];
+        std::size_t const end = bounds[thread + 1];
+        if (begin < end) {
+            sum += dirichlet_log_likelihood(&doc_topic_dirichlets(begin, 0), end - begin, topic_count,
+                                            config_.doc_topic_prior);
+        }
+
+        partial_sums[thread] = sum;
+    });
 
-    return (L_dt + L_tw + L_dwt)();
+    return std::accumulate(partial_sums.begin(), partial_sums.end(), 0.0);
 }
 
-latent_dirichlet_allocation::config const& latent_dirichlet_allocation::get_config() const
+template<typename T>
+std::size_t basic_latent_dirichlet_allocation<T>::update_count() const
+{
+    return update_count_;
+}
+
+template<typename T>
+lda_config const& basic_latent_dirichlet_allocation<T>::get_config() const
 {
     return config_;
 }
+
+template class basic_latent_dirichlet_allocation<double>;
+template class basic_latent_dirichlet_allocation<float>;
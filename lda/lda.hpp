@@ -1,80 +1,330 @@
 #ifndef INCLUDED_LDA_HPP
 #define INCLUDED_LDA_HPP
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
 
 #include <xtensor/xtensor.hpp>
 
+#include "aligned_allocator.hpp"
+#include "sparse_matrix.hpp"
 
-class latent_dirichlet_allocation
+
+class inference_workspace;
+class thread_pool;
+
+template<typename T>
+class basic_inference_table;
+
+// Training algorithms of latent_dirichlet_allocation.
+enum class lda_engine
 {
-  public:
+    // Batch variational Bayes.
+    variational,
+
+    // Collapsed Gibbs sampling.
+    gibbs,
+};
+
+// Hyperparameters for latent_dirichlet_allocation.
+struct lda_config
+{
+    // The number of topics.
+    std::size_t topic_count = 2;
+
+    // Optional preconditioning for topic-word dirichlet parameters.
+    //
+    // If set, the topic-word dirichlet parameters are initialized to
+    // `topic_word_prior + topic_word_preconditions` at the beginning of
+    // each training.
+    xt::xtensor<double, 2> topic_word_preconditions = {{}};
+
+    // Symmetric prior for document-topic dirichlet parameters.
+    double doc_topic_prior = 1;
+
+    // Symmetric prior for topic-word dirichlet parameters.
+    double topic_word_prior = 1;
+
+    // The maximum number of iterations for fitting topic-word dirichlet
+    // parameters. The worst-case time complexity of fit operation is
+    // proportional to this count.
+    int outer_iter_count = 100;
+
+    // The maximum number of iterations for fitting document-topic
+    // dirichlet parameters. The worst-case time complexity of fit and
+    // transform operations are proportional to this count.
+    int inner_iter_count = 100;
+
+    // The number of first iterations of fit that restart the document-topic
+    // parameters from their initial values. Later iterations start from the
+    // estimate of the previous one, which is close to the fixed point once
+    // the topics settle and needs only a few inner iterations. Keeping the
+    // estimate while the topics still move a lot locks documents into their
+    // first topics and leads to poor local optima. Zero keeps it from the
+    // second iteration on.
+    int restart_iter_count = 10;
+
+    // Fitting iteration is stopped earlily if the maximum absolute change
+    // of dirichlet parameters is less than this threshold. Document-topic
+    // parameters are checked per document, so a document stops iterating
+    // as soon as it converges regardless of the others.
+    double convergence_threshold = 1e-4;
+
+    // The number of threads used in fit, partial_fit, transform and
+    // score. Documents are distributed among the threads. The result
+    // does not depend on thread scheduling but the summation order of
+    // topic-word statistics, and hence rounding, depends on this count.
+    std::size_t thread_count = 1;
+
+    // Learning rate parameters for online training. The topic-word
+    // dirichlet parameters are updated by the t-th (zero-based) call of
+    // partial_fit with the weight `(learning_offset + t)^-learning_decay`.
+    // learning_decay should be in (0.5, 1] for convergence.
+    double learning_offset = 10;
+    double learning_decay = 0.7;
 
-    // Hyperparameters for latent_dirichlet_allocation.
-    struct config
-    {
-        // The number of topics.
-        std::size_t topic_count = 2;
+    // The total number of documents in the corpus for online training.
+    // Statistics of each minibatch are scaled to this corpus size. If
+    // zero, each minibatch is regarded as the whole corpus.
+    std::size_t corpus_doc_count = 0;
 
-        // Optional preconditioning for topic-word dirichlet parameters.
-        //
-        // If set, the topic-word dirichlet parameters are initialized to
-        // `topic_word_prior + topic_word_preconditions` at the beginning of
-        // each training.
-        xt::xtensor<double, 2> topic_word_preconditions = {{}};
+    // The algorithm used by fit. The gibbs engine runs outer_iter_count
+    // sweeps of collapsed Gibbs sampling on a single thread and sets the
+    // topic-word dirichlet parameters to topic_word_prior plus the sampled
+    // topic-word counts, which is the same form as the variational
+    // parameters. topic_word_preconditions is not used by the gibbs engine.
+    // partial_fit, transform and score use variational Bayes regardless of
+    // the engine.
+    lda_engine engine = lda_engine::variational;
 
-        // Symmetric prior for document-topic dirichlet parameters.
-        double doc_topic_prior = 1;
+    // Seed of the random initial values of the topic-word parameters, the
+    // document-topic parameters and the Gibbs sampler. The random numbers
+    // are counter-based: those of a document are a function of the seed and
+    // its word counts, so the result for a document does not depend on the
+    // other documents in the call, the batch sizes or the threads, and a
+    // const model can transform on many threads without synchronization.
+    std::uint64_t seed = 0;
+};
 
-        // Symmetric prior for topic-word dirichlet parameters.
-        double topic_word_prior = 1;
+// Progress of fit after an outer iteration.
+struct fit_progress
+{
+    // The iteration counted from zero.
+    int iteration = 0;
 
-        // The maximum number of iterations for fitting topic-word dirichlet
-        // parameters. The worst-case time complexity of fit operation is
-        // proportional to this count.
-        int outer_iter_count = 100;
+    // The maximum absolute change of the topic-word dirichlet parameters in
+    // the iteration. Training stops when it is at most the convergence
+    // threshold, which sets converged.
+    double max_delta = std::numeric_limits<double>::quiet_NaN();
+    bool converged = false;
 
-        // The maximum number of iterations for fitting document-topic
-        // dirichlet parameters. The worst-case time complexity of fit and
-        // transform operations are proportional to this count.
-        int inner_iter_count = 100;
+    // The mean number of inner iterations the documents went through.
+    double mean_inner_iterations = std::numeric_limits<double>::quiet_NaN();
 
-        // Fitting iteration is stopped earlily if the maximum absolute change
-        // of dirichlet parameters is less than this threshold.
-        double convergence_threshold = 1e-4;
-    };
+    // Wall time in seconds of fitting the document-topic parameters (the
+    // E-step), of computing elbo and of updating the topic-word parameters
+    // (the M-step).
+    double estep_seconds = 0;
+    double elbo_seconds = 0;
+    double mstep_seconds = 0;
+
+    // The evidence lower bound of the document-topic parameters fitted in
+    // the iteration and the topic-word parameters they were fitted to, which
+    // is what score computes. NaN unless requested.
+    double elbo = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Observer of fit, called after each outer iteration.
+struct fit_observer
+{
+    // Receives the progress. Returning false stops training after the
+    // iteration, keeping the parameters updated so far.
+    std::function<bool(fit_progress const&)> callback;
+
+    // Whether to compute fit_progress::elbo, which costs about as much as
+    // the M-step.
+    bool compute_elbo = false;
+};
+
+// State of batch variational training besides the topic-word parameters,
+// which lets fit resume where an interrupted fit stopped.
+template<typename T>
+struct basic_fit_state
+{
+    // The number of outer iterations completed.
+    int iteration_count = 0;
+
+    // The document-topic dirichlet parameters, from which the next E-step
+    // starts. If empty on resumption, they are initialized randomly and
+    // training continues from the topics instead of exactly where it
+    // stopped.
+    xt::xtensor<T, 2> doc_topic_dirichlets = {{}};
+};
+
+// Latent Dirichlet allocation trained by variational Bayes. The model
+// parameters and the computations use scalar type T, which is float or
+// double. Input data is given in double precision either way.
+template<typename T>
+class basic_latent_dirichlet_allocation
+{
+  public:
+    using value_type = T;
+    using tensor_type = xt::xtensor<T, 2>;
+    using config = lda_config;
+    using fit_state = basic_fit_state<T>;
 
     // Creates an untrained model with given configuration.
-    explicit latent_dirichlet_allocation(config const& conf);
+    explicit basic_latent_dirichlet_allocation(config const& conf);
 
     // Creates a trained model with given configuration and topic-word
-    // dirichlet parameters.
-    latent_dirichlet_allocation(config const& conf,
-                                xt::xtensor<double, 2> const& topic_word_dirichlets);
+    // dirichlet parameters. update_count is the number of online updates
+    // the parameters have gone through.
+    basic_latent_dirichlet_allocation(config const& conf,
+                                      tensor_type const& topic_word_dirichlets,
+                                      std::size_t update_count = 0);
+
+    // Converts a model of another precision.
+    template<typename U>
+    explicit basic_latent_dirichlet_allocation(basic_latent_dirichlet_allocation<U> const& other);
 
     // Trains the model with given data.
     void fit(xt::xtensor<double, 2> const& data);
 
+    // Trains the model with given sparse data. Only nonzero elements are
+    // visited, so the cost of an iteration is proportional to the number of
+    // nonzero elements.
+    void fit(sparse_matrix const& data);
+
+    // Trains the model like fit(data), reporting the progress to observer
+    // after each iteration. The gibbs engine reports each sweep with the
+    // sweep time as estep_seconds; the other statistics are NaN.
+    void fit(xt::xtensor<double, 2> const& data, fit_observer const& observer);
+    void fit(sparse_matrix const& data, fit_observer const& observer);
+
+    // Trains the model like fit(data, observer), continuing from state. A
+    // default state starts a new training. Otherwise the state and the
+    // topic-word parameters of this model are those saved after an
+    // iteration of an interrupted fit with the same data and
+    // configuration, and training resumes from them. state is updated after
+    // each iteration before the observer is called, so the observer can
+    // save a checkpoint. Throws std::invalid_argument if the state does not
+    // match the data or the engine is gibbs.
+    void fit(xt::xtensor<double, 2> const& data, fit_observer const& observer, fit_state& state);
+    void fit(sparse_matrix const& data, fit_observer const& observer, fit_state& state);
+
+    // Updates the model with a minibatch using online variational Bayes.
+    // Unlike fit, the current topic-word dirichlet parameters are kept and
+    // moved towards the estimate from the minibatch. An untrained model is
+    // initialized on the first call.
+    void partial_fit(xt::xtensor<double, 2> const& data);
+
+    // Updates the model with a sparse minibatch using online variational
+    // Bayes.
+    void partial_fit(sparse_matrix const& data);
+
     // Computes the document-topic dirichlet parameters for given data using a
     // trained model.
-    xt::xtensor<double, 2> transform(
+    tensor_type transform(
             xt::xtensor<double, 2> const& data) const;
 
-    // Estimates log-likelihood of given data for a trained model.
+    // Computes the document-topic dirichlet parameters for given sparse data
+    // using a trained model.
+    tensor_type transform(sparse_matrix const& data) const;
+
+    // Computes the document-topic dirichlet parameters for given sparse data
+    // in workspace like basic_lda_inference::transform. Returns topic_count
+    // parameters for each document in row-major order, which are valid until
+    // the next call with workspace.
+    T const* transform(sparse_matrix const& data, inference_workspace& workspace) const;
+
+    // Estimates log-likelihood of given data for a trained model. Documents
+    // are processed in batches, so the memory used besides the data is
+    // proportional to the batch size instead of the document count.
     double score(xt::xtensor<double, 2> const& data) const;
 
+    // Estimates log-likelihood of given sparse data for a trained model.
+    double score(sparse_matrix const& data) const;
+
+    // Estimates the terms of score that depend on documents. The terms are
+    // additive over documents, so a corpus that does not fit in memory can
+    // be scored by summing this over batches and adding topic_score once.
+    double document_score(xt::xtensor<double, 2> const& data) const;
+
+    // Estimates the terms of score that depend on given sparse documents.
+    double document_score(sparse_matrix const& data) const;
+
+    // Estimates the terms of score that depend on given sparse documents,
+    // using workspace.
+    double document_score(sparse_matrix const& data, inference_workspace& workspace) const;
+
+    // Returns the term of score that depends only on the topic-word
+    // dirichlet parameters.
+    double topic_score() const;
+
     // Returns the topic-word dirichlet parameters of a trained model.
-    xt::xtensor<double, 2> topic_word_dirichlets() const;
+    tensor_type topic_word_dirichlets() const;
+
+    // Returns the number of online updates applied by partial_fit.
+    std::size_t update_count() const;
 
     // Returns the config object.
     config const& get_config() const;
 
   private:
-    // Computes the document-topic dirichlet parameters and document-word-topic
-    // distribution for a trained (or on-being-trained) model.
-    xt::xtensor<double, 2> transform(
+    // Trains the model with sparse data by collapsed Gibbs sampling.
+    void train_gibbs(sparse_matrix const& data, fit_observer const& observer);
+
+    // Trains the model with dense or sparse data.
+    template<typename Data>
+    void train(Data const& data, std::size_t doc_count, std::size_t word_count, fit_observer const& observer,
+               fit_state& state);
+
+    // Updates the model with a dense or sparse minibatch.
+    template<typename Data>
+    void update(Data const& data, std::size_t doc_count, std::size_t word_count);
+
+    // Creates randomly initialized document-topic dirichlet parameters for
+    // dense or sparse data.
+    tensor_type init_doc_topic_dirichlets(xt::xtensor<double, 2> const& data) const;
+    tensor_type init_doc_topic_dirichlets(sparse_matrix const& data) const;
+
+    // Fits the document-topic dirichlet parameters for dense data, starting
+    // from the values given in doc_topic_dirichlets. The geometric
+    // expectation of the document-topic distribution used in the last
+    // iteration is stored to doc_topic_geoexp, which determines the
+    // document-word-topic distribution together with the topic-word
+    // parameters. If inner_iteration_count is not null, the total number of
+    // inner iterations of the documents is stored to it.
+    void transform(
+            thread_pool& pool,
+            xt::xtensor<double, 2> const& data,
+            tensor_type& doc_topic_dirichlets,
+            tensor_type& doc_topic_geoexp,
+            std::size_t* inner_iteration_count = nullptr) const;
+
+    // Computes the expected topic-word counts for dense data.
+    tensor_type topic_word_statistics(
+            thread_pool& pool,
             xt::xtensor<double, 2> const& data,
-            xt::xtensor<double, 3>& doc_word_topic_distr) const;
+            tensor_type const& doc_topic_geoexp) const;
+
+    // Fits the document-topic dirichlet parameters for sparse data.
+    void transform(
+            thread_pool& pool,
+            sparse_matrix const& data,
+            tensor_type& doc_topic_dirichlets,
+            tensor_type& doc_topic_geoexp,
+            std::size_t* inner_iteration_count = nullptr) const;
+
+    // Computes the expected topic-word counts for sparse data.
+    tensor_type topic_word_statistics(
+            thread_pool& pool,
+            sparse_matrix const& data,
+            tensor_type const& doc_topic_geoexp) const;
 
     // Initializes the internal topic-word dirichlet parameters based on the
     // configuration given on construction.
@@ -86,15 +336,70 @@ class latent_dirichlet_allocation
     void randomize_topic_word_dirichlets(
             std::size_t topic_count, std::size_t word_count);
 
-    // Estimates log-likelihood of data with given parameters.
-    double estimate_log_likelihood(
+    // Recomputes the geometric expectation of the topic-word distributions
+    // from the topic-word dirichlet parameters, which must be called
+    // whenever they change.
+    void update_topic_word_geoexp();
+
+    // Returns the inference table of the sparse computations.
+    basic_inference_table<T> inference_table() const;
+
+    // Estimates the document terms of log-likelihood for a dense batch of
+    // documents.
+    double score_batch(thread_pool& pool, xt::xtensor<double, 2> const& data) const;
+
+    // Estimates the document terms of log-likelihood of data with given
+    // parameters.
+    double estimate_document_log_likelihood(
+            thread_pool& pool,
             xt::xtensor<double, 2> const& data,
-            xt::xtensor<double, 2> const& doc_topic_dirichlets,
-            xt::xtensor<double, 3> const& doc_word_topic_distr) const;
+            tensor_type const& doc_topic_dirichlets,
+            tensor_type const& doc_topic_geoexp) const;
+
+    // Estimates the document terms of log-likelihood of sparse data with
+    // given parameters.
+    double estimate_document_log_likelihood(
+            thread_pool& pool,
+            sparse_matrix const& data,
+            tensor_type const& doc_topic_dirichlets,
+            tensor_type const& doc_topic_geoexp) const;
 
   private:
     config config_;
-    xt::xtensor<double, 2> topic_word_dirichlets_ = {{}};
+    tensor_type topic_word_dirichlets_ = {{}};
+    std::size_t update_count_ = 0;
+
+    // The geometric expectation of the topic-word distributions, kept in the
+    // word-major layout of basic_lda_inference with rows of word_stride_
+    // values, so that transform and score do not recompute it. The dense
+    // matrix products read the same values in the topic-major layout.
+    std::size_t word_stride_ = 0;
+    std::vector<T, aligned_allocator<T, 64>> word_topic_geoexp_;
+    tensor_type topic_word_geoexp_ = {{}};
 };
 
+// Models in double and single precision.
+using latent_dirichlet_allocation = basic_latent_dirichlet_allocation<double>;
+using float_latent_dirichlet_allocation = basic_latent_dirichlet_allocation<float>;
+
+extern template class basic_latent_dirichlet_allocation<double>;
+extern template class basic_latent_dirichlet_allocation<float>;
+
+//------------------------------------------------------------------------------
+
+template<typename T>
+template<typename U>
+basic_latent_dirichlet_allocation<T>::basic_latent_dirichlet_allocation(
+        basic_latent_dirichlet_allocation<U> const& other)
+    : config_{other.get_config()}
+    , update_count_{other.update_count()}
+{
+    xt::xtensor<U, 2> const topic_word_dirichlets = other.topic_word_dirichlets();
+
+    topic_word_dirichlets_.resize(topic_word_dirichlets.shape());
+    std::transform(topic_word_dirichlets.begin(), topic_word_dirichlets.end(), topic_word_dirichlets_.begin(),
+                   [](U value) { return static_cast<T>(value); });
+    update_topic_word_geoexp();
+}
+
 #endif
@@ -1,38 +1,52 @@
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <istream>
+#include <memory>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <json.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include "binary_io.hpp"
+#include "inference.hpp"
 #include "lda.hpp"
 #include "lda_io.hpp"
+#include "profile.hpp"
 
 
 namespace
 {
-    nlohmann::json xtensor_to_json(xt::xtensor<double, 2> const& tensor)
+    template<typename T>
+    nlohmann::json xtensor_to_json(xt::xtensor<T, 2> const& tensor)
     {
         return nlohmann::json{
             {"shape", tensor.shape()},
-            {"data", std::vector<double>{tensor.begin(), tensor.end()}}
+            {"data", std::vector<T>{tensor.begin(), tensor.end()}}
         };
     }
 
-    xt::xtensor<double, 2> xtensor_from_json(nlohmann::json const& json)
+    template<typename T>
+    xt::xtensor<T, 2> xtensor_from_json(nlohmann::json const& json)
     {
-        using container = xt::xtensor_container<std::vector<double>,
+        using container = xt::xtensor_container<std::vector<T>,
                                                 2,
                                                 xt::layout_type::row_major>;
 
-        std::vector<double> data = json["data"];
+        std::vector<T> data = json["data"];
         std::array<std::size_t, 2> shape = json["shape"];
 
         return container{std::move(data), std::move(shape), {}};
     }
 
-    nlohmann::json config_to_json(latent_dirichlet_allocation::config const& config)
+    // Returns the config without topic_word_preconditions, which the binary
+    // format stores as an array section.
+    nlohmann::json scalar_config_to_json(latent_dirichlet_allocation::config const& config)
     {
         return nlohmann::json{
 #define X(FIELD) {#FIELD, config.FIELD}
@@ -41,13 +55,25 @@ namespace
             X(topic_word_prior),
             X(outer_iter_count),
             X(inner_iter_count),
+            X(restart_iter_count),
             X(convergence_threshold),
             X(doc_topic_prior),
+            X(learning_offset),
+            X(learning_decay),
+            X(corpus_doc_count),
+            X(seed),
 #undef X
-            {"topic_word_preconditions", xtensor_to_json(config.topic_word_preconditions)}
+            {"engine", engine_to_string(config.engine)}
         };
     }
 
+    nlohmann::json config_to_json(latent_dirichlet_allocation::config const& config)
+    {
+        nlohmann::json json = scalar_config_to_json(config);
+        json["topic_word_preconditions"] = xtensor_to_json(config.topic_word_preconditions);
+        return json;
+    }
+
     latent_dirichlet_allocation::config config_from_json(nlohmann::json const& json)
     {
         latent_dirichlet_allocation::config config;
@@ -61,24 +87,683 @@ namespace
         X(convergence_threshold);
         X(doc_topic_prior);
 #undef X
-        config.topic_word_preconditions = xtensor_from_json(json["topic_word_preconditions"]);
 
+        // Online training and later parameters are missing in old files.
+#define X(FIELD) if (json.count(#FIELD)) config.FIELD = json[#FIELD]
+        X(learning_offset);
+        X(learning_decay);
+        X(corpus_doc_count);
+        X(seed);
+        X(restart_iter_count);
+#undef X
+
+        if (json.count("topic_word_preconditions")) {
+            config.topic_word_preconditions = xtensor_from_json<double>(json["topic_word_preconditions"]);
+        }
+
+        if (json.count("engine")) {
+            config.engine = engine_from_string(json["engine"].get<std::string>());
+        }
+
+        return config;
+    }
+
+    // Name of scalar type T recorded in saved models.
+    template<typename T>
+    char const* scalar_type_name();
+
+    template<>
+    char const* scalar_type_name<double>()
+    {
+        return "float64";
+    }
+
+    template<>
+    char const* scalar_type_name<float>()
+    {
+        return "float32";
+    }
+
+    // Binary model format. Integers and arrays are stored in the native byte
+    // order, which is checked with byte_order_mark on loading.
+    char const binary_magic[8] = {'L', 'D', 'A', 'M', 'O', 'D', 'E', 'L'};
+    constexpr std::uint32_t binary_version = 1;
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    // The header occupies the first two alignment units.
+    constexpr std::size_t binary_header_size = 2 * binary_alignment;
+
+    struct binary_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t scalar_size;
+        std::uint32_t reserved;
+        std::uint64_t topic_count;
+        std::uint64_t word_count;
+        std::uint64_t word_stride;
+        std::uint64_t update_count;
+        std::uint64_t config_offset;
+        std::uint64_t config_size;
+        std::uint64_t topics_offset;
+        std::uint64_t geoexp_offset;
+        std::uint64_t preconditions_offset;
+        std::uint64_t preconditions_rows;
+        std::uint64_t preconditions_columns;
+        std::uint64_t file_size;
+        std::uint64_t checksum;
+    };
+
+    static_assert(sizeof(binary_header) <= binary_header_size, "binary header is too large");
+
+    // Validated contents of a binary model file in memory. config has no
+    // topic_word_preconditions; they are the float64 array at preconditions.
+    struct binary_view
+    {
+        binary_header header;
+        lda_config config;
+        void const* topics;
+        void const* geoexp;
+        double const* preconditions;
+    };
+
+    // Returns true if size bytes at offset fit in a file of file_size bytes.
+    bool section_fits(std::uint64_t offset, std::uint64_t size, std::uint64_t file_size)
+    {
+        return offset <= file_size && size <= file_size - offset;
+    }
+
+    // Checks the fields of a binary model header that identify the format,
+    // which come before any field is trusted.
+    void check_binary_header(binary_header const& header)
+    {
+        if (std::memcmp(header.magic, binary_magic, sizeof binary_magic) != 0) {
+            throw std::runtime_error("not a binary model file");
+        }
+        if (header.byte_order != byte_order_mark) {
+            throw std::runtime_error("model file has a different byte order");
+        }
+        if (header.version != binary_version) {
+            throw std::runtime_error("unsupported model file version");
+        }
+        if (header.scalar_size != sizeof(float) && header.scalar_size != sizeof(double)) {
+            throw std::runtime_error("unsupported model scalar type");
+        }
+    }
+
+    // Validates a binary model file loaded or mapped at data, which is
+    // aligned to at least 8 bytes.
+    binary_view parse_binary(unsigned char const* data, std::size_t size)
+    {
+        if (size < binary_header_size) {
+            throw std::runtime_error("model file is truncated");
+        }
+
+        binary_view view;
+        std::memcpy(&view.header, data, sizeof view.header);
+        binary_header const& header = view.header;
+
+        check_binary_header(header);
+        if (header.file_size != size || size % 8 != 0) {
+            throw std::runtime_error("model file is truncated");
+        }
+
+        std::uint64_t const topic_count = header.topic_count;
+        std::uint64_t const word_count = header.word_count;
+        std::uint64_t const max_elements = size / header.scalar_size;
+        std::uint64_t const preconditions_rows = header.preconditions_rows;
+        std::uint64_t const preconditions_columns = header.preconditions_columns;
+
+        bool const valid_shape = header.word_stride >= topic_count
+                              && (word_count == 0 || topic_count <= max_elements / word_count)
+                              && (word_count == 0 || header.word_stride <= max_elements / word_count)
+                              && (preconditions_columns == 0
+                                  || preconditions_rows <= size / sizeof(double) / preconditions_columns);
+
+        if (!valid_shape
+            || header.topics_offset % binary_alignment != 0
+            || header.geoexp_offset % binary_alignment != 0
+            || header.preconditions_offset % binary_alignment != 0
+            || !section_fits(header.config_offset, header.config_size, size)
+            || !section_fits(header.topics_offset, topic_count * word_count * header.scalar_size, size)
+            || !section_fits(header.geoexp_offset, word_count * header.word_stride * header.scalar_size, size)
+            || !section_fits(header.preconditions_offset,
+                             preconditions_rows * preconditions_columns * sizeof(double), size)) {
+            throw std::runtime_error("model file has an invalid layout");
+        }
+
+        if (compute_checksum(data + binary_header_size, size - binary_header_size) != header.checksum) {
+            throw std::runtime_error("model file checksum mismatch");
+        }
+
+        char const* config_text = reinterpret_cast<char const*>(data + header.config_offset);
+        view.config = config_from_json(nlohmann::json::parse(config_text, config_text + header.config_size));
+        view.topics = data + header.topics_offset;
+        view.geoexp = data + header.geoexp_offset;
+        view.preconditions = reinterpret_cast<double const*>(data + header.preconditions_offset);
+
+        if (view.config.topic_count != topic_count) {
+            throw std::runtime_error("model file has an invalid layout");
+        }
+
+        return view;
+    }
+
+    // Returns the config of a binary model with its topic_word_preconditions.
+    lda_config config_from_binary(binary_view const& view)
+    {
+        lda_config config = view.config;
+
+        std::size_t const rows = view.header.preconditions_rows;
+        std::size_t const columns = view.header.preconditions_columns;
+
+        if (rows * columns != 0) {
+            config.topic_word_preconditions.resize({rows, columns});
+            std::copy(view.preconditions, view.preconditions + rows * columns,
+                      config.topic_word_preconditions.begin());
+        }
         return config;
     }
+
+    // Copies the parameters of a binary model into a model of type T.
+    template<typename T, typename U>
+    basic_latent_dirichlet_allocation<T> model_from_array(binary_view const& view)
+    {
+        std::size_t const topic_count = view.header.topic_count;
+        std::size_t const word_count = view.header.word_count;
+        U const* topics = static_cast<U const*>(view.topics);
+
+        xt::xtensor<T, 2> topic_word_dirichlets{xt::static_shape<std::size_t, 2>{topic_count, word_count}};
+        std::transform(topics, topics + topic_count * word_count, topic_word_dirichlets.begin(),
+                       [](U value) { return static_cast<T>(value); });
+
+        return basic_latent_dirichlet_allocation<T>{config_from_binary(view), topic_word_dirichlets,
+                                                    view.header.update_count};
+    }
+
+    template<typename T>
+    basic_latent_dirichlet_allocation<T> model_from_binary(binary_view const& view)
+    {
+        if (view.header.scalar_size == sizeof(float)) {
+            return model_from_array<T, float>(view);
+        }
+        return model_from_array<T, double>(view);
+    }
+
+    // Checkpoint format: a header, the metadata in JSON padded with spaces,
+    // and the topic-word and document-topic parameters padded with zeros,
+    // each section a multiple of 8 bytes. The checksum covers everything
+    // after the header.
+    char const checkpoint_magic[8] = {'L', 'D', 'A', 'C', 'K', 'P', 'N', 'T'};
+    constexpr std::uint32_t checkpoint_version = 1;
+
+    struct checkpoint_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint32_t scalar_size;
+        std::uint32_t reserved;
+        std::uint64_t metadata_size;
+        std::uint64_t content_size;
+        std::uint64_t checksum;
+    };
+
+    // Rounds size up to a multiple of 8.
+    std::size_t align_word_size(std::size_t size)
+    {
+        return (size + 7) / 8 * 8;
+    }
+
+    // Returns the number of bytes from the position of input to its end, or
+    // -1 if the stream cannot seek. The position is not changed.
+    std::streamoff stream_remaining_size(std::istream& input)
+    {
+        auto const start = input.tellg();
+        if (start < 0 || !input.seekg(0, std::ios::end)) {
+            input.clear();
+            return -1;
+        }
+
+        auto const end = input.tellg();
+        input.seekg(start);
+        return end < 0 ? -1 : end - start;
+    }
+
+    // Returns the number of elements of a shape read from JSON, or throws
+    // if it exceeds max_size.
+    std::size_t shape_size(std::array<std::size_t, 2> const& shape, std::size_t max_size)
+    {
+        if (shape[1] != 0 && shape[0] > max_size / shape[1]) {
+            throw std::runtime_error("checkpoint has an invalid layout");
+        }
+        return shape[0] * shape[1];
+    }
 }
 
-void save_lda(std::ostream& output, latent_dirichlet_allocation const& lda)
+template<typename T>
+void save_lda(std::ostream& output, basic_latent_dirichlet_allocation<T> const& lda)
 {
+    LDA_PROFILE_SCOPE("lda_io.save_json");
+
     output << nlohmann::json{
         {"config", config_to_json(lda.get_config())},
-        {"topics", xtensor_to_json(lda.topic_word_dirichlets())}
+        {"scalar_type", scalar_type_name<T>()},
+        {"topics", xtensor_to_json(lda.topic_word_dirichlets())},
+        {"update_count", lda.update_count()}
     };
 }
 
-latent_dirichlet_allocation load_lda(std::istream& input)
+template<typename T>
+void save_lda_binary(std::ostream& output, basic_latent_dirichlet_allocation<T> const& lda)
 {
+    LDA_PROFILE_SCOPE("lda_io.save_binary");
+
+    xt::xtensor<T, 2> const topic_word_dirichlets = lda.topic_word_dirichlets();
+    std::size_t const topic_count = topic_word_dirichlets.shape()[0];
+    std::size_t const word_count = topic_word_dirichlets.shape()[1];
+
+    if (topic_count != lda.get_config().topic_count) {
+        throw std::logic_error("model is not trained");
+    }
+
+    std::string const config_text = scalar_config_to_json(lda.get_config()).dump();
+    xt::xtensor<double, 2> const& preconditions = lda.get_config().topic_word_preconditions;
+
+    std::size_t const word_stride = basic_lda_inference<T>::word_stride(topic_count);
+    std::vector<T> word_topic_geoexp(word_count * word_stride);
+    basic_lda_inference<T>::compute_word_topic_geoexp(topic_word_dirichlets, word_stride, word_topic_geoexp.data());
+
+    binary_header header = {};
+    std::memcpy(header.magic, binary_magic, sizeof binary_magic);
+    header.version = binary_version;
+    header.byte_order = byte_order_mark;
+    header.scalar_size = sizeof(T);
+    header.topic_count = topic_count;
+    header.word_count = word_count;
+    header.word_stride = word_stride;
+    header.update_count = lda.update_count();
+    header.config_offset = binary_header_size;
+    header.config_size = config_text.size();
+    header.topics_offset = align_binary_size(header.config_offset + header.config_size);
+    header.geoexp_offset = align_binary_size(header.topics_offset + topic_count * word_count * sizeof(T));
+    header.preconditions_offset = align_binary_size(header.geoexp_offset + word_count * word_stride * sizeof(T));
+    header.preconditions_rows = preconditions.shape()[0];
+    header.preconditions_columns = preconditions.shape()[1];
+    header.file_size = align_binary_size(header.preconditions_offset + preconditions.size() * sizeof(double));
+
+    // Sections with the zero padding up to the next one.
+    struct section
+    {
+        void const* data;
+        std::size_t size;
+        std::size_t end;
+    };
+
+    section const sections[] = {
+        {config_text.data(), config_text.size(), header.topics_offset},
+        {topic_word_dirichlets.raw_data(), topic_count * word_count * sizeof(T), header.geoexp_offset},
+        {word_topic_geoexp.data(), word_count * word_stride * sizeof(T), header.preconditions_offset},
+        {preconditions.raw_data(), preconditions.size() * sizeof(double), header.file_size},
+    };
+
+    unsigned char const padding[binary_alignment] = {};
+
+    auto const for_each_chunk = [&](auto&& consume) {
+        std::size_t offset = binary_header_size;
+        for (section const& sec : sections) {
+            consume(static_cast<unsigned char const*>(sec.data), sec.size);
+            consume(padding, sec.end - offset - sec.size);
+            offset = sec.end;
+        }
+    };
+
+    checksum_builder checksum;
+    for_each_chunk([&](unsigned char const* data, std::size_t size) { checksum.add(data, size); });
+    header.checksum = checksum.value();
+
+    unsigned char header_block[binary_header_size] = {};
+    std::memcpy(header_block, &header, sizeof header);
+    output.write(reinterpret_cast<char const*>(header_block), sizeof header_block);
+
+    for_each_chunk([&](unsigned char const* data, std::size_t size) {
+        output.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    });
+    LDA_PROFILE_COUNT("lda_io.bytes_written", header.file_size);
+}
+
+template<typename T>
+basic_latent_dirichlet_allocation<T> load_lda(std::istream& input)
+{
+    if (is_binary_lda(input)) {
+        LDA_PROFILE_SCOPE("lda_io.load_binary");
+
+        // The header gives the file size, so the file is read in one pass
+        // into 8-byte words, which aligns the arrays.
+        std::vector<std::uint64_t> buffer(binary_header_size / 8);
+        auto const header_size = static_cast<std::streamsize>(binary_header_size);
+        if (input.read(reinterpret_cast<char*>(buffer.data()), header_size).gcount() != header_size) {
+            throw std::runtime_error("model file is truncated");
+        }
+
+        binary_header header;
+        std::memcpy(&header, buffer.data(), sizeof header);
+        check_binary_header(header);
+
+        // Check the size against the stream before allocating for it.
+        std::uint64_t const file_size = header.file_size;
+        std::streamoff const remaining_size = stream_remaining_size(input);
+        if (file_size < binary_header_size || file_size % 8 != 0
+            || (remaining_size >= 0 && file_size - binary_header_size != static_cast<std::uint64_t>(remaining_size))) {
+            throw std::runtime_error("model file is truncated");
+        }
+
+        buffer.resize(file_size / 8);
+        auto const content_size = static_cast<std::streamsize>(file_size - binary_header_size);
+        if (input.read(reinterpret_cast<char*>(buffer.data()) + binary_header_size, content_size).gcount()
+            != content_size) {
+            throw std::runtime_error("model file is truncated");
+        }
+        LDA_PROFILE_COUNT("lda_io.bytes_read", file_size);
+
+        return model_from_binary<T>(parse_binary(reinterpret_cast<unsigned char const*>(buffer.data()),
+                                                 file_size));
+    }
+
+    LDA_PROFILE_SCOPE("lda_io.load_json");
+
     auto const json = nlohmann::json::parse(input);
 
-    return latent_dirichlet_allocation{config_from_json(json["config"]),
-                                       xtensor_from_json(json["topics"])};
+    std::size_t const update_count = json.count("update_count") ? json["update_count"].get<std::size_t>() : 0;
+
+    // Numbers are parsed in double precision and rounded to T, so a model
+    // of either precision can be loaded as the other.
+    return basic_latent_dirichlet_allocation<T>{
+        config_from_json(json["config"]), xtensor_from_json<T>(json["topics"]), update_count
+    };
+}
+
+template<typename T>
+void save_lda_checkpoint(std::ostream& output,
+                         basic_latent_dirichlet_allocation<T> const& lda,
+                         basic_fit_state<T> const& state)
+{
+    LDA_PROFILE_SCOPE("lda_io.save_checkpoint");
+
+    xt::xtensor<T, 2> const topic_word_dirichlets = lda.topic_word_dirichlets();
+    xt::xtensor<T, 2> const& doc_topic_dirichlets = state.doc_topic_dirichlets;
+
+    std::string metadata = nlohmann::json{
+        {"config", config_to_json(lda.get_config())},
+        {"update_count", lda.update_count()},
+        {"iteration_count", state.iteration_count},
+        {"topics_shape", topic_word_dirichlets.shape()},
+        {"doc_topics_shape", doc_topic_dirichlets.shape()},
+    }.dump();
+    metadata.resize(align_word_size(metadata.size()), ' ');
+
+    std::size_t const topics_size = topic_word_dirichlets.size() * sizeof(T);
+    std::size_t const doc_topics_size = doc_topic_dirichlets.size() * sizeof(T);
+
+    struct section
+    {
+        void const* data;
+        std::size_t size;
+    };
+
+    section const sections[] = {
+        {metadata.data(), metadata.size()},
+        {topic_word_dirichlets.raw_data(), topics_size},
+        {doc_topic_dirichlets.raw_data(), doc_topics_size},
+    };
+
+    unsigned char const padding[8] = {};
+
+    auto const for_each_chunk = [&](auto&& consume) {
+        for (section const& sec : sections) {
+            consume(static_cast<unsigned char const*>(sec.data), sec.size);
+            consume(padding, align_word_size(sec.size) - sec.size);
+        }
+    };
+
+    checkpoint_header header = {};
+    std::memcpy(header.magic, checkpoint_magic, sizeof checkpoint_magic);
+    header.version = checkpoint_version;
+    header.byte_order = byte_order_mark;
+    header.scalar_size = sizeof(T);
+    header.metadata_size = metadata.size();
+    header.content_size = metadata.size() + align_word_size(topics_size) + align_word_size(doc_topics_size);
+
+    checksum_builder checksum;
+    for_each_chunk([&](unsigned char const* data, std::size_t size) { checksum.add(data, size); });
+    header.checksum = checksum.value();
+
+    output.write(reinterpret_cast<char const*>(&header), sizeof header);
+    for_each_chunk([&](unsigned char const* data, std::size_t size) {
+        output.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    });
+}
+
+template<typename T>
+basic_lda_checkpoint<T> load_lda_checkpoint(std::istream& input)
+{
+    LDA_PROFILE_SCOPE("lda_io.load_checkpoint");
+
+    checkpoint_header header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof header)) {
+        throw std::runtime_error("checkpoint is truncated");
+    }
+
+    if (std::memcmp(header.magic, checkpoint_magic, sizeof checkpoint_magic) != 0) {
+        throw std::runtime_error("not a checkpoint file");
+    }
+    if (header.byte_order != byte_order_mark) {
+        throw std::runtime_error("checkpoint has a different byte order");
+    }
+    if (header.version != checkpoint_version) {
+        throw std::runtime_error("unsupported checkpoint version");
+    }
+    if (header.scalar_size != sizeof(T)) {
+        throw std::runtime_error(std::string{"checkpoint was saved with "}
+                                 + (header.scalar_size == sizeof(float) ? "float32" : "float64")
+                                 + " parameters");
+    }
+    if (header.content_size % 8 != 0 || header.metadata_size % 8 != 0
+        || header.metadata_size > header.content_size) {
+        throw std::runtime_error("checkpoint has an invalid layout");
+    }
+
+    // Read into 8-byte words so that the arrays are aligned.
+    std::vector<std::uint64_t> content(header.content_size / 8);
+    auto const content_size = static_cast<std::streamsize>(header.content_size);
+    if (input.read(reinterpret_cast<char*>(content.data()), content_size).gcount() != content_size) {
+        throw std::runtime_error("checkpoint is truncated");
+    }
+
+    auto const data = reinterpret_cast<unsigned char const*>(content.data());
+    if (compute_checksum(data, header.content_size) != header.checksum) {
+        throw std::runtime_error("checkpoint checksum mismatch");
+    }
+
+    char const* metadata_text = reinterpret_cast<char const*>(data);
+    auto const metadata = nlohmann::json::parse(metadata_text, metadata_text + header.metadata_size);
+
+    std::size_t const max_elements = header.content_size / sizeof(T);
+    std::array<std::size_t, 2> const topics_shape = metadata.at("topics_shape");
+    std::array<std::size_t, 2> const doc_topics_shape = metadata.at("doc_topics_shape");
+    std::size_t const topics_size = shape_size(topics_shape, max_elements) * sizeof(T);
+    std::size_t const doc_topics_size = shape_size(doc_topics_shape, max_elements) * sizeof(T);
+
+    if (header.metadata_size + align_word_size(topics_size) + align_word_size(doc_topics_size)
+        != header.content_size) {
+        throw std::runtime_error("checkpoint has an invalid layout");
+    }
+
+    auto const read_array = [&](std::array<std::size_t, 2> const& shape, std::size_t offset) {
+        xt::xtensor<T, 2> result{shape};
+        std::memcpy(result.raw_data(), data + offset, result.size() * sizeof(T));
+        return result;
+    };
+
+    xt::xtensor<T, 2> const topic_word_dirichlets = read_array(topics_shape, header.metadata_size);
+
+    basic_fit_state<T> state;
+    state.iteration_count = metadata.at("iteration_count").get<int>();
+    if (doc_topics_size != 0) {
+        state.doc_topic_dirichlets = read_array(doc_topics_shape,
+                                                header.metadata_size + align_word_size(topics_size));
+    }
+
+    return {
+        basic_latent_dirichlet_allocation<T>{
+            config_from_json(metadata.at("config")), topic_word_dirichlets,
+            metadata.at("update_count").get<std::size_t>()
+        },
+        std::move(state),
+    };
+}
+
+bool is_binary_lda(std::istream& input)
+{
+    char magic[sizeof binary_magic] = {};
+    auto const start = input.tellg();
+
+    input.read(magic, sizeof magic);
+    bool const binary = input.gcount() == sizeof magic
+                     && std::memcmp(magic, binary_magic, sizeof magic) == 0;
+
+    input.clear();
+    input.seekg(start);
+    return binary;
 }
+
+mapped_lda::mapped_lda(std::string const& path)
+    : map_{std::make_unique<memory_map>(path)}
+{
+    LDA_PROFILE_SCOPE("lda_io.map_binary");
+
+    binary_view const view = parse_binary(map_->data(), map_->size());
+
+    config_ = view.config;
+    topic_count_ = view.header.topic_count;
+    word_count_ = view.header.word_count;
+    word_stride_ = view.header.word_stride;
+    update_count_ = view.header.update_count;
+    scalar_size_ = view.header.scalar_size;
+    topic_word_dirichlets_ = view.topics;
+    word_topic_geoexp_ = view.geoexp;
+    preconditions_rows_ = view.header.preconditions_rows;
+    preconditions_columns_ = view.header.preconditions_columns;
+    topic_word_preconditions_ = view.preconditions;
+}
+
+mapped_lda::~mapped_lda() = default;
+
+lda_config const& mapped_lda::get_config() const
+{
+    return config_;
+}
+
+std::size_t mapped_lda::topic_count() const
+{
+    return topic_count_;
+}
+
+std::size_t mapped_lda::word_count() const
+{
+    return word_count_;
+}
+
+std::size_t mapped_lda::word_stride() const
+{
+    return word_stride_;
+}
+
+std::size_t mapped_lda::update_count() const
+{
+    return update_count_;
+}
+
+std::size_t mapped_lda::scalar_size() const
+{
+    return scalar_size_;
+}
+
+template<typename T>
+T const* mapped_lda::topic_word_dirichlets() const
+{
+    if (scalar_size_ != sizeof(T)) {
+        throw std::logic_error("scalar type mismatch");
+    }
+    return static_cast<T const*>(topic_word_dirichlets_);
+}
+
+template<typename T>
+T const* mapped_lda::word_topic_geoexp() const
+{
+    if (scalar_size_ != sizeof(T)) {
+        throw std::logic_error("scalar type mismatch");
+    }
+    return static_cast<T const*>(word_topic_geoexp_);
+}
+
+template<typename T>
+basic_latent_dirichlet_allocation<T> mapped_lda::to_model() const
+{
+    binary_view view;
+    view.header = {};
+    view.header.scalar_size = static_cast<std::uint32_t>(scalar_size_);
+    view.header.topic_count = topic_count_;
+    view.header.word_count = word_count_;
+    view.header.update_count = update_count_;
+    view.header.preconditions_rows = preconditions_rows_;
+    view.header.preconditions_columns = preconditions_columns_;
+    view.config = config_;
+    view.topics = topic_word_dirichlets_;
+    view.geoexp = word_topic_geoexp_;
+    view.preconditions = topic_word_preconditions_;
+
+    return model_from_binary<T>(view);
+}
+
+std::string engine_to_string(lda_engine engine)
+{
+    switch (engine) {
+      case lda_engine::variational:
+        return "variational";
+      case lda_engine::gibbs:
+        return "gibbs";
+    }
+    throw std::invalid_argument("unknown engine");
+}
+
+lda_engine engine_from_string(std::string const& name)
+{
+    if (name == "variational") {
+        return lda_engine::variational;
+    }
+    if (name == "gibbs") {
+        return lda_engine::gibbs;
+    }
+    throw std::invalid_argument("unknown engine: " + name);
+}
+
+template void save_lda(std::ostream&, basic_latent_dirichlet_allocation<double> const&);
+template void save_lda(std::ostream&, basic_latent_dirichlet_allocation<float> const&);
+template basic_latent_dirichlet_allocation<double> load_lda(std::istream&);
+template basic_latent_dirichlet_allocation<float> load_lda(std::istream&);
+template void save_lda_binary(std::ostream&, basic_latent_dirichlet_allocation<double> const&);
+template void save_lda_binary(std::ostream&, basic_latent_dirichlet_allocation<float> const&);
+template void save_lda_checkpoint(std::ostream&, basic_latent_dirichlet_allocation<double> const&,
+                                  basic_fit_state<double> const&);
+template void save_lda_checkpoint(std::ostream&, basic_latent_dirichlet_allocation<float> const&,
+                                  basic_fit_state<float> const&);
+template basic_lda_checkpoint<double> load_lda_checkpoint(std::istream&);
+template basic_lda_checkpoint<float> load_lda_checkpoint(std::istream&);
+template double const* mapped_lda::topic_word_dirichlets() const;
+template float const* mapped_lda::topic_word_dirichlets() const;
+template double const* mapped_lda::word_topic_geoexp() const;
+template float const* mapped_lda::word_topic_geoexp() const;
+template basic_latent_dirichlet_allocation<double> mapped_lda::to_model() const;
+template basic_latent_dirichlet_allocation<float> mapped_lda::to_model() const;
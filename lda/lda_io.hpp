@@ -1,17 +1,143 @@
 #ifndef INCLUDED_LDA_IO_HPP
 #define INCLUDED_LDA_IO_HPP
 
+#include <cstddef>
 #include <istream>
+#include <memory>
 #include <ostream>
+#include <string>
 
 #include "lda.hpp"
 
 
+class memory_map;
+
 // Saves a trained latent_dirichlet_allocation object to a textual stream.
-void save_lda(std::ostream& output, latent_dirichlet_allocation const& lda);
+// The precision of the model is recorded but the parameters are written as
+// decimal numbers either way.
+template<typename T>
+void save_lda(std::ostream& output, basic_latent_dirichlet_allocation<T> const& lda);
+
+// Saves a trained latent_dirichlet_allocation object in the binary format.
+// The file holds a header, the scalar fields of the config in JSON, the
+// topic-word dirichlet parameters, the inference table of lda_inference and
+// the topic_word_preconditions of the config, each array aligned to 64
+// bytes in the native byte order, followed by nothing else. The header
+// records a checksum of the rest of the file.
+template<typename T>
+void save_lda_binary(std::ostream& output, basic_latent_dirichlet_allocation<T> const& lda);
+
+// Loads a latent_dirichlet_allocation object saved by save_lda or
+// save_lda_binary; the format is detected from the content. The
+// parameters are converted to T regardless of the precision of the saved
+// model.
+template<typename T = double>
+basic_latent_dirichlet_allocation<T> load_lda(std::istream& input);
+
+// Training checkpoint: the model being trained and what is needed to resume
+// training exactly where it stopped.
+template<typename T>
+struct basic_lda_checkpoint
+{
+    // The model after the last completed iteration or online update.
+    basic_latent_dirichlet_allocation<T> model;
+
+    // The state of batch training, or the default for online training.
+    basic_fit_state<T> state;
+};
+
+// Saves a training checkpoint of lda, which is being trained, with the state
+// of batch training. The random numbers of training only depend on the
+// seed in the config, so no random engine state is saved. The arrays are
+// written in the native byte order and precision, so training resumes with
+// the same bits, and the content is checksummed.
+template<typename T>
+void save_lda_checkpoint(std::ostream& output,
+                         basic_latent_dirichlet_allocation<T> const& lda,
+                         basic_fit_state<T> const& state);
+
+// Loads a checkpoint saved by save_lda_checkpoint. Throws
+// std::runtime_error if the content is invalid or the parameters were saved
+// in another precision than T.
+template<typename T = double>
+basic_lda_checkpoint<T> load_lda_checkpoint(std::istream& input);
+
+// Read-only memory mapping of a model file saved by save_lda_binary. The
+// arrays are used in place, so processes mapping the same file share one
+// copy in the page cache.
+class mapped_lda
+{
+  public:
+    // Maps a model file and validates its header and checksum. Throws
+    // std::runtime_error if the file cannot be mapped or is not a valid
+    // binary model file.
+    explicit mapped_lda(std::string const& path);
+
+    // Unmaps the file.
+    ~mapped_lda();
+
+    mapped_lda(mapped_lda const&) = delete;
+    mapped_lda& operator=(mapped_lda const&) = delete;
+
+    // Returns the config object of the model. Its topic_word_preconditions
+    // is left empty as it only matters for training; to_model restores it.
+    lda_config const& get_config() const;
+
+    // Returns the number of topics.
+    std::size_t topic_count() const;
+
+    // Returns the number of words in the vocabulary.
+    std::size_t word_count() const;
+
+    // Returns the distance between the rows of the inference table.
+    std::size_t word_stride() const;
+
+    // Returns the number of online updates of the model.
+    std::size_t update_count() const;
+
+    // Returns the size of the scalar type of the arrays: 4 or 8.
+    std::size_t scalar_size() const;
+
+    // Returns the topic-word dirichlet parameters in the row-major order.
+    // Throws std::logic_error unless T is the scalar type of the file.
+    template<typename T>
+    T const* topic_word_dirichlets() const;
+
+    // Returns the inference table, the geometric expectation of topic-word
+    // distributions stored word-major with rows of word_stride elements.
+    // Throws std::logic_error unless T is the scalar type of the file.
+    template<typename T>
+    T const* word_topic_geoexp() const;
+
+    // Copies the model into a latent_dirichlet_allocation object.
+    template<typename T>
+    basic_latent_dirichlet_allocation<T> to_model() const;
+
+  private:
+    std::unique_ptr<memory_map> map_;
+    lda_config config_;
+    std::size_t topic_count_ = 0;
+    std::size_t word_count_ = 0;
+    std::size_t word_stride_ = 0;
+    std::size_t update_count_ = 0;
+    std::size_t scalar_size_ = 0;
+    void const* topic_word_dirichlets_ = nullptr;
+    void const* word_topic_geoexp_ = nullptr;
+    std::size_t preconditions_rows_ = 0;
+    std::size_t preconditions_columns_ = 0;
+    double const* topic_word_preconditions_ = nullptr;
+};
+
+// Returns true if the stream starts with the binary model format. The
+// stream position is not changed.
+bool is_binary_lda(std::istream& input);
+
+// Returns the name of a training engine: "variational" or "gibbs".
+std::string engine_to_string(lda_engine engine);
 
-// Loads a latent_dirichlet_allocation object from a textual stream.
-latent_dirichlet_allocation load_lda(std::istream& input);
+// Parses the name of a training engine. Throws std::invalid_argument if the
+// name is unknown.
+lda_engine engine_from_string(std::string const& name);
 
 
 #endif
@@ -1,10 +1,13 @@
 #ifndef INCLUDED_MATH_HPP
 #define INCLUDED_MATH_HPP
 
+#include <array>
 #include <cmath>
+#include <cstddef>
 #include <type_traits>
 #include <utility>
 
+#include <xtensor/xeval.hpp>
 #include <xtensor/xfunction.hpp>
 #include <xtensor/xmath.hpp>
 
@@ -23,11 +26,14 @@ auto digamma(E&& expr);
 template<typename E>
 auto log_beta(E&& expr)
 {
-    using closure_type = xt::const_xclosure_t<E>;
-    closure_type& closure = expr;
+    // The reduction is evaluated eagerly. A lazy reducer keeps references to
+    // its operand and axes, which would dangle after returning.
+    using axes_type = std::array<std::size_t, 1>;
 
-    return xt::sum(xt::lgamma(closure_type{closure}), {expr.dimension() - 1})
-            - xt::lgamma(xt::sum(closure_type{closure}, {expr.dimension() - 1}));
+    auto&& params = xt::eval(std::forward<E>(expr));
+    axes_type const axes = {params.dimension() - 1};
+
+    return xt::eval(xt::sum(xt::lgamma(params), axes) - xt::lgamma(xt::sum(params, axes)));
 }
 
 namespace detail
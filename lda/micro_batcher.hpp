@@ -0,0 +1,250 @@
+#ifndef INCLUDED_MICRO_BATCHER_HPP
+#define INCLUDED_MICRO_BATCHER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// Counters of a micro_batcher.
+struct batcher_stats
+{
+    // The number of requests and batches processed.
+    std::uint64_t request_count = 0;
+    std::uint64_t batch_count = 0;
+
+    // The number of requests whose batch failed.
+    std::uint64_t error_count = 0;
+
+    // Seconds since the batcher was created and seconds spent processing
+    // batches.
+    double elapsed_seconds = 0;
+    double busy_seconds = 0;
+
+    // Seconds from submission to response. The percentiles are upper bounds
+    // taken from a histogram with power-of-two buckets.
+    double mean_latency = 0;
+    double p50_latency = 0;
+    double p99_latency = 0;
+    double max_latency = 0;
+};
+
+// Coalesces requests submitted by many threads into batches processed on a
+// worker thread. A batch is processed when max_batch_size requests are
+// waiting or when the oldest waiting request has waited max_latency, so a
+// lone request is delayed by at most max_latency while concurrent requests
+// share the fixed cost of processing a batch.
+template<typename Request, typename Response>
+class micro_batcher
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // Processes a batch of requests and returns a response for each.
+    using process_function = std::function<std::vector<Response>(std::vector<Request>&)>;
+
+    micro_batcher(std::size_t max_batch_size, clock::duration max_latency, process_function process)
+        : max_batch_size_{max_batch_size}
+        , max_latency_{max_latency}
+        , process_{std::move(process)}
+        , start_time_{clock::now()}
+    {
+        if (max_batch_size_ == 0) {
+            throw std::invalid_argument("max_batch_size must be a positive integer");
+        }
+        worker_ = std::thread{[this] { run(); }};
+    }
+
+    // Processes the waiting requests and joins the worker thread.
+    ~micro_batcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stopping_ = true;
+        }
+        request_ready_.notify_all();
+        worker_.join();
+    }
+
+    micro_batcher(micro_batcher const&) = delete;
+    micro_batcher& operator=(micro_batcher const&) = delete;
+
+    // Queues a request. The future receives the response, or the exception
+    // thrown while processing the batch of the request.
+    std::future<Response> submit(Request request)
+    {
+        pending_request pending{std::move(request), {}, clock::now()};
+        std::future<Response> response = pending.promise.get_future();
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            queue_.push_back(std::move(pending));
+        }
+        request_ready_.notify_one();
+        return response;
+    }
+
+    // Returns a snapshot of the counters.
+    batcher_stats stats() const
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        batcher_stats result = stats_;
+
+        result.elapsed_seconds = seconds(clock::now() - start_time_);
+        if (result.request_count != 0) {
+            result.mean_latency = total_latency_ / static_cast<double>(result.request_count);
+        }
+        result.p50_latency = latency_percentile(0.5);
+        result.p99_latency = latency_percentile(0.99);
+
+        return result;
+    }
+
+  private:
+    struct pending_request
+    {
+        Request request;
+        std::promise<Response> promise;
+        clock::time_point submit_time;
+    };
+
+    // Latency histogram bucket i counts latencies below 2^i microseconds
+    // and not below 2^(i-1) microseconds.
+    static constexpr std::size_t latency_bucket_count = 48;
+
+    static double seconds(clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    // Forms and processes batches until stopped.
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+
+        for (;;) {
+            request_ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+
+            clock::time_point const deadline = queue_.front().submit_time + max_latency_;
+            request_ready_.wait_until(lock, deadline, [this] {
+                return stopping_ || queue_.size() >= max_batch_size_;
+            });
+
+            std::size_t const batch_size = std::min(queue_.size(), max_batch_size_);
+            std::vector<pending_request> batch;
+            batch.reserve(batch_size);
+            for (std::size_t i = 0; i < batch_size; ++i) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+
+            lock.unlock();
+            clock::time_point const process_start = clock::now();
+            std::vector<Response> responses;
+            std::exception_ptr const error = process_batch(batch, responses);
+            clock::time_point const process_end = clock::now();
+            lock.lock();
+
+            // The counters include a request by the time its future is ready.
+            stats_.batch_count++;
+            stats_.request_count += batch.size();
+            stats_.error_count += error ? batch.size() : 0;
+            stats_.busy_seconds += seconds(process_end - process_start);
+
+            for (pending_request const& pending : batch) {
+                record_latency(seconds(process_end - pending.submit_time));
+            }
+
+            lock.unlock();
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                if (error) {
+                    batch[i].promise.set_exception(error);
+                } else {
+                    batch[i].promise.set_value(std::move(responses[i]));
+                }
+            }
+            lock.lock();
+        }
+    }
+
+    // Processes the requests of a batch into responses. Returns the error if
+    // processing failed.
+    std::exception_ptr process_batch(std::vector<pending_request>& batch, std::vector<Response>& responses)
+    {
+        std::vector<Request> requests;
+        requests.reserve(batch.size());
+        for (pending_request& pending : batch) {
+            requests.push_back(std::move(pending.request));
+        }
+
+        try {
+            responses = process_(requests);
+            if (responses.size() != batch.size()) {
+                throw std::logic_error("batch processing returned a wrong number of responses");
+            }
+            return nullptr;
+        } catch (...) {
+            return std::current_exception();
+        }
+    }
+
+    void record_latency(double latency)
+    {
+        std::size_t bucket = 0;
+        for (double bound = 1e-6; bucket + 1 < latency_bucket_count && latency >= bound; bound *= 2) {
+            bucket++;
+        }
+        latency_buckets_[bucket]++;
+        total_latency_ += latency;
+        stats_.max_latency = std::max(stats_.max_latency, latency);
+    }
+
+    // Returns the upper bound of the bucket holding given quantile.
+    double latency_percentile(double quantile) const
+    {
+        auto const rank = static_cast<std::uint64_t>(quantile * static_cast<double>(stats_.request_count));
+        std::uint64_t cumulative = 0;
+        double bound = 1e-6;
+
+        for (std::size_t bucket = 0; bucket < latency_bucket_count; ++bucket, bound *= 2) {
+            cumulative += latency_buckets_[bucket];
+            if (cumulative > rank) {
+                return std::min(bound, stats_.max_latency);
+            }
+        }
+        return stats_.max_latency;
+    }
+
+  private:
+    std::size_t const max_batch_size_;
+    clock::duration const max_latency_;
+    process_function const process_;
+    clock::time_point const start_time_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable request_ready_;
+    std::deque<pending_request> queue_;
+    bool stopping_ = false;
+
+    batcher_stats stats_;
+    double total_latency_ = 0;
+    std::array<std::uint64_t, latency_bucket_count> latency_buckets_ = {};
+
+    std::thread worker_;
+};
+
+#endif
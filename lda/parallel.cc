@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "parallel.hpp"
+
+
+thread_pool::thread_pool(std::size_t thread_count)
+{
+    if (thread_count == 0) {
+        throw std::invalid_argument("thread_count must be a positive integer");
+    }
+
+    for (std::size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+        workers_.emplace_back([this, thread_index] { work(thread_index); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stopping_ = true;
+    }
+    task_ready_.notify_all();
+
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::size_t thread_pool::size() const
+{
+    return workers_.size() + 1;
+}
+
+void thread_pool::run(std::function<void(std::size_t)> const& task)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        task_ = &task;
+        generation_++;
+        running_count_ = workers_.size();
+        error_ = nullptr;
+    }
+    task_ready_.notify_all();
+
+    try {
+        task(0);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!error_) {
+            error_ = std::current_exception();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        task_done_.wait(lock, [this] { return running_count_ == 0; });
+        task_ = nullptr;
+        error = error_;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void thread_pool::work(std::size_t thread_index)
+{
+    std::size_t seen_generation = 0;
+
+    for (;;) {
+        std::function<void(std::size_t)> const* task;
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            task_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+            task = task_;
+        }
+
+        try {
+            (*task)(thread_index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+
+        bool last = false;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            last = --running_count_ == 0;
+        }
+        if (last) {
+            task_done_.notify_one();
+        }
+    }
+}
+
+std::vector<std::size_t> balanced_partition(std::vector<std::size_t> const& weights,
+                                            std::size_t part_count)
+{
+    std::vector<std::size_t> bounds(part_count + 1);
+    balanced_partition(weights.data(), weights.size(), part_count, bounds.data());
+    return bounds;
+}
+
+void balanced_partition(std::size_t const* weights,
+                        std::size_t weight_count,
+                        std::size_t part_count,
+                        std::size_t* bounds)
+{
+    std::size_t total_weight = 0;
+    for (std::size_t i = 0; i < weight_count; ++i) {
+        total_weight += weights[i];
+    }
+
+    bounds[0] = 0;
+
+    std::size_t index = 0;
+    std::size_t cumulative_weight = 0;
+
+    for (std::size_t part = 1; part < part_count; ++part) {
+        // Smallest index whose preceding weights reach part / part_count of
+        // the total.
+        double const target = static_cast<double>(total_weight) * static_cast<double>(part)
+                            / static_cast<double>(part_count);
+
+        while (index < weight_count && static_cast<double>(cumulative_weight) < target) {
+            cumulative_weight += weights[index];
+            index++;
+        }
+        bounds[part] = index;
+    }
+    bounds[part_count] = weight_count;
+}
+
+void parallel_for(thread_pool& pool,
+                  std::vector<std::size_t> const& bounds,
+                  std::size_t chunk_size,
+                  std::function<void(std::size_t, std::size_t, std::size_t)> const& body)
+{
+    parallel_for(pool, bounds.data(), bounds.size() - 1, chunk_size, body);
+}
+
+void parallel_for(thread_pool& pool,
+                  std::size_t const* bounds,
+                  std::size_t part_count,
+                  std::size_t chunk_size,
+                  std::function<void(std::size_t, std::size_t, std::size_t)> const& body)
+{
+    if (pool.chunk_counters_.size() < part_count) {
+        pool.chunk_counters_ = std::vector<thread_pool::chunk_counter>(part_count);
+    }
+    thread_pool::chunk_counter* const counters = pool.chunk_counters_.data();
+
+    for (std::size_t part = 0; part < part_count; ++part) {
+        counters[part].next = bounds[part];
+    }
+
+    // The task captures a single reference, which std::function stores
+    // without allocating.
+    auto const claim_chunks = [&](std::size_t thread_index) {
+        // Own range first, then the ranges of the other threads in turn.
+        for (std::size_t i = 0; i < part_count; ++i) {
+            std::size_t const part = (thread_index + i) % part_count;
+            std::size_t const part_end = bounds[part + 1];
+
+            for (;;) {
+                std::size_t const begin = counters[part].next.fetch_add(chunk_size);
+                if (begin >= part_end) {
+                    break;
+                }
+                body(begin, std::min(begin + chunk_size, part_end), thread_index);
+            }
+        }
+    };
+    pool.run([&claim_chunks](std::size_t thread_index) { claim_chunks(thread_index); });
+}
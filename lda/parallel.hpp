@@ -0,0 +1,168 @@
+#ifndef INCLUDED_PARALLEL_HPP
+#define INCLUDED_PARALLEL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// Fixed set of threads running the same task. The calling thread takes part
+// in the task as thread 0, so a pool of size one spawns no thread. Running a
+// task or a parallel_for on a pool allocates nothing once the pool has run
+// one with as many parts.
+class thread_pool
+{
+  public:
+    // Creates a pool of thread_count threads including the calling thread.
+    explicit thread_pool(std::size_t thread_count);
+
+    // Joins the threads.
+    ~thread_pool();
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    // Returns the number of threads including the calling thread.
+    std::size_t size() const;
+
+    // Calls task(thread_index) on every thread and waits for all the calls
+    // to finish. An exception thrown by any call is rethrown.
+    void run(std::function<void(std::size_t)> const& task);
+
+  private:
+    friend void parallel_for(thread_pool& pool,
+                             std::size_t const* bounds,
+                             std::size_t part_count,
+                             std::size_t chunk_size,
+                             std::function<void(std::size_t, std::size_t, std::size_t)> const& body);
+
+    // Index counter padded to a cache line to avoid false sharing between
+    // threads claiming chunks from different ranges.
+    struct chunk_counter
+    {
+        std::atomic<std::size_t> next{0};
+        char padding[64 - sizeof(std::atomic<std::size_t>)];
+    };
+
+    // Waits for and runs tasks on a worker thread.
+    void work(std::size_t thread_index);
+
+  private:
+    std::vector<std::thread> workers_;
+    std::vector<chunk_counter> chunk_counters_;
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::condition_variable task_done_;
+    std::function<void(std::size_t)> const* task_ = nullptr;
+    std::size_t generation_ = 0;
+    std::size_t running_count_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+// Splits [0, weights.size()) into part_count contiguous ranges with roughly
+// equal total weights. Returns part_count + 1 boundaries; part i is the
+// range [result[i], result[i + 1]).
+std::vector<std::size_t> balanced_partition(std::vector<std::size_t> const& weights,
+                                            std::size_t part_count);
+
+// Splits [0, weight_count) like balanced_partition into bounds, an array of
+// part_count + 1 elements, without allocating.
+void balanced_partition(std::size_t const* weights,
+                        std::size_t weight_count,
+                        std::size_t part_count,
+                        std::size_t* bounds);
+
+// Calls body(begin, end, thread_index) for chunks of [0, n) on the threads
+// of pool, where n is bounds.back(). Thread i starts with the chunks in
+// [bounds[i], bounds[i + 1]) and, after finishing them, steals remaining
+// chunks of other threads. So every index is processed exactly once but
+// the assignment of indices to threads is not deterministic.
+void parallel_for(thread_pool& pool,
+                  std::vector<std::size_t> const& bounds,
+                  std::size_t chunk_size,
+                  std::function<void(std::size_t, std::size_t, std::size_t)> const& body);
+
+// Calls parallel_for with the part_count + 1 boundaries in bounds.
+void parallel_for(thread_pool& pool,
+                  std::size_t const* bounds,
+                  std::size_t part_count,
+                  std::size_t chunk_size,
+                  std::function<void(std::size_t, std::size_t, std::size_t)> const& body);
+
+// Queue of at most a fixed number of values passed between threads. Used to
+// connect the stages of a pipeline so that a fast stage cannot run ahead of
+// a slow one without bound.
+template<typename T>
+class bounded_queue
+{
+  public:
+    // Creates an open queue holding at most capacity values.
+    explicit bounded_queue(std::size_t capacity)
+        : capacity_{capacity}
+    {
+    }
+
+    // Waits for room and appends value. Returns false without appending if
+    // the queue is closed.
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        not_full_.wait(lock, [this] { return closed_ || values_.size() < capacity_; });
+
+        if (closed_) {
+            return false;
+        }
+
+        values_.push_back(std::move(value));
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Waits for a value and moves the first one into value. Returns false if
+    // the queue is closed and empty.
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        not_empty_.wait(lock, [this] { return closed_ || !values_.empty(); });
+
+        if (values_.empty()) {
+            return false;
+        }
+
+        value = std::move(values_.front());
+        values_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // Closes the queue. Values already in the queue can still be popped.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+  private:
+    std::size_t capacity_;
+    std::deque<T> values_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    bool closed_ = false;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "profile.hpp"
+
+
+namespace profiling
+{
+    // Registered slots. The registry is created on first use, so slots in
+    // any translation unit can register during static initialization.
+    class registry_access
+    {
+      public:
+        static std::mutex& mutex()
+        {
+            static std::mutex instance;
+            return instance;
+        }
+
+        static std::vector<timer_slot*>& timers()
+        {
+            static std::vector<timer_slot*> instance;
+            return instance;
+        }
+
+        static std::vector<counter_slot*>& counters()
+        {
+            static std::vector<counter_slot*> instance;
+            return instance;
+        }
+
+        static void reset()
+        {
+            std::lock_guard<std::mutex> lock{mutex()};
+
+            for (timer_slot* slot : timers()) {
+                slot->calls_ = 0;
+                slot->nanoseconds_ = 0;
+            }
+            for (counter_slot* slot : counters()) {
+                slot->value_ = 0;
+            }
+        }
+
+        static nlohmann::json report()
+        {
+            std::lock_guard<std::mutex> lock{mutex()};
+
+            // Template instantiations have a slot each, summed by name.
+            std::map<std::string, std::uint64_t> calls;
+            std::map<std::string, std::uint64_t> nanoseconds;
+            std::map<std::string, std::uint64_t> counts;
+
+            for (timer_slot const* slot : timers()) {
+                calls[slot->name_] += slot->calls_.load();
+                nanoseconds[slot->name_] += slot->nanoseconds_.load();
+            }
+            for (counter_slot const* slot : counters()) {
+                counts[slot->name_] += slot->value_.load();
+            }
+
+            nlohmann::json result = {
+                {"enabled", enabled()},
+                {"timers", nlohmann::json::object()},
+                {"counters", nlohmann::json::object()},
+            };
+
+            for (auto const& entry : calls) {
+                result["timers"][entry.first] = {
+                    {"calls", entry.second},
+                    {"seconds", static_cast<double>(nanoseconds[entry.first]) * 1e-9},
+                };
+            }
+            for (auto const& entry : counts) {
+                result["counters"][entry.first] = entry.second;
+            }
+
+            return result;
+        }
+    };
+}
+
+profiling::timer_slot::timer_slot(char const* name)
+    : name_{name}
+{
+    std::lock_guard<std::mutex> lock{registry_access::mutex()};
+    registry_access::timers().push_back(this);
+}
+
+profiling::counter_slot::counter_slot(char const* name)
+    : name_{name}
+{
+    std::lock_guard<std::mutex> lock{registry_access::mutex()};
+    registry_access::counters().push_back(this);
+}
+
+bool profiling::enabled()
+{
+#ifdef LDA_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void profiling::reset()
+{
+    registry_access::reset();
+}
+
+void profiling::write_report(std::ostream& output)
+{
+    output << registry_access::report().dump(2) << '\n';
+}
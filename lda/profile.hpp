@@ -0,0 +1,129 @@
+#ifndef INCLUDED_PROFILE_HPP
+#define INCLUDED_PROFILE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+
+// Instrumentation of the hot paths. LDA_PROFILE_SCOPE(name) accumulates the
+// time spent in the enclosing scope, and LDA_PROFILE_COUNT(name, amount)
+// adds to a counter such as the number of bytes parsed. Sections and
+// counters of the same name are summed in the report.
+//
+// The macros compile to nothing unless LDA_PROFILE is defined, in which
+// case each use costs a couple of relaxed atomic additions, plus two clock
+// reads for a scope. They are placed around phases that take at least
+// microseconds, so the overhead is negligible either way.
+namespace profiling
+{
+    // Accumulated time of a code section. Slots are registered on
+    // construction and must live until the end of the program, so they are
+    // static objects.
+    class timer_slot
+    {
+      public:
+        explicit timer_slot(char const* name);
+
+        timer_slot(timer_slot const&) = delete;
+        timer_slot& operator=(timer_slot const&) = delete;
+
+        // Adds a call taking given time.
+        void add(std::chrono::steady_clock::duration duration)
+        {
+            calls_.fetch_add(1, std::memory_order_relaxed);
+            nanoseconds_.fetch_add(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()), std::memory_order_relaxed);
+        }
+
+      private:
+        friend class registry_access;
+
+        char const* name_;
+        std::atomic<std::uint64_t> calls_{0};
+        std::atomic<std::uint64_t> nanoseconds_{0};
+    };
+
+    // Accumulated count of something processed.
+    class counter_slot
+    {
+      public:
+        explicit counter_slot(char const* name);
+
+        counter_slot(counter_slot const&) = delete;
+        counter_slot& operator=(counter_slot const&) = delete;
+
+        void add(std::uint64_t amount)
+        {
+            value_.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+      private:
+        friend class registry_access;
+
+        char const* name_;
+        std::atomic<std::uint64_t> value_{0};
+    };
+
+    // Adds the time from construction to destruction to a timer slot.
+    class scoped_timer
+    {
+      public:
+        explicit scoped_timer(timer_slot& slot)
+            : slot_{slot}
+            , start_{std::chrono::steady_clock::now()}
+        {
+        }
+
+        ~scoped_timer()
+        {
+            slot_.add(std::chrono::steady_clock::now() - start_);
+        }
+
+        scoped_timer(scoped_timer const&) = delete;
+        scoped_timer& operator=(scoped_timer const&) = delete;
+
+      private:
+        timer_slot& slot_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Returns true if the library is compiled with LDA_PROFILE.
+    bool enabled();
+
+    // Zeroes all the timers and counters.
+    void reset();
+
+    // Writes the totals as a JSON object with "timers", mapping names to
+    // {"calls", "seconds"}, and "counters", mapping names to values. Times
+    // of nested scopes are included in the enclosing ones, and times spent
+    // on several threads are added up.
+    void write_report(std::ostream& output);
+}
+
+#define LDA_PROFILE_CONCAT_(a, b) a##b
+#define LDA_PROFILE_CONCAT(a, b) LDA_PROFILE_CONCAT_(a, b)
+
+#ifdef LDA_PROFILE
+
+#define LDA_PROFILE_SCOPE(name)                                                                   \
+    static ::profiling::timer_slot LDA_PROFILE_CONCAT(lda_profile_slot_, __LINE__){name};         \
+    ::profiling::scoped_timer const LDA_PROFILE_CONCAT(lda_profile_timer_, __LINE__){              \
+        LDA_PROFILE_CONCAT(lda_profile_slot_, __LINE__)}
+
+#define LDA_PROFILE_COUNT(name, amount)                                                           \
+    do {                                                                                          \
+        static ::profiling::counter_slot lda_profile_counter{name};                              \
+        lda_profile_counter.add(static_cast<std::uint64_t>(amount));                              \
+    } while (false)
+
+#else
+
+// The amount is not evaluated.
+#define LDA_PROFILE_SCOPE(name) static_cast<void>(0)
+#define LDA_PROFILE_COUNT(name, amount) static_cast<void>(sizeof(amount))
+
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "math.hpp"
+#include "simd_math.hpp"
+
+
+// Defined in the translation units compiled for each instruction set.
+math_kernels const* sse2_math_kernels();
+math_kernels const* avx2_math_kernels();
+
+namespace
+{
+    template<typename T>
+    void scalar_digamma(T const* x, std::size_t n, T* result)
+    {
+        for (std::size_t i = 0; i < n; ++i) {
+            result[i] = static_cast<T>(detail::digamma(x[i]));
+        }
+    }
+
+    template<typename T>
+    void scalar_exp(T const* x, std::size_t n, T* result)
+    {
+        for (std::size_t i = 0; i < n; ++i) {
+            result[i] = std::exp(x[i]);
+        }
+    }
+
+    template<typename T>
+    void scalar_lgamma(T const* x, std::size_t n, T* result)
+    {
+        for (std::size_t i = 0; i < n; ++i) {
+            result[i] = std::lgamma(x[i]);
+        }
+    }
+
+    math_kernels const scalar_kernels = {
+        "scalar",
+        {&scalar_digamma<double>, &scalar_exp<double>, &scalar_lgamma<double>},
+        {&scalar_digamma<float>, &scalar_exp<float>, &scalar_lgamma<float>},
+    };
+
+    // Checks if the running CPU supports the named instruction set. Only
+    // GCC and Clang on x86 can tell; elsewhere the kernels enabled at
+    // compile time are assumed to be usable.
+    bool cpu_supports(char const* instruction_set)
+    {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        std::string const name = instruction_set;
+        if (name == "avx2") {
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+        if (name == "sse2") {
+            return __builtin_cpu_supports("sse2");
+        }
+        return false;
+#else
+        (void) instruction_set;
+        return true;
+#endif
+    }
+
+    std::vector<math_kernels const*> detect_math_kernels()
+    {
+        std::vector<math_kernels const*> result;
+
+        for (math_kernels const* kernels : {avx2_math_kernels(), sse2_math_kernels()}) {
+            if (kernels && cpu_supports(kernels->instruction_set)) {
+                result.push_back(kernels);
+            }
+        }
+        result.push_back(&scalar_kernels);
+
+        return result;
+    }
+}
+
+std::vector<math_kernels const*> const& supported_math_kernels()
+{
+    static std::vector<math_kernels const*> const kernels = detect_math_kernels();
+    return kernels;
+}
+
+math_kernels const& cpu_math_kernels()
+{
+    return *supported_math_kernels().front();
+}
+
+template<>
+math_functions<double> const& cpu_math_functions<double>()
+{
+    return cpu_math_kernels().float64;
+}
+
+template<>
+math_functions<float> const& cpu_math_functions<float>()
+{
+    return cpu_math_kernels().float32;
+}
@@ -0,0 +1,53 @@
+#ifndef INCLUDED_SIMD_MATH_HPP
+#define INCLUDED_SIMD_MATH_HPP
+
+#include <cstddef>
+#include <vector>
+
+
+// Element-wise math functions on arrays of scalar type T. All functions
+// accept result == x.
+template<typename T>
+struct math_functions
+{
+    // Computes result[i] = digamma(x[i]) for i < n. x must be positive.
+    void (*digamma)(T const* x, std::size_t n, T* result);
+
+    // Computes result[i] = exp(x[i]) for i < n.
+    void (*exp)(T const* x, std::size_t n, T* result);
+
+    // Computes result[i] = lgamma(x[i]) for i < n. x must be positive.
+    void (*lgamma)(T const* x, std::size_t n, T* result);
+};
+
+// Math kernels for an instruction set. Each instruction set enabled in the
+// build has its own set of kernels and the best one supported by the running
+// CPU is selected at runtime.
+struct math_kernels
+{
+    // Name of the instruction set, e.g. "avx2".
+    char const* instruction_set;
+
+    math_functions<double> float64;
+    math_functions<float> float32;
+};
+
+// Returns the kernels usable on the running CPU, the fastest first. The last
+// one is the portable scalar implementation.
+std::vector<math_kernels const*> const& supported_math_kernels();
+
+// Returns the fastest kernels usable on the running CPU.
+math_kernels const& cpu_math_kernels();
+
+// Returns the functions of the fastest kernels for scalar type T, which is
+// float or double.
+template<typename T>
+math_functions<T> const& cpu_math_functions();
+
+template<>
+math_functions<double> const& cpu_math_functions<double>();
+
+template<>
+math_functions<float> const& cpu_math_functions<float>();
+
+#endif
@@ -0,0 +1,27 @@
+#include "simd_math.hpp"
+
+#include <xsimd/xsimd.hpp>
+
+#if XSIMD_X86_INSTR_SET >= XSIMD_X86_AVX2_VERSION
+# include "simd_math_impl.hpp"
+#endif
+
+
+// Returns the AVX2 kernels, or nullptr if this file is not compiled with
+// AVX2 enabled.
+math_kernels const* avx2_math_kernels()
+{
+#if XSIMD_X86_INSTR_SET >= XSIMD_X86_AVX2_VERSION
+    using float64_kernels = simd_math_impl::kernel_set<double, xsimd::batch<double, 4>>;
+    using float32_kernels = simd_math_impl::kernel_set<float, xsimd::batch<float, 8>>;
+
+    static math_kernels const kernels = {
+        "avx2",
+        float64_kernels::functions(),
+        float32_kernels::functions(),
+    };
+    return &kernels;
+#else
+    return nullptr;
+#endif
+}
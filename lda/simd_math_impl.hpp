@@ -0,0 +1,146 @@
+#ifndef INCLUDED_SIMD_MATH_IMPL_HPP
+#define INCLUDED_SIMD_MATH_IMPL_HPP
+
+#include <cstddef>
+
+#include <xsimd/xsimd.hpp>
+
+#include "simd_math.hpp"
+
+
+// Branch-free kernels on xsimd batches. This header is included only by the
+// translation units compiled for a specific instruction set.
+//
+// The kernels are in an anonymous namespace, so each of those translation
+// units keeps its own copy instead of the linker picking one of the
+// differently encoded copies for all of them. For the same reason they call
+// no template outside of xsimd, whose templates are instantiated on the
+// batch types of the instruction set.
+namespace simd_math_impl
+{
+namespace
+{
+    // Computes the digamma function. Arguments below 6 are shifted by the
+    // recurrence digamma(x) = digamma(x+1) - 1/x six times, unconditionally,
+    // so that all lanes follow the same path before the asymptotic series.
+    template<typename T, typename B>
+    B digamma(B const& x)
+    {
+        B const one(T(1));
+        B const epsilon(T(1e-6));
+        B const euler(T(0.5772156649015328606));
+        B const min_stable_x(T(6));
+
+        auto const small = x < min_stable_x;
+
+        B shift_sum(T(0));
+        for (int i = 0; i < 6; ++i) {
+            shift_sum += one / (x + B(static_cast<T>(i)));
+        }
+
+        B const z = xsimd::select(small, x + min_stable_x, x);
+
+        // digamma(z) = log(z) - 1/(2z) - 1/(12z^2) + 1/(120z^4) - 1/(252z^6) + ...
+        B const r = one / z;
+        B const r2 = r * r;
+        B result = xsimd::log(z) - B(T(0.5)) * r
+                 + r2 * (B(T(-1. / 12)) + r2 * (B(T(1. / 120)) + r2 * B(T(-1. / 252))));
+        result = xsimd::select(small, result - shift_sum, result);
+
+        return xsimd::select(x < epsilon, -euler - one / x, result);
+    }
+
+    template<typename B>
+    B exp(B const& x)
+    {
+        return xsimd::exp(x);
+    }
+
+    // Computes the logarithm of the gamma function. Arguments below 8 are
+    // shifted by lgamma(x) = lgamma(x+8) - log(x(x+1)...(x+7)) before the
+    // Stirling series. xsimd::lgamma is not used because its single
+    // precision version is inaccurate around the minimum of the function.
+    template<typename T, typename B>
+    B lgamma(B const& x)
+    {
+        B const one(T(1));
+        B const min_stable_x(T(8));
+
+        auto const small = x < min_stable_x;
+
+        B shift_product = x;
+        for (int i = 1; i < 8; ++i) {
+            shift_product *= x + B(static_cast<T>(i));
+        }
+
+        B const z = xsimd::select(small, x + min_stable_x, x);
+
+        // lgamma(z) = (z - 1/2) log(z) - z + log(2 pi)/2
+        //           + 1/(12z) - 1/(360z^3) + 1/(1260z^5) - 1/(1680z^7) + 1/(1188z^9) - ...
+        B const r = one / z;
+        B const r2 = r * r;
+        B const series = r * (B(T(1. / 12)) + r2 * (B(T(-1. / 360)) + r2 * (B(T(1. / 1260))
+                       + r2 * (B(T(-1. / 1680)) + r2 * B(T(1. / 1188))))));
+        B const result = (z - B(T(0.5))) * xsimd::log(z) - z + B(T(0.91893853320467274178)) + series;
+
+        return xsimd::select(small, result - xsimd::log(shift_product), result);
+    }
+
+    // Applies func to n values. The tail shorter than a batch is padded with
+    // ones, which are valid arguments for all the kernels above.
+    template<typename T, typename B, typename F>
+    void apply(F func, T const* x, std::size_t n, T* result)
+    {
+        constexpr std::size_t size = B::size;
+
+        std::size_t i = 0;
+        for (; i + size <= n; i += size) {
+            B batch;
+            batch.load_unaligned(x + i);
+            func(batch).store_unaligned(result + i);
+        }
+
+        if (i < n) {
+            T buffer[size];
+            for (std::size_t j = 0; j < size; ++j) {
+                buffer[j] = i + j < n ? x[i + j] : T(1);
+            }
+
+            B batch;
+            batch.load_unaligned(buffer);
+            func(batch).store_unaligned(buffer);
+
+            for (std::size_t j = 0; i + j < n; ++j) {
+                result[i + j] = buffer[j];
+            }
+        }
+    }
+
+    // Defines math_functions<T> for batch type B of scalar type T.
+    template<typename T, typename B>
+    struct kernel_set
+    {
+        static void digamma(T const* x, std::size_t n, T* result)
+        {
+            apply<T, B>([](B const& batch) { return simd_math_impl::digamma<T>(batch); }, x, n, result);
+        }
+
+        static void exp(T const* x, std::size_t n, T* result)
+        {
+            apply<T, B>([](B const& batch) { return simd_math_impl::exp(batch); }, x, n, result);
+        }
+
+        static void lgamma(T const* x, std::size_t n, T* result)
+        {
+            apply<T, B>([](B const& batch) { return simd_math_impl::lgamma<T>(batch); }, x, n, result);
+        }
+
+        static constexpr math_functions<T> functions()
+        {
+            return {&kernel_set::digamma, &kernel_set::exp, &kernel_set::lgamma};
+        }
+    };
+}
+}
+
+#endif
@@ -0,0 +1,26 @@
+#include "simd_math.hpp"
+
+#include <xsimd/xsimd.hpp>
+
+#if XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION
+# include "simd_math_impl.hpp"
+#endif
+
+
+// Returns the SSE2 kernels, or nullptr if the build does not target SSE2.
+math_kernels const* sse2_math_kernels()
+{
+#if XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION
+    using float64_kernels = simd_math_impl::kernel_set<double, xsimd::batch<double, 2>>;
+    using float32_kernels = simd_math_impl::kernel_set<float, xsimd::batch<float, 4>>;
+
+    static math_kernels const kernels = {
+        "sse2",
+        float64_kernels::functions(),
+        float32_kernels::functions(),
+    };
+    return &kernels;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,168 @@
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "sparse_matrix.hpp"
+
+
+namespace
+{
+    // CSR arrays owned by a matrix.
+    struct owned_arrays
+    {
+        std::vector<sparse_matrix::offset_type> row_offsets;
+        std::vector<sparse_matrix::index_type> col_indices;
+        std::vector<double> values;
+    };
+
+    // Row offsets of a matrix without rows.
+    sparse_matrix::offset_type const empty_row_offsets[] = {0};
+}
+
+sparse_matrix::sparse_matrix()
+    : row_offsets_{empty_row_offsets}
+{
+}
+
+sparse_matrix::sparse_matrix(std::size_t col_count,
+                             std::vector<offset_type> row_offsets,
+                             std::vector<index_type> col_indices,
+                             std::vector<double> values)
+    : col_count_{col_count}
+{
+    if (row_offsets.empty() || row_offsets.front() != 0) {
+        throw std::invalid_argument("row_offsets must start with zero");
+    }
+
+    auto arrays = std::make_shared<owned_arrays>();
+    arrays->row_offsets = std::move(row_offsets);
+    arrays->col_indices = std::move(col_indices);
+    arrays->values = std::move(values);
+
+    if (arrays->col_indices.size() != arrays->values.size()
+        || arrays->row_offsets.back() != arrays->values.size()) {
+        throw std::invalid_argument("sparse matrix arrays have inconsistent sizes");
+    }
+
+    row_count_ = arrays->row_offsets.size() - 1;
+    row_offsets_ = arrays->row_offsets.data();
+    col_indices_ = arrays->col_indices.data();
+    values_ = arrays->values.data();
+    storage_ = std::move(arrays);
+
+    validate();
+}
+
+sparse_matrix::sparse_matrix(xt::xtensor<double, 2> const& dense)
+    : col_count_{dense.shape()[1]}
+{
+    std::size_t const row_count = dense.shape()[0];
+
+    auto arrays = std::make_shared<owned_arrays>();
+    arrays->row_offsets.reserve(row_count + 1);
+    arrays->row_offsets.push_back(0);
+
+    for (std::size_t row = 0; row < row_count; ++row) {
+        for (std::size_t col = 0; col < col_count_; ++col) {
+            double const value = dense(row, col);
+            if (value != 0) {
+                arrays->col_indices.push_back(static_cast<index_type>(col));
+                arrays->values.push_back(value);
+            }
+        }
+        arrays->row_offsets.push_back(arrays->values.size());
+    }
+
+    row_count_ = row_count;
+    row_offsets_ = arrays->row_offsets.data();
+    col_indices_ = arrays->col_indices.data();
+    values_ = arrays->values.data();
+    storage_ = std::move(arrays);
+}
+
+sparse_matrix::sparse_matrix(std::size_t row_count,
+                             std::size_t col_count,
+                             offset_type const* row_offsets,
+                             index_type const* col_indices,
+                             double const* values,
+                             std::shared_ptr<void const> storage)
+    : row_count_{row_count}
+    , col_count_{col_count}
+    , storage_{std::move(storage)}
+    , row_offsets_{row_offsets}
+    , col_indices_{col_indices}
+    , values_{values}
+{
+    if (row_offsets_[0] != 0) {
+        throw std::invalid_argument("row_offsets must start with zero");
+    }
+
+    validate();
+}
+
+std::size_t sparse_matrix::row_count() const
+{
+    return row_count_;
+}
+
+std::size_t sparse_matrix::col_count() const
+{
+    return col_count_;
+}
+
+std::size_t sparse_matrix::nonzero_count() const
+{
+    return row_offsets_[row_count_] - row_offsets_[0];
+}
+
+sparse_matrix::row_view sparse_matrix::row(std::size_t row) const
+{
+    std::size_t const begin = row_offsets_[row];
+    std::size_t const end = row_offsets_[row + 1];
+    return row_view{end - begin, col_indices_ + begin, values_ + begin};
+}
+
+sparse_matrix sparse_matrix::rows(std::size_t begin, std::size_t end) const
+{
+    if (begin > end || end > row_count()) {
+        throw std::out_of_range("row range out of range");
+    }
+
+    sparse_matrix result{*this};
+    result.row_count_ = end - begin;
+    result.row_offsets_ = row_offsets_ + begin;
+    return result;
+}
+
+xt::xtensor<double, 2> sparse_matrix::to_dense() const
+{
+    xt::xtensor<double, 2> dense = xt::zeros<double>({row_count(), col_count_});
+
+    for (std::size_t row_index = 0; row_index < row_count(); ++row_index) {
+        row_view const elements = row(row_index);
+        for (std::size_t i = 0; i < elements.size; ++i) {
+            dense(row_index, elements.indices[i]) += elements.values[i];
+        }
+    }
+
+    return dense;
+}
+
+void sparse_matrix::validate() const
+{
+    for (std::size_t i = 1; i <= row_count_; ++i) {
+        if (row_offsets_[i] < row_offsets_[i - 1]) {
+            throw std::invalid_argument("row_offsets must be nondecreasing");
+        }
+    }
+
+    for (std::size_t i = 0; i < row_offsets_[row_count_]; ++i) {
+        if (col_indices_[i] >= col_count_) {
+            throw std::invalid_argument("column index out of range");
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef INCLUDED_SPARSE_MATRIX_HPP
+#define INCLUDED_SPARSE_MATRIX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+
+// Document-word count matrix in the compressed sparse row (CSR) format. Rows
+// are documents and columns are words. Only nonzero counts are stored.
+//
+// The matrix is immutable. Its arrays are held by shared storage, so copies
+// and row ranges are cheap and a matrix can view arrays in a memory-mapped
+// file.
+class sparse_matrix
+{
+  public:
+    // Type used to store column (word) indices.
+    using index_type = std::uint32_t;
+
+    // Type used to store row offsets.
+    using offset_type = std::uint64_t;
+
+    // Nonzero elements in a row of sparse_matrix.
+    struct row_view
+    {
+        // The number of nonzero elements in the row.
+        std::size_t size;
+
+        // Column indices of the nonzero elements.
+        index_type const* indices;
+
+        // Values of the nonzero elements.
+        double const* values;
+    };
+
+    // Creates an empty matrix.
+    sparse_matrix();
+
+    // Creates a matrix from CSR arrays. The nonzero elements of row i are
+    // stored in the range [row_offsets[i], row_offsets[i + 1]) of col_indices
+    // and values.
+    sparse_matrix(std::size_t col_count,
+                  std::vector<offset_type> row_offsets,
+                  std::vector<index_type> col_indices,
+                  std::vector<double> values);
+
+    // Creates a matrix from nonzero elements of a dense matrix.
+    explicit sparse_matrix(xt::xtensor<double, 2> const& dense);
+
+    // Creates a matrix viewing CSR arrays that storage keeps alive. The
+    // arrays are validated like the ones given to the owning constructor.
+    sparse_matrix(std::size_t row_count,
+                  std::size_t col_count,
+                  offset_type const* row_offsets,
+                  index_type const* col_indices,
+                  double const* values,
+                  std::shared_ptr<void const> storage);
+
+    // Returns the number of rows (documents).
+    std::size_t row_count() const;
+
+    // Returns the number of columns (words).
+    std::size_t col_count() const;
+
+    // Returns the number of stored nonzero elements.
+    std::size_t nonzero_count() const;
+
+    // Returns the nonzero elements in the row-th row.
+    row_view row(std::size_t row) const;
+
+    // Returns the rows in [begin, end). The result shares the storage of
+    // this matrix.
+    sparse_matrix rows(std::size_t begin, std::size_t end) const;
+
+    // Returns the dense matrix representation.
+    xt::xtensor<double, 2> to_dense() const;
+
+  private:
+    // Checks the consistency of the arrays.
+    void validate() const;
+
+  private:
+    std::size_t row_count_ = 0;
+    std::size_t col_count_ = 0;
+    std::shared_ptr<void const> storage_;
+
+    // Element i of the matrix is col_indices_[i] and values_[i]. The
+    // elements of row r are in [row_offsets_[r], row_offsets_[r + 1]). A row
+    // range moves row_offsets_ and keeps the other pointers.
+    offset_type const* row_offsets_ = nullptr;
+    index_type const* col_indices_ = nullptr;
+    double const* values_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "binary_io.hpp"
+#include "sparse_matrix.hpp"
+#include "sparse_matrix_io.hpp"
+
+
+namespace
+{
+    // Binary corpus format. Integers and arrays are stored in the native
+    // byte order, which is checked with byte_order_mark on loading.
+    char const corpus_magic[8] = {'L', 'D', 'A', 'C', 'O', 'R', 'P', 'S'};
+    constexpr std::uint32_t corpus_version = 1;
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    // The header occupies the first two alignment units.
+    constexpr std::size_t corpus_header_size = 2 * binary_alignment;
+
+    struct corpus_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t row_count;
+        std::uint64_t col_count;
+        std::uint64_t nonzero_count;
+        std::uint64_t offsets_offset;
+        std::uint64_t indices_offset;
+        std::uint64_t values_offset;
+        std::uint64_t file_size;
+        std::uint64_t checksum;
+    };
+
+    static_assert(sizeof(corpus_header) <= corpus_header_size, "corpus header is too large");
+
+    // Returns true if size bytes at offset fit in a file of file_size bytes.
+    bool section_fits(std::uint64_t offset, std::uint64_t size, std::uint64_t file_size)
+    {
+        return offset <= file_size && size <= file_size - offset;
+    }
+
+    // Validates a binary corpus at data, which is aligned to at least 8
+    // bytes, and creates a matrix viewing it.
+    sparse_matrix parse_corpus(unsigned char const* data, std::size_t size, std::shared_ptr<void const> storage)
+    {
+        if (size < corpus_header_size) {
+            throw std::runtime_error("corpus file is truncated");
+        }
+
+        corpus_header header;
+        std::memcpy(&header, data, sizeof header);
+
+        if (std::memcmp(header.magic, corpus_magic, sizeof corpus_magic) != 0) {
+            throw std::runtime_error("not a binary corpus file");
+        }
+        if (header.byte_order != byte_order_mark) {
+            throw std::runtime_error("corpus file has a different byte order");
+        }
+        if (header.version != corpus_version) {
+            throw std::runtime_error("unsupported corpus file version");
+        }
+        if (header.file_size != size || size % 8 != 0) {
+            throw std::runtime_error("corpus file is truncated");
+        }
+
+        std::uint64_t const row_count = header.row_count;
+        std::uint64_t const nonzero_count = header.nonzero_count;
+
+        if (row_count >= size / sizeof(std::uint64_t)
+            || nonzero_count > size / sizeof(std::uint32_t)
+            || header.offsets_offset % binary_alignment != 0
+            || header.indices_offset % binary_alignment != 0
+            || header.values_offset % binary_alignment != 0
+            || !section_fits(header.offsets_offset, (row_count + 1) * sizeof(sparse_matrix::offset_type), size)
+            || !section_fits(header.indices_offset, nonzero_count * sizeof(sparse_matrix::index_type), size)
+            || !section_fits(header.values_offset, nonzero_count * sizeof(double), size)) {
+            throw std::runtime_error("corpus file has an invalid layout");
+        }
+
+        if (compute_checksum(data + corpus_header_size, size - corpus_header_size) != header.checksum) {
+            throw std::runtime_error("corpus file checksum mismatch");
+        }
+
+        auto const row_offsets = reinterpret_cast<sparse_matrix::offset_type const*>(data + header.offsets_offset);
+        if (row_offsets[row_count] != nonzero_count) {
+            throw std::runtime_error("corpus file has an invalid layout");
+        }
+
+        try {
+            return sparse_matrix{
+                row_count,
+                header.col_count,
+                row_offsets,
+                reinterpret_cast<sparse_matrix::index_type const*>(data + header.indices_offset),
+                reinterpret_cast<double const*>(data + header.values_offset),
+                std::move(storage)
+            };
+        } catch (std::invalid_argument const& e) {
+            throw std::runtime_error(std::string{"corpus file is inconsistent: "} + e.what());
+        }
+    }
+}
+
+void save_sparse_matrix(std::ostream& output, sparse_matrix const& matrix)
+{
+    std::size_t const row_count = matrix.row_count();
+    std::size_t const nonzero_count = matrix.nonzero_count();
+
+    corpus_header header = {};
+    std::memcpy(header.magic, corpus_magic, sizeof corpus_magic);
+    header.version = corpus_version;
+    header.byte_order = byte_order_mark;
+    header.row_count = row_count;
+    header.col_count = matrix.col_count();
+    header.nonzero_count = nonzero_count;
+    header.offsets_offset = corpus_header_size;
+    header.indices_offset = align_binary_size(header.offsets_offset + (row_count + 1) * sizeof(sparse_matrix::offset_type));
+    header.values_offset = align_binary_size(header.indices_offset + nonzero_count * sizeof(sparse_matrix::index_type));
+    header.file_size = align_binary_size(header.values_offset + nonzero_count * sizeof(double));
+
+    unsigned char const padding[binary_alignment] = {};
+
+    // Passes the content after the header to consume in pieces. The row
+    // offsets are rebased to zero since the matrix may be a row range.
+    auto const for_each_chunk = [&](auto&& consume) {
+        std::vector<sparse_matrix::offset_type> offsets;
+        offsets.reserve(1024);
+        offsets.push_back(0);
+
+        sparse_matrix::offset_type offset = 0;
+        for (std::size_t row = 0; row < row_count; ++row) {
+            offset += matrix.row(row).size;
+            offsets.push_back(offset);
+
+            if (offsets.size() == offsets.capacity()) {
+                consume(reinterpret_cast<unsigned char const*>(offsets.data()), offsets.size() * sizeof offsets[0]);
+                offsets.clear();
+            }
+        }
+        consume(reinterpret_cast<unsigned char const*>(offsets.data()), offsets.size() * sizeof offsets[0]);
+        consume(padding, header.indices_offset - header.offsets_offset - (row_count + 1) * sizeof offsets[0]);
+
+        for (std::size_t row = 0; row < row_count; ++row) {
+            sparse_matrix::row_view const elements = matrix.row(row);
+            consume(reinterpret_cast<unsigned char const*>(elements.indices), elements.size * sizeof elements.indices[0]);
+        }
+        consume(padding, header.values_offset - header.indices_offset - nonzero_count * sizeof(sparse_matrix::index_type));
+
+        for (std::size_t row = 0; row < row_count; ++row) {
+            sparse_matrix::row_view const elements = matrix.row(row);
+            consume(reinterpret_cast<unsigned char const*>(elements.values), elements.size * sizeof elements.values[0]);
+        }
+        consume(padding, header.file_size - header.values_offset - nonzero_count * sizeof(double));
+    };
+
+    checksum_builder checksum;
+    for_each_chunk([&](unsigned char const* data, std::size_t size) { checksum.add(data, size); });
+    header.checksum = checksum.value();
+
+    unsigned char header_block[corpus_header_size] = {};
+    std::memcpy(header_block, &header, sizeof header);
+    output.write(reinterpret_cast<char const*>(header_block), sizeof header_block);
+
+    for_each_chunk([&](unsigned char const* data, std::size_t size) {
+        output.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    });
+}
+
+sparse_matrix load_sparse_matrix(std::istream& input)
+{
+    std::string const content{std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+
+    // Copy to a buffer aligned for the arrays.
+    auto buffer = std::make_shared<std::vector<std::uint64_t>>((content.size() + 7) / 8);
+    std::memcpy(buffer->data(), content.data(), content.size());
+
+    auto const data = reinterpret_cast<unsigned char const*>(buffer->data());
+    return parse_corpus(data, content.size(), std::move(buffer));
+}
+
+sparse_matrix map_sparse_matrix(std::string const& path)
+{
+    auto map = std::make_shared<memory_map>(path);
+    unsigned char const* data = map->data();
+    std::size_t const size = map->size();
+
+    return parse_corpus(data, size, std::move(map));
+}
+
+bool is_binary_sparse_matrix(std::istream& input)
+{
+    char magic[sizeof corpus_magic] = {};
+    auto const start = input.tellg();
+
+    input.read(magic, sizeof magic);
+    bool const binary = input.gcount() == sizeof magic
+                     && std::memcmp(magic, corpus_magic, sizeof magic) == 0;
+
+    input.clear();
+    input.seekg(start);
+    return binary;
+}
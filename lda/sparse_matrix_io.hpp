@@ -0,0 +1,31 @@
+#ifndef INCLUDED_SPARSE_MATRIX_IO_HPP
+#define INCLUDED_SPARSE_MATRIX_IO_HPP
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "sparse_matrix.hpp"
+
+
+// Saves a sparse matrix in the binary corpus format. The file holds a
+// header followed by the row offsets, the column indices and the values of
+// the CSR arrays, each aligned to 64 bytes in the native byte order. The
+// header records a checksum of the rest of the file.
+void save_sparse_matrix(std::ostream& output, sparse_matrix const& matrix);
+
+// Loads a sparse matrix saved by save_sparse_matrix. Throws
+// std::runtime_error if the content is not a valid binary corpus.
+sparse_matrix load_sparse_matrix(std::istream& input);
+
+// Maps a file saved by save_sparse_matrix. The returned matrix views the
+// mapped arrays without copying them and keeps the file mapped while it or
+// its copies exist. Throws std::runtime_error if the file cannot be mapped
+// or is not a valid binary corpus.
+sparse_matrix map_sparse_matrix(std::string const& path);
+
+// Returns true if the stream starts with the binary corpus format. The
+// stream position is not changed.
+bool is_binary_sparse_matrix(std::istream& input);
+
+#endif
@@ -0,0 +1,71 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <catch.hpp>
+
+#include "../lda/arena.hpp"
+
+
+TEST_CASE("arena allocates aligned and disjoint buffers")
+{
+    arena buffers;
+
+    char* const a = buffers.allocate<char>(3);
+    double* const b = buffers.allocate<double>(100);
+    std::size_t* const c = buffers.allocate<std::size_t>(1);
+
+    CHECK(reinterpret_cast<std::uintptr_t>(a) % arena::alignment == 0);
+    CHECK(reinterpret_cast<std::uintptr_t>(b) % arena::alignment == 0);
+    CHECK(reinterpret_cast<std::uintptr_t>(c) % arena::alignment == 0);
+
+    std::memset(a, 1, 3);
+    for (std::size_t i = 0; i < 100; ++i) {
+        b[i] = 2;
+    }
+    *c = 3;
+
+    CHECK(a[2] == 1);
+    CHECK(b[0] == 2);
+    CHECK(b[99] == 2);
+    CHECK(*c == 3);
+}
+
+TEST_CASE("arena reuses its memory after reset")
+{
+    arena buffers;
+
+    double* const first = buffers.allocate<double>(10);
+    buffers.reset();
+    double* const second = buffers.allocate<double>(10);
+
+    CHECK(first == second);
+    CHECK(buffers.heap_allocation_count() == 1);
+}
+
+TEST_CASE("arena grows to the largest round of allocations")
+{
+    arena buffers;
+
+    auto const allocate_round = [&] {
+        for (std::size_t i = 0; i < 20; ++i) {
+            buffers.allocate<double>(1000 * (i + 1));
+        }
+        buffers.reset();
+    };
+
+    // The blocks of the first round are merged into one on reset, which
+    // fits the later rounds.
+    allocate_round();
+    std::size_t const allocation_count = buffers.heap_allocation_count();
+    CHECK(allocation_count > 2);
+    CHECK(buffers.capacity() == 210000 * sizeof(double));
+
+    allocate_round();
+    allocate_round();
+    CHECK(buffers.heap_allocation_count() == allocation_count);
+
+    buffers.allocate<double>(10);
+    buffers.reset();
+    CHECK(buffers.heap_allocation_count() == allocation_count);
+}
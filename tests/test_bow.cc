@@ -0,0 +1,146 @@
+#include <sstream>
+
+#include <catch.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/sparse_matrix.hpp"
+#include "../tsv/bow.hpp"
+#include "../tsv/tsv.hpp"
+
+
+TEST_CASE("uci_docword_reader reads a docword file")
+{
+    std::istringstream stream{
+        "4\n"
+        "3\n"
+        "4\n"
+        "1 1 2\n"
+        "1 3 1\n"
+        "3 2 5\n"
+        "3 3 1\n"
+    };
+    uci_docword_reader reader{stream};
+
+    CHECK(reader.document_count() == 4);
+    CHECK(reader.word_count() == 3);
+
+    sparse_matrix const documents = reader.read_all();
+    xt::xtensor<double, 2> const expected = {
+        {2, 0, 1},
+        {0, 0, 0},
+        {0, 5, 1},
+        {0, 0, 0},
+    };
+
+    CHECK(documents.col_count() == 3);
+    CHECK((documents.to_dense() == expected));
+}
+
+TEST_CASE("uci_docword_reader reads documents in chunks")
+{
+    std::istringstream stream{
+        "3\n"
+        "2\n"
+        "3\n"
+        "1 1 1\n"
+        "2 2 2\n"
+        "3 1 3\n"
+    };
+    uci_docword_reader reader{stream};
+
+    xt::xtensor<double, 2> const expected_first = {
+        {1, 0},
+        {0, 2},
+    };
+    xt::xtensor<double, 2> const expected_second = {
+        {3, 0},
+    };
+
+    CHECK((reader.read(2).to_dense() == expected_first));
+    CHECK((reader.read(2).to_dense() == expected_second));
+    CHECK(reader.read(2).row_count() == 0);
+}
+
+TEST_CASE("uci_docword_reader rejects malformed files")
+{
+    SECTION("truncated header")
+    {
+        std::istringstream stream{"3\n2\n"};
+        CHECK_THROWS_AS(uci_docword_reader{stream}, tsv_error);
+    }
+
+    SECTION("word out of range")
+    {
+        std::istringstream stream{"1\n2\n1\n1 3 1\n"};
+        uci_docword_reader reader{stream};
+
+        try {
+            reader.read_all();
+            FAIL("no exception thrown");
+        } catch (tsv_error const& e) {
+            CHECK(e.line() == 4);
+        }
+    }
+
+    SECTION("unsorted documents")
+    {
+        std::istringstream stream{"2\n2\n2\n2 1 1\n1 1 1\n"};
+        uci_docword_reader reader{stream};
+        CHECK_THROWS_AS(reader.read_all(), tsv_error);
+    }
+}
+
+TEST_CASE("libsvm_reader reads a libsvm file")
+{
+    std::istringstream stream{
+        "1 1:2 3:1\n"
+        "0\n"
+        "2 2:5 3:1 # comment\n"
+    };
+
+    sparse_matrix const documents = libsvm_reader{stream}.read_all();
+    xt::xtensor<double, 2> const expected = {
+        {2, 0, 1},
+        {0, 0, 0},
+        {0, 5, 1},
+    };
+
+    CHECK((documents.to_dense() == expected));
+}
+
+TEST_CASE("libsvm_reader supports zero-based indices and a fixed vocabulary")
+{
+    std::istringstream stream{
+        "0:1 2:3\n"
+        "1:4\n"
+    };
+
+    sparse_matrix const documents = libsvm_reader{stream, 0, 5}.read_all();
+    xt::xtensor<double, 2> const expected = {
+        {1, 0, 3, 0, 0},
+        {0, 4, 0, 0, 0},
+    };
+
+    CHECK((documents.to_dense() == expected));
+}
+
+TEST_CASE("libsvm_reader rejects malformed lines")
+{
+    SECTION("zero index in one-based file")
+    {
+        std::istringstream stream{"1 0:1\n"};
+        CHECK_THROWS_AS(libsvm_reader{stream}.read_all(), tsv_error);
+    }
+
+    SECTION("missing count")
+    {
+        std::istringstream stream{"1 1:1\n1 2:\n"};
+
+        try {
+            libsvm_reader{stream}.read_all();
+            FAIL("no exception thrown");
+        } catch (tsv_error const& e) {
+            CHECK(e.line() == 2);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <catch.hpp>
+#include <xtensor/xrandom.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/estep.hpp"
+#include "../lda/sparse_matrix.hpp"
+
+
+namespace
+{
+    // Fits a document with the straightforward loops of the generic path.
+    template<typename T>
+    std::vector<T> reference_fit(sparse_matrix::row_view const& doc,
+                                 std::vector<T> const& word_topic_geoexp,
+                                 std::size_t topic_count,
+                                 estep::iteration_options const& options,
+                                 std::vector<T> dirichlets)
+    {
+        std::vector<T> geoexp(topic_count);
+        std::vector<T> counts(topic_count);
+
+        for (int iter = 0; iter < options.max_iter_count; ++iter) {
+            estep::dirichlet_geometric_expect(dirichlets.data(), topic_count, geoexp.data());
+            std::fill(counts.begin(), counts.end(), T(0));
+
+            for (std::size_t i = 0; i < doc.size; ++i) {
+                T const* word_geoexp = &word_topic_geoexp[doc.indices[i] * topic_count];
+
+                T norm = 0;
+                for (std::size_t k = 0; k < topic_count; ++k) {
+                    norm += geoexp[k] * word_geoexp[k];
+                }
+                for (std::size_t k = 0; k < topic_count; ++k) {
+                    counts[k] += static_cast<T>(doc.values[i] / (norm + estep::epsilon)) * word_geoexp[k];
+                }
+            }
+
+            double const max_delta = estep::update_doc_topic_dirichlets(
+                options.doc_topic_prior, geoexp.data(), counts.data(), topic_count, dirichlets.data());
+            if (max_delta <= options.convergence_threshold) {
+                break;
+            }
+        }
+
+        return dirichlets;
+    }
+
+    template<typename T>
+    void check_fit_sparse_document(std::size_t topic_count, double tolerance)
+    {
+        std::size_t const word_count = 50;
+
+        xt::xtensor<double, 2> const data = xt::floor(xt::random::rand<double>({std::size_t{1}, word_count}) * 4);
+        sparse_matrix const matrix{data};
+
+        xt::xtensor<T, 1> const topics = xt::random::rand<T>({word_count * topic_count}, T(0.01), T(1));
+        std::vector<T> const word_topic_geoexp(topics.begin(), topics.end());
+
+        xt::xtensor<T, 1> const init = xt::random::rand<T>({topic_count}, T(0.1), T(1.1));
+        std::vector<T> const init_dirichlets(init.begin(), init.end());
+
+        estep::iteration_options const options = {0.1, 100, 1e-6};
+
+        std::vector<T> const expected = reference_fit(
+            matrix.row(0), word_topic_geoexp, topic_count, options, init_dirichlets);
+
+        std::vector<T> dirichlets = init_dirichlets;
+        std::vector<T> geoexp(topic_count);
+        std::vector<T> counts(topic_count);
+        estep::fit_sparse_document(matrix.row(0), word_topic_geoexp.data(), topic_count, topic_count,
+                                   options, dirichlets.data(), geoexp.data(), counts.data());
+
+        for (std::size_t k = 0; k < topic_count; ++k) {
+            CHECK(std::fabs(dirichlets[k] - expected[k]) < tolerance * (1 + std::fabs(expected[k])));
+        }
+    }
+}
+
+TEST_CASE("fit_sparse_document agrees with the reference for specialized topic counts")
+{
+    for (std::size_t const topic_count : std::vector<std::size_t>{8, 16, 32, 64, 12}) {
+        check_fit_sparse_document<double>(topic_count, 1e-9);
+        check_fit_sparse_document<float>(topic_count, 1e-3);
+    }
+}
@@ -0,0 +1,137 @@
+#include <cstddef>
+
+#include <catch.hpp>
+#include <xtensor/xmath.hpp>
+#include <xtensor/xrandom.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/gemm.hpp"
+#include "../lda/lda.hpp"
+
+
+namespace
+{
+    // Computes alpha op(A) op(B) + beta C in the obvious way.
+    xt::xtensor<double, 2> reference_gemm(bool trans_a, bool trans_b,
+                                          double alpha,
+                                          xt::xtensor<double, 2> const& a,
+                                          xt::xtensor<double, 2> const& b,
+                                          double beta,
+                                          xt::xtensor<double, 2> const& c)
+    {
+        xt::xtensor<double, 2> result = beta * c;
+        std::size_t const k = trans_a ? a.shape()[0] : a.shape()[1];
+
+        for (std::size_t i = 0; i < result.shape()[0]; ++i) {
+            for (std::size_t j = 0; j < result.shape()[1]; ++j) {
+                for (std::size_t p = 0; p < k; ++p) {
+                    double const a_ip = trans_a ? a(p, i) : a(i, p);
+                    double const b_pj = trans_b ? b(j, p) : b(p, j);
+                    result(i, j) += alpha * a_ip * b_pj;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    // gemm_function that counts the number of calls.
+    int counting_gemm_calls = 0;
+
+    void counting_gemm(bool trans_a, bool trans_b,
+                       std::size_t m, std::size_t n, std::size_t k,
+                       double alpha,
+                       double const* a, std::size_t lda,
+                       double const* b, std::size_t ldb,
+                       double beta,
+                       double* c, std::size_t ldc)
+    {
+        counting_gemm_calls++;
+        builtin_gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+}
+
+TEST_CASE("builtin_gemm agrees with the naive matrix product")
+{
+    std::size_t const m = 7;
+    std::size_t const n = 300;
+    std::size_t const k = 150;
+
+    for (bool const trans_a : {false, true}) {
+        for (bool const trans_b : {false, true}) {
+            xt::xtensor<double, 2> const a = trans_a ? xt::random::rand<double>({k, m})
+                                                     : xt::random::rand<double>({m, k});
+            xt::xtensor<double, 2> const b = trans_b ? xt::random::rand<double>({n, k})
+                                                     : xt::random::rand<double>({k, n});
+            xt::xtensor<double, 2> c = xt::random::rand<double>({m, n});
+
+            xt::xtensor<double, 2> const expected = reference_gemm(trans_a, trans_b, 0.5, a, b, 2.0, c);
+
+            builtin_gemm(trans_a, trans_b, m, n, k,
+                         0.5, a.raw_data(), a.shape()[1],
+                         b.raw_data(), b.shape()[1],
+                         2.0, c.raw_data(), n);
+
+            CHECK(xt::amax(xt::abs(c - expected))() < 1e-9);
+        }
+    }
+}
+
+TEST_CASE("builtin_sgemm agrees with builtin_gemm")
+{
+    std::size_t const m = 5;
+    std::size_t const n = 270;
+    std::size_t const k = 140;
+
+    for (bool const trans_a : {false, true}) {
+        for (bool const trans_b : {false, true}) {
+            xt::xtensor<double, 2> const a = trans_a ? xt::random::rand<double>({k, m})
+                                                     : xt::random::rand<double>({m, k});
+            xt::xtensor<double, 2> const b = trans_b ? xt::random::rand<double>({n, k})
+                                                     : xt::random::rand<double>({k, n});
+            xt::xtensor<double, 2> c = xt::random::rand<double>({m, n});
+
+            xt::xtensor<float, 2> const float_a = a;
+            xt::xtensor<float, 2> const float_b = b;
+            xt::xtensor<float, 2> float_c = c;
+
+            builtin_gemm(trans_a, trans_b, m, n, k,
+                         0.5, a.raw_data(), a.shape()[1],
+                         b.raw_data(), b.shape()[1],
+                         2.0, c.raw_data(), n);
+
+            builtin_sgemm(trans_a, trans_b, m, n, k,
+                          0.5f, float_a.raw_data(), float_a.shape()[1],
+                          float_b.raw_data(), float_b.shape()[1],
+                          2.0f, float_c.raw_data(), n);
+
+            xt::xtensor<double, 2> const result = float_c;
+            CHECK(xt::amax(xt::abs(result - c))() < 1e-3);
+        }
+    }
+
+    CHECK(set_sgemm_backend(nullptr) == &builtin_sgemm);
+}
+
+TEST_CASE("gemm backend can be replaced")
+{
+    xt::xtensor<double, 2> const data = {
+        {1, 2, 0},
+        {0, 3, 4},
+    };
+    xt::xtensor<double, 2> const topic_word_dirichlets = {
+        {5, 1, 1},
+        {1, 1, 5},
+    };
+
+    latent_dirichlet_allocation::config config;
+    latent_dirichlet_allocation lda{config, topic_word_dirichlets};
+
+    counting_gemm_calls = 0;
+    gemm_function const prev_backend = set_gemm_backend(&counting_gemm);
+    lda.transform(data);
+    set_gemm_backend(prev_backend);
+
+    CHECK(counting_gemm_calls > 0);
+    CHECK(set_gemm_backend(nullptr) == &builtin_gemm);
+}
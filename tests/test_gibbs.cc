@@ -0,0 +1,96 @@
+#include <cstddef>
+#include <stdexcept>
+
+#include <catch.hpp>
+#include <xtensor/xmath.hpp>
+#include <xtensor/xtensor.hpp>
+#include <xtensor/xview.hpp>
+
+#include "../lda/gibbs.hpp"
+#include "../lda/lda.hpp"
+#include "../lda/sparse_matrix.hpp"
+
+
+namespace
+{
+    // Documents drawn from two topics over disjoint halves of eight words.
+    xt::xtensor<double, 2> make_two_topic_data()
+    {
+        xt::xtensor<double, 2> data = xt::zeros<double>({std::size_t{40}, std::size_t{8}});
+
+        for (std::size_t doc = 0; doc < data.shape()[0]; ++doc) {
+            std::size_t const first_word = doc % 2 == 0 ? 0 : 4;
+            for (std::size_t i = 0; i < 4; ++i) {
+                data(doc, first_word + i) = static_cast<double>((doc + i) % 3 + 1);
+            }
+        }
+
+        return data;
+    }
+}
+
+TEST_CASE("gibbs_sampler keeps the token counts")
+{
+    xt::xtensor<double, 2> const data = {
+        {2, 0, 1.4},
+        {0, 3, 0.6},
+    };
+    gibbs_sampler sampler{sparse_matrix{data}, 4, 0.5, 0.1, 42};
+
+    CHECK(sampler.token_count() == 7);
+
+    for (int iter = 0; iter < 5; ++iter) {
+        sampler.sweep();
+
+        xt::xtensor<double, 2> const counts = sampler.topic_word_counts();
+        REQUIRE(counts.shape()[0] == 4);
+        REQUIRE(counts.shape()[1] == 3);
+
+        xt::xtensor<double, 1> const word_counts = xt::sum(counts, {0});
+        CHECK(word_counts(0) == 2);
+        CHECK(word_counts(1) == 3);
+        CHECK(word_counts(2) == 2);
+    }
+}
+
+TEST_CASE("gibbs_sampler rejects invalid parameters")
+{
+    sparse_matrix const data{xt::xtensor<double, 2>{{1, 2}}};
+
+    CHECK_THROWS_AS((gibbs_sampler{data, 0, 0.5, 0.1, 0}), std::invalid_argument);
+    CHECK_THROWS_AS((gibbs_sampler{data, 2, 0, 0.1, 0}), std::invalid_argument);
+    CHECK_THROWS_AS((gibbs_sampler{sparse_matrix{xt::xtensor<double, 2>{{-1}}}, 2, 0.5, 0.1, 0}),
+                    std::invalid_argument);
+}
+
+TEST_CASE("latent_dirichlet_allocation learns topics with the gibbs engine")
+{
+    xt::xtensor<double, 2> const data = make_two_topic_data();
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    config.doc_topic_prior = 0.1;
+    config.topic_word_prior = 0.01;
+    config.outer_iter_count = 50;
+    config.engine = lda_engine::gibbs;
+
+    latent_dirichlet_allocation lda{config};
+    lda.fit(sparse_matrix{data});
+
+    xt::xtensor<double, 2> const topics = lda.topic_word_dirichlets();
+    REQUIRE(topics.shape()[0] == 2);
+    REQUIRE(topics.shape()[1] == 8);
+
+    // Each topic is concentrated on one half of the vocabulary.
+    for (std::size_t topic = 0; topic < 2; ++topic) {
+        double const first_half = xt::sum(xt::view(topics, topic, xt::range(0, 4)))();
+        double const second_half = xt::sum(xt::view(topics, topic, xt::range(4, 8)))();
+        CHECK(std::max(first_half, second_half) > 50 * std::min(first_half, second_half));
+    }
+
+    // The model is usable by the variational transform.
+    xt::xtensor<double, 2> const docs = lda.transform(data);
+    for (std::size_t doc = 0; doc < 2; ++doc) {
+        CHECK(xt::amax(xt::view(docs, doc, xt::all()))() > 0.9 * xt::sum(xt::view(docs, doc, xt::all()))());
+    }
+}
@@ -0,0 +1,218 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+#include <catch.hpp>
+#include <xtensor/xmath.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/inference.hpp"
+#include "../lda/lda.hpp"
+#include "../lda/lda_io.hpp"
+#include "../lda/sparse_matrix.hpp"
+
+
+namespace
+{
+    // The number of heap allocations made by the program so far.
+    std::atomic<std::size_t> heap_allocation_count{0};
+}
+
+// Counts the heap allocations of the test program.
+void* operator new(std::size_t size)
+{
+    heap_allocation_count++;
+    if (void* const ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    xt::xtensor<double, 2> const example_data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+
+    latent_dirichlet_allocation train_example_model()
+    {
+        latent_dirichlet_allocation::config config;
+        config.topic_count = 3;
+        config.topic_word_prior = 0.1;
+        config.doc_topic_prior = 0.1;
+
+        latent_dirichlet_allocation lda{config};
+        lda.fit(example_data);
+        return lda;
+    }
+}
+
+TEST_CASE("lda_inference gives the same result as the model")
+{
+    latent_dirichlet_allocation const lda = train_example_model();
+    lda_inference const inference{lda};
+
+    CHECK(inference.topic_count() == 3);
+    CHECK(inference.word_count() == 5);
+
+    xt::xtensor<double, 2> const expected = lda.transform(sparse_matrix{example_data});
+    xt::xtensor<double, 2> const sparse_docs = inference.transform(sparse_matrix{example_data});
+    xt::xtensor<double, 2> const dense_docs = inference.transform(example_data);
+
+    CHECK(xt::amax(xt::abs(sparse_docs - expected))() < 1e-12);
+    CHECK(xt::amax(xt::abs(dense_docs - expected))() < 1e-12);
+}
+
+TEST_CASE("lda_inference reuses a workspace")
+{
+    latent_dirichlet_allocation const lda = train_example_model();
+    lda_inference inference{lda};
+    sparse_matrix const data{example_data};
+
+    std::size_t const thread_counts[] = {1, 3};
+    std::size_t const batch_ends[] = {6, 2, 4, 6, 1};
+
+    for (std::size_t thread_count : thread_counts) {
+        inference.set_thread_count(thread_count);
+        inference_workspace workspace;
+
+        // Batches of varying sizes, each transformed like on its own.
+        for (std::size_t end : batch_ends) {
+            sparse_matrix const batch = data.rows(0, end);
+            xt::xtensor<double, 2> const expected = inference.transform(batch);
+            double const* const docs = inference.transform(batch, workspace);
+
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                CHECK(docs[i] == expected.raw_data()[i]);
+            }
+        }
+
+        CHECK(inference.document_score(data, workspace) == Approx(lda.document_score(data)).epsilon(1e-9));
+        CHECK(inference.document_score(data.rows(2, 5), workspace)
+              == Approx(lda.document_score(data.rows(2, 5))).epsilon(1e-9));
+    }
+}
+
+TEST_CASE("latent_dirichlet_allocation transforms and scores in a workspace")
+{
+    latent_dirichlet_allocation lda = train_example_model();
+    sparse_matrix const data{example_data};
+    inference_workspace workspace;
+
+    std::size_t const batch_ends[] = {6, 2, 4};
+
+    for (std::size_t end : batch_ends) {
+        sparse_matrix const batch = data.rows(0, end);
+        xt::xtensor<double, 2> const expected = lda_inference{lda}.transform(batch);
+        double const* const docs = lda.transform(batch, workspace);
+
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            CHECK(docs[i] == expected.raw_data()[i]);
+        }
+    }
+
+    CHECK(lda.document_score(data, workspace) == Approx(lda.document_score(example_data)).epsilon(1e-9));
+
+    std::size_t const start_count = heap_allocation_count;
+    lda.transform(data, workspace);
+    lda.document_score(data, workspace);
+    CHECK(heap_allocation_count - start_count == 0);
+
+    // The cached topic-word expectation follows online updates.
+    lda.partial_fit(data.rows(0, 3));
+    xt::xtensor<double, 2> const expected = lda_inference{lda}.transform(data);
+    double const* const docs = lda.transform(data, workspace);
+
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        CHECK(docs[i] == expected.raw_data()[i]);
+    }
+
+    // So does its topic-major copy used for dense data.
+    xt::xtensor<double, 2> const dense_docs = lda.transform(example_data);
+
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        CHECK(dense_docs.raw_data()[i] == Approx(expected.raw_data()[i]).epsilon(1e-6));
+    }
+}
+
+TEST_CASE("lda_inference allocates nothing with a warm workspace")
+{
+    lda_inference inference{train_example_model()};
+    sparse_matrix const data{example_data};
+
+    std::size_t const thread_counts[] = {1, 2};
+
+    for (std::size_t thread_count : thread_counts) {
+        inference.set_thread_count(thread_count);
+        inference_workspace workspace;
+
+        inference.transform(data, workspace);
+        inference.document_score(data, workspace);
+
+        std::size_t const start_count = heap_allocation_count;
+        for (std::size_t end = 1; end <= 6; ++end) {
+            inference.transform(data.rows(0, end), workspace);
+            inference.document_score(data.rows(0, end), workspace);
+        }
+        std::size_t const allocation_count = heap_allocation_count - start_count;
+
+        CHECK(allocation_count == 0);
+    }
+}
+
+TEST_CASE("lda_inference can be built from a loaded model")
+{
+    std::stringstream stream;
+    save_lda(stream, train_example_model());
+
+    lda_inference const inference{load_lda(stream)};
+
+    xt::xtensor<double, 2> const docs = inference.transform(example_data);
+    CHECK(docs.shape()[0] == 6);
+    CHECK(docs.shape()[1] == 3);
+}
+
+TEST_CASE("float_lda_inference gives the same result as the float model")
+{
+    float_latent_dirichlet_allocation const lda{train_example_model()};
+    float_lda_inference const inference{lda};
+
+    xt::xtensor<float, 2> const expected = lda.transform(sparse_matrix{example_data});
+    xt::xtensor<float, 2> const docs = inference.transform(example_data);
+
+    CHECK(xt::amax(xt::abs(docs - expected))() < 1e-4f);
+}
+
+TEST_CASE("lda_inference rejects mismatching data")
+{
+    lda_inference const inference{train_example_model()};
+
+    xt::xtensor<double, 2> const data = {{1, 2, 3}};
+    CHECK_THROWS_AS(inference.transform(data), std::logic_error);
+}
+
+TEST_CASE("lda_inference rejects an untrained model")
+{
+    latent_dirichlet_allocation::config config;
+    latent_dirichlet_allocation const lda{config};
+
+    CHECK_THROWS_AS(lda_inference{lda}, std::logic_error);
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cstddef>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include <catch.hpp>
@@ -8,8 +10,10 @@
 #include <xtensor/xreducer.hpp>
 #include <xtensor/xtensor.hpp>
 #include <xtensor/xstrided_view.hpp>
+#include <xtensor/xview.hpp>
 
 #include "../lda/lda.hpp"
+#include "../lda/sparse_matrix.hpp"
 #include "testutil.hpp"
 
 
@@ -23,29 +27,9 @@ namespace
         auto const v_norm = v / xt::norm_l2(v);
         return xt::sum(u_norm * v_norm)();
     }
-}
-
-TEST_CASE("latent_dirichlet_allocation works with default config")
-{
-    latent_dirichlet_allocation::config default_config;
-    latent_dirichlet_allocation lda{default_config};
-
-    xt::xtensor<double, 2> const data = {
-        {1, 2, 3, 4},
-        {5, 6, 7, 8},
-        {9, 0, 1, 2},
-        {3, 4, 5, 6},
-        {7, 8, 9, 0},
-    };
-    lda.fit(data);
-
-    CHECK(lda.score(data) <= 0); // log-likelihood is always non-positive
-}
 
-TEST_CASE("latent_dirichlet_allocation is consistent with sklearn")
-{
-    // Example document.
-    xt::xtensor<double, 2> const data = {
+    // Example documents of the sklearn comparison.
+    xt::xtensor<double, 2> const sklearn_example_data = {
         { 4,   3, 19, 59,   6},
         {12,   7, 45, 57,  14},
         {32,   4, 11,  5, 153},
@@ -68,16 +52,41 @@ TEST_CASE("latent_dirichlet_allocation is consistent with sklearn")
         { 4,   3, 72,  3,   9},
     };
 
-    // Topic-word and document-topic dirichlets estimated by sklearn's LDA.
-    // The order of topics may not match ours because of randomness in the
-    // training algorithm.
-    xt::xtensor<double, 2> const sklearn_topics = {
+    // Topic-word dirichlets estimated by sklearn's LDA from the example.
+    xt::xtensor<double, 2> const sklearn_example_topics = {
         {384.0,  31.3,  72.1,  78.7,  88.6},
         { 19.2,  16.0,  73.0, 231.0,  35.4},
         { 45.3,  15.9,  44.5,  18.5, 708.0},
         { 10.0,  16.2, 518.0,  30.6,  41.4},
         { 59.1, 324.0,   9.1,  14.1,  16.1},
     };
+}
+
+TEST_CASE("latent_dirichlet_allocation works with default config")
+{
+    latent_dirichlet_allocation::config default_config;
+    latent_dirichlet_allocation lda{default_config};
+
+    xt::xtensor<double, 2> const data = {
+        {1, 2, 3, 4},
+        {5, 6, 7, 8},
+        {9, 0, 1, 2},
+        {3, 4, 5, 6},
+        {7, 8, 9, 0},
+    };
+    lda.fit(data);
+
+    CHECK(lda.score(data) <= 0); // log-likelihood is always non-positive
+}
+
+TEST_CASE("latent_dirichlet_allocation is consistent with sklearn")
+{
+    xt::xtensor<double, 2> const& data = sklearn_example_data;
+    xt::xtensor<double, 2> const& sklearn_topics = sklearn_example_topics;
+
+    // Document-topic dirichlets estimated by sklearn's LDA. The order of
+    // topics may not match ours because of randomness in the training
+    // algorithm.
     xt::xtensor<double, 2> const sklearn_docs = {
         {  0.1, 91.1,    0.1,  0.1,    0.1},
         { 12.3, 91.3,    0.1, 31.7,    0.1},
@@ -101,13 +110,16 @@ TEST_CASE("latent_dirichlet_allocation is consistent with sklearn")
         {  4.2,  0.1,    0.1, 87.0,    0.1},
     };
 
-    // Our estimate.
+    // Our estimate. Like the one of sklearn, it depends on the random
+    // initialization. Fits are deterministic for a seed, so a fixed seed
+    // whose initialization leads to the optimum found by sklearn is used.
 
     latent_dirichlet_allocation::config config;
     config.topic_count = 5;
     config.doc_topic_prior = 0.1;
     config.topic_word_prior = 0.1;
     config.convergence_threshold = 10.0;
+    config.seed = 9;
 
     latent_dirichlet_allocation lda{config};
     lda.fit(data);
@@ -210,6 +222,7 @@ TEST_CASE("latent_dirichlet_allocation provides config getter")
     config.topic_word_prior = 0.789;
     config.inner_iter_count = 123;
     config.outer_iter_count = 456;
+    config.restart_iter_count = 7;
     config.convergence_threshold = 0.789;
 
     latent_dirichlet_allocation lda{config};
@@ -219,5 +232,566 @@ TEST_CASE("latent_dirichlet_allocation provides config getter")
     CHECK(lda.get_config().topic_word_prior == config.topic_word_prior);
     CHECK(lda.get_config().inner_iter_count == config.inner_iter_count);
     CHECK(lda.get_config().outer_iter_count == config.outer_iter_count);
+    CHECK(lda.get_config().restart_iter_count == config.restart_iter_count);
     CHECK(lda.get_config().convergence_threshold == config.convergence_threshold);
 }
+
+TEST_CASE("latent_dirichlet_allocation gives the same result for sparse data")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+    sparse_matrix const sparse_data{data};
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+
+    latent_dirichlet_allocation dense_lda{config};
+    latent_dirichlet_allocation sparse_lda{config};
+
+    dense_lda.fit(data);
+    sparse_lda.fit(sparse_data);
+
+    double const topic_error = xt::amax(xt::abs(sparse_lda.topic_word_dirichlets()
+                                                - dense_lda.topic_word_dirichlets()))();
+    CHECK(topic_error < 1e-6);
+
+    xt::xtensor<double, 2> const dense_docs = dense_lda.transform(data);
+    xt::xtensor<double, 2> const sparse_docs = dense_lda.transform(sparse_data);
+
+    double const doc_error = xt::amax(xt::abs(sparse_docs - dense_docs))();
+    CHECK(doc_error < 1e-6);
+
+    double const dense_score = dense_lda.score(data);
+    double const sparse_score = dense_lda.score(sparse_data);
+
+    CHECK(sparse_score == Approx(dense_score));
+}
+
+TEST_CASE("latent_dirichlet_allocation reports the progress of fit")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+    config.outer_iter_count = 50;
+    config.convergence_threshold = 1e-3;
+
+    std::vector<fit_progress> progresses;
+    fit_observer observer;
+    observer.compute_elbo = true;
+    observer.callback = [&](fit_progress const& progress) {
+        progresses.push_back(progress);
+        return true;
+    };
+
+    latent_dirichlet_allocation observed_lda{config};
+    latent_dirichlet_allocation plain_lda{config};
+
+    SECTION("dense")
+    {
+        observed_lda.fit(data, observer);
+        plain_lda.fit(data);
+    }
+
+    SECTION("sparse")
+    {
+        observed_lda.fit(sparse_matrix{data}, observer);
+        plain_lda.fit(sparse_matrix{data});
+    }
+
+    // Observing does not change the result.
+    CHECK(xt::amax(xt::abs(observed_lda.topic_word_dirichlets() - plain_lda.topic_word_dirichlets()))() == 0);
+
+    REQUIRE(!progresses.empty());
+    for (std::size_t i = 0; i < progresses.size(); ++i) {
+        fit_progress const& progress = progresses[i];
+        CHECK(progress.iteration == static_cast<int>(i));
+        CHECK(progress.converged == (progress.max_delta <= config.convergence_threshold));
+        CHECK(progress.converged == (i + 1 == progresses.size()));
+        CHECK(progress.mean_inner_iterations >= 1);
+        CHECK(progress.mean_inner_iterations <= config.inner_iter_count);
+        CHECK(progress.estep_seconds >= 0);
+        CHECK(progress.mstep_seconds >= 0);
+        CHECK(progress.elbo <= 0);
+    }
+
+    // The bound improves as the topics are fitted.
+    CHECK(progresses.back().elbo > progresses.front().elbo);
+}
+
+TEST_CASE("latent_dirichlet_allocation warm-starts documents after restart_iter_count iterations")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+    config.outer_iter_count = 8;
+    config.convergence_threshold = 1e-6;
+
+    auto const inner_iterations = [&](int restart_iter_count) {
+        config.restart_iter_count = restart_iter_count;
+
+        std::vector<double> result;
+        fit_observer observer;
+        observer.callback = [&](fit_progress const& progress) {
+            result.push_back(progress.mean_inner_iterations);
+            return true;
+        };
+
+        latent_dirichlet_allocation lda{config};
+        lda.fit(data, observer);
+        return result;
+    };
+
+    std::vector<double> const warm = inner_iterations(4);
+    std::vector<double> const cold = inner_iterations(8);
+
+    // The iterations are the same until the restarts stop. After that,
+    // starting from the previous estimate needs fewer inner iterations.
+    REQUIRE(warm.size() == 8);
+    REQUIRE(cold.size() == 8);
+    for (std::size_t i = 0; i < 4; ++i) {
+        CHECK(warm[i] == cold[i]);
+    }
+    for (std::size_t i = 4; i < 8; ++i) {
+        CHECK(warm[i] < cold[i]);
+    }
+}
+
+TEST_CASE("latent_dirichlet_allocation stops fit when the observer asks")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    config.outer_iter_count = 100;
+    config.convergence_threshold = 1e-12;
+
+    int call_count = 0;
+    fit_observer observer;
+    observer.callback = [&](fit_progress const& progress) {
+        call_count++;
+        CHECK(progress.elbo != progress.elbo); // NaN unless requested
+        return progress.iteration < 2;
+    };
+
+    SECTION("variational")
+    {
+        latent_dirichlet_allocation lda{config};
+        lda.fit(data, observer);
+    }
+
+    SECTION("gibbs")
+    {
+        config.engine = lda_engine::gibbs;
+        latent_dirichlet_allocation lda{config};
+        lda.fit(data, observer);
+        CHECK(lda.topic_word_dirichlets().shape()[1] == 5);
+    }
+
+    CHECK(call_count == 3);
+}
+
+TEST_CASE("latent_dirichlet_allocation resumes fit from a saved state")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    config.outer_iter_count = 20;
+    config.inner_iter_count = 20;
+    config.convergence_threshold = 1e-12;
+
+    latent_dirichlet_allocation uninterrupted{config};
+    uninterrupted.fit(data);
+
+    fit_observer stopper;
+    stopper.callback = [](fit_progress const& progress) { return progress.iteration < 6; };
+
+    latent_dirichlet_allocation interrupted{config};
+    latent_dirichlet_allocation::fit_state state;
+    interrupted.fit(data, stopper, state);
+
+    REQUIRE(state.iteration_count == 7);
+    CHECK(state.doc_topic_dirichlets.shape()[0] == 4);
+
+    int first_iteration = -1;
+    fit_observer observer;
+    observer.callback = [&](fit_progress const& progress) {
+        if (first_iteration < 0) {
+            first_iteration = progress.iteration;
+        }
+        return true;
+    };
+
+    SECTION("exactly with the document-topic parameters")
+    {
+        latent_dirichlet_allocation resumed{config, interrupted.topic_word_dirichlets()};
+        resumed.fit(data, observer, state);
+
+        CHECK(first_iteration == 7);
+        CHECK(state.iteration_count == 20);
+        CHECK(xt::amax(xt::abs(resumed.topic_word_dirichlets() - uninterrupted.topic_word_dirichlets()))() == 0);
+    }
+
+    SECTION("approximately from the topics")
+    {
+        latent_dirichlet_allocation::fit_state topics_only_state;
+        topics_only_state.iteration_count = state.iteration_count;
+
+        latent_dirichlet_allocation resumed{config, interrupted.topic_word_dirichlets()};
+        resumed.fit(data, observer, topics_only_state);
+
+        CHECK(first_iteration == 7);
+        CHECK(xt::amax(xt::abs(resumed.topic_word_dirichlets() - uninterrupted.topic_word_dirichlets()))() < 0.1);
+    }
+
+    SECTION("not with mismatched data")
+    {
+        latent_dirichlet_allocation resumed{config, interrupted.topic_word_dirichlets()};
+        xt::xtensor<double, 2> const other_data = xt::view(data, xt::range(0, 3), xt::all());
+        CHECK_THROWS_AS(resumed.fit(other_data, observer, state), std::invalid_argument);
+    }
+}
+
+TEST_CASE("latent_dirichlet_allocation converges documents independently")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+    xt::xtensor<double, 2> const first_doc = xt::view(data, xt::range(0, 1), xt::all());
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+    config.convergence_threshold = 0.1;
+
+    latent_dirichlet_allocation lda{config};
+    lda.fit(data);
+
+    // The first document is randomly initialized in the same way in both
+    // cases. Its result must not depend on how long other documents take.
+    xt::xtensor<double, 2> const batch_docs = lda.transform(data);
+    xt::xtensor<double, 2> const single_doc = lda.transform(first_doc);
+    CHECK(xt::amax(xt::abs(xt::view(batch_docs, 0, xt::all()) - xt::view(single_doc, 0, xt::all())))() == 0);
+
+    xt::xtensor<double, 2> const sparse_batch_docs = lda.transform(sparse_matrix{data});
+    xt::xtensor<double, 2> const sparse_single_doc = lda.transform(sparse_matrix{first_doc});
+    CHECK(xt::amax(xt::abs(xt::view(sparse_batch_docs, 0, xt::all()) - xt::view(sparse_single_doc, 0, xt::all())))() == 0);
+}
+
+TEST_CASE("latent_dirichlet_allocation keeps the bound with per-document convergence")
+{
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 5;
+    config.doc_topic_prior = 0.1;
+    config.topic_word_prior = 0.1;
+    config.convergence_threshold = 1.0;
+    latent_dirichlet_allocation const lda{config, sklearn_example_topics};
+
+    config.convergence_threshold = 1e-6;
+    config.inner_iter_count = 10000;
+    latent_dirichlet_allocation const converged_lda{config, sklearn_example_topics};
+
+    // Documents stopped on their own convergence at a loose threshold reach
+    // nearly the bound of fully converged ones.
+    double const converged_score = converged_lda.document_score(sklearn_example_data);
+    CHECK(lda.document_score(sklearn_example_data) > 1.02 * converged_score);
+    CHECK(lda.document_score(sparse_matrix{sklearn_example_data}) > 1.02 * converged_score);
+}
+
+TEST_CASE("latent_dirichlet_allocation gives the same result with threads")
+{
+    xt::xtensor<double, 2> data = xt::zeros<double>({300, 6});
+    for (std::size_t doc = 0; doc < data.shape()[0]; ++doc) {
+        for (std::size_t word = 0; word < data.shape()[1]; ++word) {
+            data(doc, word) = static_cast<double>((doc * 7 + word * 3) % 5 + (doc % 3 == word % 3 ? 6 : 0));
+        }
+    }
+    sparse_matrix const sparse_data{data};
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+    config.outer_iter_count = 20;
+
+    latent_dirichlet_allocation::config threaded_config = config;
+    threaded_config.thread_count = 4;
+
+    latent_dirichlet_allocation lda{config};
+    latent_dirichlet_allocation threaded_lda{threaded_config};
+
+    lda.fit(sparse_data);
+    threaded_lda.fit(sparse_data);
+
+    double const topic_error = xt::amax(xt::abs(threaded_lda.topic_word_dirichlets()
+                                                - lda.topic_word_dirichlets()))();
+    CHECK(topic_error < 1e-6);
+
+    latent_dirichlet_allocation const threaded_model{
+        threaded_config, lda.topic_word_dirichlets(), lda.update_count()};
+
+    xt::xtensor<double, 2> const docs = lda.transform(data);
+    xt::xtensor<double, 2> const threaded_docs = threaded_model.transform(data);
+    CHECK(xt::amax(xt::abs(threaded_docs - docs))() < 1e-9);
+
+    xt::xtensor<double, 2> const sparse_docs = lda.transform(sparse_data);
+    xt::xtensor<double, 2> const threaded_sparse_docs = threaded_model.transform(sparse_data);
+    CHECK(xt::amax(xt::abs(threaded_sparse_docs - sparse_docs))() < 1e-9);
+}
+
+TEST_CASE("latent_dirichlet_allocation scores documents in batches")
+{
+    std::size_t const doc_count = 5000;
+    std::size_t const split = 3000;
+
+    xt::xtensor<double, 2> data = xt::zeros<double>({doc_count, std::size_t{6}});
+    for (std::size_t doc = 0; doc < doc_count; ++doc) {
+        for (std::size_t word = 0; word < data.shape()[1]; ++word) {
+            data(doc, word) = static_cast<double>((doc * 7 + word * 3) % 5 + (doc % 3 == word % 3 ? 6 : 0));
+        }
+    }
+    sparse_matrix const sparse_data{data};
+
+    xt::xtensor<double, 2> const topic_word_dirichlets = {
+        {5, 1, 1, 5, 1, 1},
+        {1, 5, 1, 1, 5, 1},
+        {1, 1, 5, 1, 1, 5},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.thread_count = 2;
+    latent_dirichlet_allocation const lda{config, topic_word_dirichlets};
+
+    double const score = lda.score(data);
+
+    double const split_score = lda.topic_score()
+                             + lda.document_score(xt::xtensor<double, 2>{xt::view(data, xt::range(0, split), xt::all())})
+                             + lda.document_score(xt::xtensor<double, 2>{xt::view(data, xt::range(split, doc_count), xt::all())});
+
+    double const sparse_score = lda.score(sparse_data);
+
+    CHECK(split_score == Approx(score).epsilon(1e-9));
+    CHECK(sparse_score == Approx(score).epsilon(1e-9));
+}
+
+TEST_CASE("latent_dirichlet_allocation works in single precision")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 1.0;
+    config.convergence_threshold = 1e-4;
+
+    xt::xtensor<double, 2> const topic_word_dirichlets = {
+        {9.1, 7.2, 0.3, 0.2, 0.1},
+        {0.2, 0.4, 8.3, 1.1, 2.1},
+        {1.3, 0.6, 0.2, 8.8, 3.2},
+    };
+
+    latent_dirichlet_allocation const lda{config, topic_word_dirichlets};
+    float_latent_dirichlet_allocation const float_lda{lda};
+    xt::xtensor<double, 2> const float_topics = float_lda.topic_word_dirichlets();
+    CHECK(xt::amax(xt::abs(float_topics - lda.topic_word_dirichlets()))() < 1e-4);
+
+    auto const normalize = [](xt::xtensor<double, 2> const& dirichlets) {
+        xt::xtensor<double, 2> proportions = dirichlets;
+        for (std::size_t doc = 0; doc < proportions.shape()[0]; ++doc) {
+            auto row = xt::view(proportions, doc, xt::all());
+            row /= xt::sum(row)();
+        }
+        return proportions;
+    };
+
+    xt::xtensor<double, 2> const docs = lda.transform(data);
+    xt::xtensor<double, 2> const float_docs = float_lda.transform(data);
+    xt::xtensor<double, 2> const float_sparse_docs = float_lda.transform(sparse_matrix{data});
+
+    CHECK(xt::amax(xt::abs(normalize(float_docs) - normalize(docs)))() < 1e-3);
+    CHECK(xt::amax(xt::abs(normalize(float_sparse_docs) - normalize(docs)))() < 1e-3);
+
+    double const score = lda.score(data);
+    double const float_score = float_lda.score(data);
+    CHECK(float_score == Approx(score).epsilon(1e-3));
+
+    // Both precisions draw the same initialization from the seed.
+    latent_dirichlet_allocation trained_lda{config};
+    trained_lda.fit(data);
+    float_latent_dirichlet_allocation trained_float_lda{config};
+    trained_float_lda.fit(data);
+    CHECK(trained_float_lda.score(data) == Approx(trained_lda.score(data)).epsilon(1e-3));
+}
+
+TEST_CASE("latent_dirichlet_allocation learns topics from minibatches")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1},
+        { 7, 5, 1, 0},
+        { 1, 0, 3, 0},
+        { 0, 1, 5, 1},
+        { 1, 0, 1, 2},
+        { 1, 1, 0, 7},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_word_preconditions = {
+        {1, 1, 0, 0},
+        {0, 0, 1, 0},
+        {0, 0, 0, 1},
+    };
+    config.topic_count = config.topic_word_preconditions.shape()[0];
+    config.topic_word_prior = 0.1;
+    config.doc_topic_prior = 0.1;
+    config.corpus_doc_count = data.shape()[0];
+
+    latent_dirichlet_allocation lda{config};
+
+    for (int epoch = 0; epoch < 50; ++epoch) {
+        lda.partial_fit(xt::xtensor<double, 2>{xt::view(data, xt::range(0, 3))});
+        lda.partial_fit(sparse_matrix{xt::view(data, xt::range(3, 6))});
+    }
+    CHECK(lda.update_count() == 100);
+
+    xt::xtensor<double, 2> const topics = lda.topic_word_dirichlets();
+
+    for (std::size_t topic_index = 0; topic_index < config.topic_count; ++topic_index) {
+        double const similarity = cosine_similarity(
+                xt::view(topics, topic_index),
+                xt::view(config.topic_word_preconditions, topic_index));
+        CHECK(similarity > 0.9);
+    }
+}
+
+TEST_CASE("latent_dirichlet_allocation updates a trained model incrementally")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1},
+        { 7, 5, 1, 0},
+    };
+
+    xt::xtensor<double, 2> const topic_word_dirichlets = {
+        { 19.271474,  14.334978,   1.291175,   1.419949},
+        {  2.089475,   1.882035,   1.262651,  11.051948},
+        {  1.638993,   1.78293 ,  10.446139,   1.528062},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = topic_word_dirichlets.shape()[0];
+    config.learning_offset = 1000;
+    latent_dirichlet_allocation lda{config, topic_word_dirichlets, 5};
+
+    lda.partial_fit(data);
+    CHECK(lda.update_count() == 6);
+
+    // The update weight is (1000 + 5)^-0.7, so the parameters barely move.
+    double const topic_error = xt::amax(xt::abs(lda.topic_word_dirichlets() - topic_word_dirichlets))();
+    CHECK(topic_error > 0);
+    CHECK(topic_error < 0.5);
+}
+
+TEST_CASE("latent_dirichlet_allocation draws random numbers from the seed")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1, 0},
+        { 7, 5, 1, 0, 0},
+        { 1, 0, 3, 0, 0},
+        { 0, 1, 5, 1, 2},
+        { 1, 0, 1, 2, 0},
+        { 1, 1, 0, 7, 3},
+    };
+    sparse_matrix const sparse_data{data};
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.seed = 1234;
+
+    latent_dirichlet_allocation lda{config};
+    lda.fit(data);
+
+    latent_dirichlet_allocation same_seed_lda{config};
+    same_seed_lda.fit(data);
+    CHECK(xt::amax(xt::abs(same_seed_lda.topic_word_dirichlets() - lda.topic_word_dirichlets()))() == 0);
+
+    config.seed = 5678;
+    latent_dirichlet_allocation other_seed_lda{config};
+    other_seed_lda.fit(data);
+    CHECK(xt::amax(xt::abs(other_seed_lda.topic_word_dirichlets() - lda.topic_word_dirichlets()))() > 0);
+
+    xt::xtensor<double, 2> const expected = lda.transform(sparse_data);
+
+    SECTION("independently of other documents in the batch")
+    {
+        xt::xtensor<double, 2> const tail = lda.transform(sparse_data.rows(2, 6));
+        xt::xtensor<double, 2> const expected_tail = xt::view(expected, xt::range(2, 6), xt::all());
+        CHECK(xt::amax(xt::abs(tail - expected_tail))() == 0);
+    }
+
+    SECTION("independently of threads")
+    {
+        std::vector<xt::xtensor<double, 2>> results(4);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&, i] { results[i] = lda.transform(sparse_data); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (xt::xtensor<double, 2> const& result : results) {
+            CHECK(xt::amax(xt::abs(result - expected))() == 0);
+        }
+    }
+}
@@ -1,14 +1,67 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
 #include <catch.hpp>
 #include <xtensor/xmath.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include "../lda/inference.hpp"
 #include "../lda/lda.hpp"
 #include "../lda/lda_io.hpp"
 
 
+namespace
+{
+    xt::xtensor<double, 2> const example_data = {
+        {10, 8, 0, 1},
+        { 7, 5, 1, 0},
+        { 1, 0, 3, 0},
+        { 0, 1, 5, 1},
+    };
+
+    latent_dirichlet_allocation train_example_model()
+    {
+        latent_dirichlet_allocation::config config;
+        config.topic_count = 3;
+        config.doc_topic_prior = 0.5;
+
+        latent_dirichlet_allocation lda{config};
+        lda.fit(example_data);
+        lda.partial_fit(example_data);
+        return lda;
+    }
+
+    // Writes content to a file and removes it on destruction.
+    class temporary_file
+    {
+      public:
+        temporary_file(std::string path, std::string const& content)
+            : path_{std::move(path)}
+        {
+            std::ofstream{path_, std::ios::binary} << content;
+        }
+
+        ~temporary_file()
+        {
+            std::remove(path_.c_str());
+        }
+
+        std::string const& path() const
+        {
+            return path_;
+        }
+
+      private:
+        std::string path_;
+    };
+}
+
+
 TEST_CASE("latent_dirichlet_allocation object can be saved and loaded")
 {
     xt::xtensor<double, 2> const data = {
@@ -27,10 +80,17 @@ TEST_CASE("latent_dirichlet_allocation object can be saved and loaded")
     config.topic_word_prior = 0.789;
     config.inner_iter_count = 12;
     config.outer_iter_count = 34;
+    config.restart_iter_count = 5;
     config.convergence_threshold = 0.567;
+    config.learning_offset = 2.5;
+    config.learning_decay = 0.75;
+    config.corpus_doc_count = 60;
+    config.engine = lda_engine::gibbs;
+    config.seed = 0xfedcba9876543210;
 
     latent_dirichlet_allocation lda{config};
     lda.fit(data);
+    lda.partial_fit(data);
 
     std::stringstream stream;
     save_lda(stream, lda);
@@ -41,9 +101,228 @@ TEST_CASE("latent_dirichlet_allocation object can be saved and loaded")
     CHECK(loaded_lda.get_config().topic_word_prior == Approx(config.topic_word_prior));
     CHECK(loaded_lda.get_config().inner_iter_count == config.inner_iter_count);
     CHECK(loaded_lda.get_config().outer_iter_count == config.outer_iter_count);
+    CHECK(loaded_lda.get_config().restart_iter_count == config.restart_iter_count);
     CHECK(loaded_lda.get_config().convergence_threshold == Approx(config.convergence_threshold));
+    CHECK(loaded_lda.get_config().learning_offset == Approx(config.learning_offset));
+    CHECK(loaded_lda.get_config().learning_decay == Approx(config.learning_decay));
+    CHECK(loaded_lda.get_config().corpus_doc_count == config.corpus_doc_count);
+    CHECK(loaded_lda.get_config().engine == config.engine);
+    CHECK(loaded_lda.get_config().seed == config.seed);
+    CHECK(loaded_lda.update_count() == lda.update_count());
 
     double const topic_error = xt::amax(xt::abs(loaded_lda.topic_word_dirichlets()
                                                      - lda.topic_word_dirichlets()))();
     CHECK(topic_error < 1e-6);
 }
+
+TEST_CASE("latent_dirichlet_allocation can be loaded in another precision")
+{
+    xt::xtensor<double, 2> const data = {
+        {10, 8, 0, 1},
+        { 7, 5, 1, 0},
+        { 1, 0, 3, 0},
+        { 0, 1, 5, 1},
+    };
+
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+
+    latent_dirichlet_allocation lda{config};
+    lda.fit(data);
+
+    std::stringstream double_stream;
+    save_lda(double_stream, lda);
+    float_latent_dirichlet_allocation const float_lda = load_lda<float>(double_stream);
+
+    CHECK(float_lda.get_config().topic_count == config.topic_count);
+    CHECK(float_lda.update_count() == lda.update_count());
+
+    xt::xtensor<double, 2> const float_topics = float_lda.topic_word_dirichlets();
+    CHECK(xt::amax(xt::abs(float_topics - lda.topic_word_dirichlets()))() < 1e-4);
+
+    std::stringstream float_stream;
+    save_lda(float_stream, float_lda);
+    latent_dirichlet_allocation const loaded_lda = load_lda(float_stream);
+
+    CHECK(xt::amax(xt::abs(loaded_lda.topic_word_dirichlets() - float_topics))() == 0);
+}
+
+TEST_CASE("latent_dirichlet_allocation can be saved in the binary format")
+{
+    latent_dirichlet_allocation const lda = train_example_model();
+
+    std::stringstream stream;
+    save_lda_binary(stream, lda);
+
+    CHECK(is_binary_lda(stream));
+    latent_dirichlet_allocation const loaded_lda = load_lda(stream);
+
+    CHECK(loaded_lda.get_config().topic_count == 3);
+    CHECK(loaded_lda.get_config().doc_topic_prior == 0.5);
+    CHECK(loaded_lda.update_count() == lda.update_count());
+    CHECK(xt::amax(xt::abs(loaded_lda.topic_word_dirichlets() - lda.topic_word_dirichlets()))() == 0);
+
+    std::stringstream float_stream;
+    save_lda_binary(float_stream, float_latent_dirichlet_allocation{lda});
+    latent_dirichlet_allocation const float_lda = load_lda(float_stream);
+
+    CHECK(xt::amax(xt::abs(float_lda.topic_word_dirichlets() - lda.topic_word_dirichlets()))() < 1e-4);
+
+    std::stringstream json_stream;
+    save_lda(json_stream, lda);
+    CHECK_FALSE(is_binary_lda(json_stream));
+
+    std::string const content = stream.str();
+    std::istringstream truncated_stream{content.substr(0, content.size() - 64)};
+    CHECK_THROWS_AS(load_lda(truncated_stream), std::runtime_error);
+
+    std::string corrupted = content;
+    corrupted[corrupted.size() - 100] ^= 1;
+    std::istringstream corrupted_stream{corrupted};
+    CHECK_THROWS_AS(load_lda(corrupted_stream), std::runtime_error);
+}
+
+TEST_CASE("binary format keeps topic_word_preconditions")
+{
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    config.topic_word_preconditions = {
+        {1.5, 0.0, 2.0, 0.25},
+        {0.0, 3.0, 0.5, 1.0},
+    };
+
+    latent_dirichlet_allocation lda{config};
+    lda.fit(example_data);
+
+    std::stringstream stream;
+    save_lda_binary(stream, lda);
+    std::string const content = stream.str();
+
+    // The array is stored in binary, not in the config text.
+    CHECK(content.find("topic_word_preconditions") == std::string::npos);
+
+    latent_dirichlet_allocation const loaded_lda = load_lda(stream);
+    bool const loaded = loaded_lda.get_config().topic_word_preconditions == config.topic_word_preconditions;
+    CHECK(loaded);
+
+    temporary_file const file{"test_preconditions_lda.bin", content};
+    mapped_lda const model{file.path()};
+    CHECK(model.get_config().topic_word_preconditions.size() == 0);
+    bool const mapped = model.to_model<float>().get_config().topic_word_preconditions
+                        == config.topic_word_preconditions;
+    CHECK(mapped);
+}
+
+TEST_CASE("training checkpoint can be saved and loaded")
+{
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 3;
+    config.doc_topic_prior = 0.5;
+    config.outer_iter_count = 3;
+    config.seed = 77;
+
+    latent_dirichlet_allocation lda{config};
+    latent_dirichlet_allocation::fit_state state;
+    lda.fit(example_data, fit_observer{}, state);
+
+    std::stringstream stream;
+    save_lda_checkpoint(stream, lda, state);
+    std::string const saved = stream.str();
+
+    SECTION("with the same bits")
+    {
+        basic_lda_checkpoint<double> const checkpoint = load_lda_checkpoint(stream);
+
+        CHECK(checkpoint.model.get_config().topic_count == 3);
+        CHECK(checkpoint.model.get_config().doc_topic_prior == 0.5);
+        CHECK(checkpoint.model.update_count() == 0);
+        CHECK(xt::amax(xt::abs(checkpoint.model.topic_word_dirichlets() - lda.topic_word_dirichlets()))() == 0);
+        CHECK(checkpoint.state.iteration_count == state.iteration_count);
+        CHECK(checkpoint.state.doc_topic_dirichlets.shape() == state.doc_topic_dirichlets.shape());
+        CHECK(xt::amax(xt::abs(checkpoint.state.doc_topic_dirichlets - state.doc_topic_dirichlets))() == 0);
+        CHECK(checkpoint.model.get_config().seed == 77);
+    }
+
+    SECTION("without the document-topic parameters")
+    {
+        float_latent_dirichlet_allocation const float_lda{lda};
+        basic_fit_state<float> topics_only_state;
+        topics_only_state.iteration_count = 2;
+
+        std::stringstream float_stream;
+        save_lda_checkpoint(float_stream, float_lda, topics_only_state);
+        basic_lda_checkpoint<float> const checkpoint = load_lda_checkpoint<float>(float_stream);
+
+        CHECK(checkpoint.state.iteration_count == 2);
+        CHECK(checkpoint.state.doc_topic_dirichlets.size() == 0);
+        CHECK(xt::amax(xt::abs(checkpoint.model.topic_word_dirichlets() - float_lda.topic_word_dirichlets()))() == 0);
+    }
+
+    SECTION("only in the saved precision")
+    {
+        CHECK_THROWS_AS(load_lda_checkpoint<float>(stream), std::runtime_error);
+    }
+
+    SECTION("not when corrupted")
+    {
+        std::string corrupted = saved;
+        corrupted[corrupted.size() - 3] ^= 1;
+        std::istringstream corrupted_stream{corrupted};
+        CHECK_THROWS_AS(load_lda_checkpoint(corrupted_stream), std::runtime_error);
+
+        std::istringstream truncated_stream{saved.substr(0, saved.size() - 8)};
+        CHECK_THROWS_AS(load_lda_checkpoint(truncated_stream), std::runtime_error);
+
+        std::stringstream model_stream;
+        save_lda_binary(model_stream, lda);
+        CHECK_THROWS_AS(load_lda_checkpoint(model_stream), std::runtime_error);
+    }
+}
+
+TEST_CASE("mapped_lda is used in place for inference")
+{
+    latent_dirichlet_allocation const lda = train_example_model();
+
+    std::stringstream stream;
+    save_lda_binary(stream, lda);
+    temporary_file const file{"test_mapped_lda.bin", stream.str()};
+
+    auto const model = std::make_shared<mapped_lda const>(file.path());
+
+    CHECK(model->topic_count() == 3);
+    CHECK(model->word_count() == 4);
+    CHECK(model->scalar_size() == sizeof(double));
+    CHECK(model->update_count() == lda.update_count());
+    CHECK(model->topic_word_dirichlets<double>()[5] == lda.topic_word_dirichlets()(1, 1));
+    CHECK_THROWS_AS(model->topic_word_dirichlets<float>(), std::logic_error);
+
+    lda_inference const inference{model};
+    lda_inference const expected_inference{lda};
+
+    xt::xtensor<double, 2> const docs = inference.transform(example_data);
+    xt::xtensor<double, 2> const expected = expected_inference.transform(example_data);
+    CHECK(xt::amax(xt::abs(docs - expected))() == 0);
+
+    float_lda_inference const float_inference{model};
+    xt::xtensor<float, 2> const float_docs = float_inference.transform(example_data);
+    CHECK(float_docs.shape()[0] == 4);
+}
+
+TEST_CASE("mapped_lda rejects corrupted files")
+{
+    std::stringstream stream;
+    save_lda_binary(stream, train_example_model());
+    std::string const content = stream.str();
+
+    std::string corrupted = content;
+    corrupted[corrupted.size() - 100] ^= 1;
+
+    temporary_file const corrupted_file{"test_corrupted_lda.bin", corrupted};
+    temporary_file const truncated_file{"test_truncated_lda.bin", content.substr(0, content.size() - 64)};
+    temporary_file const json_file{"test_json_lda.bin", "{}"};
+
+    CHECK_THROWS_AS(mapped_lda{corrupted_file.path()}, std::runtime_error);
+    CHECK_THROWS_AS(mapped_lda{truncated_file.path()}, std::runtime_error);
+    CHECK_THROWS_AS(mapped_lda{json_file.path()}, std::runtime_error);
+    CHECK_THROWS_AS(mapped_lda{"no_such_file.bin"}, std::runtime_error);
+}
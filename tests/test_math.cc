@@ -1,10 +1,14 @@
+#include <cmath>
 #include <cstddef>
+#include <string>
+#include <vector>
 
 #include <catch.hpp>
 #include <xtensor/xshape.hpp>
 #include <xtensor/xtensor.hpp>
 
 #include "../lda/math.hpp"
+#include "../lda/simd_math.hpp"
 
 
 TEST_CASE("log_beta reduces the last dimension")
@@ -90,3 +94,113 @@ TEST_CASE("digamma works with expression rvalues")
 
     CHECK(max_rel_error < 1e-6);
 }
+
+TEST_CASE("vectorized math kernels agree with the scalar implementation")
+{
+    std::vector<double> x;
+    for (double value = 1e-8; value < 1e6; value *= 1.37) {
+        x.push_back(value);
+    }
+    for (double value = 0.05; value < 20; value += 0.05) {
+        x.push_back(value);
+    }
+
+    std::vector<double> expected_digamma(x.size());
+    std::vector<double> expected_exp(x.size());
+    std::vector<double> expected_lgamma(x.size());
+
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        expected_digamma[i] = detail::digamma(x[i]);
+        expected_exp[i] = std::exp(-x[i] / 1000);
+        expected_lgamma[i] = std::lgamma(x[i]);
+    }
+
+    for (math_kernels const* kernels : supported_math_kernels()) {
+        INFO(kernels->instruction_set);
+
+        // All sizes up to a few batches to cover the tails.
+        for (std::size_t n = 0; n <= 9; ++n) {
+            std::vector<double> result(n);
+            kernels->float64.digamma(x.data(), n, result.data());
+            for (std::size_t i = 0; i < n; ++i) {
+                CHECK(result[i] == Approx(expected_digamma[i]).epsilon(1e-9));
+            }
+        }
+
+        std::vector<double> result(x.size());
+
+        kernels->float64.digamma(x.data(), x.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(expected_digamma[i]).epsilon(1e-8).margin(1e-8));
+        }
+
+        std::vector<double> scaled(x.size());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            scaled[i] = -x[i] / 1000;
+        }
+        kernels->float64.exp(scaled.data(), scaled.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(expected_exp[i]).epsilon(1e-14));
+        }
+
+        kernels->float64.lgamma(x.data(), x.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(expected_lgamma[i]).epsilon(1e-11).margin(1e-11));
+        }
+    }
+}
+
+TEST_CASE("vectorized math kernels work in place")
+{
+    math_kernels const& kernels = cpu_math_kernels();
+
+    std::vector<double> values = {0.5, 1, 2, 3, 4, 5, 6, 7};
+    kernels.float64.digamma(values.data(), values.size(), values.data());
+
+    CHECK(values[1] == Approx(-0.5772156649));
+    CHECK(values[2] == Approx(0.4227843351));
+}
+
+TEST_CASE("single precision math kernels are accurate")
+{
+    std::vector<float> x;
+    for (float value = 1e-4f; value < 1e5f; value *= 1.37f) {
+        x.push_back(value);
+    }
+    for (float value = 0.05f; value < 20; value += 0.05f) {
+        x.push_back(value);
+    }
+
+    for (math_kernels const* kernels : supported_math_kernels()) {
+        INFO(kernels->instruction_set);
+
+        std::vector<float> result(x.size());
+
+        kernels->float32.digamma(x.data(), x.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(detail::digamma(x[i])).epsilon(1e-5).margin(1e-5));
+        }
+
+        kernels->float32.lgamma(x.data(), x.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(std::lgamma(double{x[i]})).epsilon(1e-5).margin(1e-5));
+        }
+
+        std::vector<float> scaled(x.size());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            scaled[i] = -x[i] / 1000;
+        }
+        kernels->float32.exp(scaled.data(), scaled.size(), result.data());
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            CHECK(result[i] == Approx(std::exp(double{scaled[i]})).epsilon(1e-6));
+        }
+    }
+}
+
+TEST_CASE("scalar math kernels are always supported")
+{
+    auto const& kernels = supported_math_kernels();
+    REQUIRE_FALSE(kernels.empty());
+    CHECK(std::string{kernels.back()->instruction_set} == "scalar");
+    CHECK(&cpu_math_kernels() == kernels.front());
+}
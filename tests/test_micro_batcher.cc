@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "../lda/micro_batcher.hpp"
+
+
+TEST_CASE("micro_batcher returns the response of each request")
+{
+    micro_batcher<int, int> batcher{4, std::chrono::milliseconds{1}, [](std::vector<int>& requests) {
+        std::vector<int> responses;
+        for (int request : requests) {
+            responses.push_back(request * 2);
+        }
+        return responses;
+    }};
+
+    std::vector<std::future<int>> responses;
+    for (int i = 0; i < 10; ++i) {
+        responses.push_back(batcher.submit(i));
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        CHECK(responses[static_cast<std::size_t>(i)].get() == i * 2);
+    }
+
+    batcher_stats const stats = batcher.stats();
+    CHECK(stats.request_count == 10);
+    CHECK(stats.batch_count >= 3);
+    CHECK(stats.error_count == 0);
+    CHECK(stats.max_latency >= stats.p50_latency);
+    CHECK(stats.p99_latency <= stats.max_latency);
+}
+
+TEST_CASE("micro_batcher coalesces concurrent requests")
+{
+    std::vector<std::size_t> batch_sizes;
+
+    micro_batcher<int, int> batcher{8, std::chrono::seconds{10}, [&](std::vector<int>& requests) {
+        batch_sizes.push_back(requests.size());
+        return requests;
+    }};
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(8);
+
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i] {
+            results[static_cast<std::size_t>(i)] = batcher.submit(i).get();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // The long latency window closes only when the batch is full.
+    REQUIRE(batch_sizes.size() == 1);
+    CHECK(batch_sizes[0] == 8);
+    for (int i = 0; i < 8; ++i) {
+        CHECK(results[static_cast<std::size_t>(i)] == i);
+    }
+}
+
+TEST_CASE("micro_batcher processes a lone request after the latency window")
+{
+    micro_batcher<int, int> batcher{100, std::chrono::milliseconds{5}, [](std::vector<int>& requests) {
+        return requests;
+    }};
+
+    auto const start = std::chrono::steady_clock::now();
+    CHECK(batcher.submit(42).get() == 42);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{5});
+}
+
+TEST_CASE("micro_batcher passes errors to the requests of the batch")
+{
+    micro_batcher<int, int> batcher{2, std::chrono::seconds{10}, [](std::vector<int>& requests) -> std::vector<int> {
+        if (requests[0] < 0) {
+            throw std::runtime_error("negative");
+        }
+        return requests;
+    }};
+
+    auto first = batcher.submit(-1);
+    auto second = batcher.submit(1);
+    CHECK_THROWS_AS(first.get(), std::runtime_error);
+    CHECK_THROWS_AS(second.get(), std::runtime_error);
+
+    auto third = batcher.submit(3);
+    auto fourth = batcher.submit(4);
+    CHECK(third.get() == 3);
+    CHECK(fourth.get() == 4);
+    CHECK(batcher.stats().error_count == 2);
+}
+
+TEST_CASE("micro_batcher processes waiting requests on destruction")
+{
+    std::future<int> response;
+    {
+        micro_batcher<int, int> batcher{100, std::chrono::seconds{10}, [](std::vector<int>& requests) {
+            return requests;
+        }};
+        response = batcher.submit(7);
+    }
+    CHECK(response.get() == 7);
+}
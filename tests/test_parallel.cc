@@ -0,0 +1,121 @@
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "../lda/parallel.hpp"
+
+
+TEST_CASE("balanced_partition splits weights evenly")
+{
+    std::vector<std::size_t> const weights = {1, 1, 1, 1, 4, 1, 1, 1, 1};
+
+    std::vector<std::size_t> const bounds = balanced_partition(weights, 3);
+
+    REQUIRE(bounds.size() == 4);
+    CHECK(bounds[0] == 0);
+    CHECK(bounds[1] == 4);
+    CHECK(bounds[2] == 5);
+    CHECK(bounds[3] == 9);
+}
+
+TEST_CASE("balanced_partition allows empty parts")
+{
+    std::vector<std::size_t> const bounds = balanced_partition({1, 1}, 4);
+
+    REQUIRE(bounds.size() == 5);
+    CHECK(bounds.front() == 0);
+    CHECK(bounds.back() == 2);
+
+    for (std::size_t i = 1; i < bounds.size(); ++i) {
+        CHECK(bounds[i - 1] <= bounds[i]);
+    }
+}
+
+TEST_CASE("parallel_for processes every index exactly once")
+{
+    thread_pool pool{4};
+    REQUIRE(pool.size() == 4);
+
+    std::size_t const n = 1000;
+    std::vector<std::size_t> const bounds = balanced_partition(std::vector<std::size_t>(n, 1), pool.size());
+    std::vector<std::atomic<int>> visits(n);
+
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        parallel_for(pool, bounds, 7, [&](std::size_t begin, std::size_t end, std::size_t thread) {
+            CHECK(thread < pool.size());
+            for (std::size_t i = begin; i < end; ++i) {
+                visits[i]++;
+            }
+        });
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+        CHECK(visits[i] == 3);
+    }
+}
+
+TEST_CASE("thread_pool rethrows exceptions thrown in tasks")
+{
+    thread_pool pool{3};
+
+    CHECK_THROWS_AS(pool.run([](std::size_t thread) {
+        if (thread == 2) {
+            throw std::runtime_error("failure");
+        }
+    }), std::runtime_error);
+
+    // The pool is still usable.
+    std::atomic<std::size_t> count{0};
+    pool.run([&](std::size_t) { count++; });
+    CHECK(count == 3);
+}
+
+TEST_CASE("thread_pool rejects zero threads")
+{
+    CHECK_THROWS_AS(thread_pool{0}, std::invalid_argument);
+}
+
+TEST_CASE("bounded_queue passes values between threads in order")
+{
+    bounded_queue<int> queue{2};
+
+    std::thread producer{[&] {
+        for (int i = 0; i < 100; ++i) {
+            queue.push(i);
+        }
+        queue.close();
+    }};
+
+    std::vector<int> received;
+    for (int value; queue.pop(value); ) {
+        received.push_back(value);
+    }
+    producer.join();
+
+    REQUIRE(received.size() == 100);
+    for (std::size_t i = 0; i < received.size(); ++i) {
+        CHECK(received[i] == static_cast<int>(i));
+    }
+}
+
+TEST_CASE("bounded_queue rejects values after closing")
+{
+    bounded_queue<int> queue{1};
+    CHECK(queue.push(1));
+
+    // A producer waiting for room is released by close.
+    bool pushed = true;
+    std::thread producer{[&] { pushed = queue.push(2); }};
+    queue.close();
+    producer.join();
+    CHECK_FALSE(pushed);
+
+    int value = 0;
+    CHECK(queue.pop(value));
+    CHECK(value == 1);
+    CHECK_FALSE(queue.pop(value));
+}
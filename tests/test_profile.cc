@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <json.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/inference.hpp"
+#include "../lda/lda.hpp"
+#include "../lda/lda_io.hpp"
+#include "../lda/profile.hpp"
+#include "../lda/sparse_matrix.hpp"
+
+
+namespace
+{
+    // Returns the profiling report as JSON.
+    nlohmann::json profile_report()
+    {
+        std::stringstream output;
+        profiling::write_report(output);
+        return nlohmann::json::parse(output);
+    }
+
+    void profiled_section(std::size_t amount)
+    {
+        LDA_PROFILE_SCOPE("test.section");
+        LDA_PROFILE_COUNT("test.items", amount);
+    }
+
+    void another_profiled_section()
+    {
+        LDA_PROFILE_SCOPE("test.section");
+        LDA_PROFILE_COUNT("test.items", 100);
+    }
+}
+
+#ifdef LDA_PROFILE
+
+TEST_CASE("profiling sums timers and counters of the same name")
+{
+    profiling::reset();
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([] {
+            for (std::size_t j = 0; j < 10; ++j) {
+                profiled_section(j);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    another_profiled_section();
+
+    nlohmann::json const report = profile_report();
+
+    CHECK(report["enabled"] == true);
+    CHECK(report["timers"]["test.section"]["calls"] == 41);
+    CHECK(report["timers"]["test.section"]["seconds"] >= 0);
+    CHECK(report["counters"]["test.items"] == 4 * 45 + 100);
+
+    profiling::reset();
+
+    nlohmann::json const cleared = profile_report();
+
+    CHECK(cleared["timers"]["test.section"]["calls"] == 0);
+    CHECK(cleared["counters"]["test.items"] == 0);
+}
+
+TEST_CASE("profiling records the phases of latent_dirichlet_allocation")
+{
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    latent_dirichlet_allocation lda{config};
+
+    xt::xtensor<double, 2> const data = {
+        {1, 2, 0, 4},
+        {5, 0, 7, 8},
+        {9, 0, 1, 2},
+    };
+    lda.fit(data);
+
+    profiling::reset();
+    lda.transform(data);
+    lda.transform(sparse_matrix{data});
+
+    nlohmann::json const report = profile_report();
+
+    // The topic-word expectation is kept from fit, and sparse data goes
+    // through the inference table.
+    CHECK(report["timers"]["lda.topic_word_geoexp"]["calls"] == 0);
+    CHECK(report["timers"]["lda.estep"]["calls"] == 1);
+    CHECK(report["timers"]["lda.estep.gemm"]["calls"] >= 1);
+    CHECK(report["timers"]["inference.estep"]["calls"] == 1);
+    CHECK(report["counters"]["lda.estep.documents"] == 3);
+    CHECK(report["counters"]["lda.estep.tokens"] == 39);
+    CHECK(report["counters"]["lda.estep.inner_iterations"] >= 3);
+    CHECK(report["counters"]["inference.documents"] == 3);
+    CHECK(report["counters"]["inference.nonzeros"] == 9);
+}
+
+TEST_CASE("loading in another precision computes the topic-word expectation once")
+{
+    latent_dirichlet_allocation::config config;
+    config.topic_count = 2;
+    latent_dirichlet_allocation lda{config};
+
+    xt::xtensor<double, 2> const data = {
+        {1, 2, 0, 4},
+        {5, 0, 7, 8},
+        {9, 0, 1, 2},
+    };
+    lda.fit(data);
+
+    std::stringstream json_stream;
+    save_lda(json_stream, lda);
+    std::stringstream binary_stream;
+    save_lda_binary(binary_stream, lda);
+
+    char const* const path = "test_profile_lda.bin";
+    std::ofstream{path, std::ios::binary} << binary_stream.str();
+    auto const model = std::make_shared<mapped_lda const>(path);
+
+    profiling::reset();
+    float_latent_dirichlet_allocation const float_lda = load_lda<float>(json_stream);
+    float_lda_inference const inference{model};
+    std::remove(path);
+
+    // The model is built in single precision directly, and the inference
+    // table of a double model is computed without building a float model.
+    nlohmann::json const report = profile_report();
+    CHECK(report["timers"]["lda.topic_word_geoexp"]["calls"] == 1);
+}
+
+#else
+
+TEST_CASE("profiling reports nothing when compiled out")
+{
+    profiled_section(1);
+    another_profiled_section();
+
+    nlohmann::json const report = profile_report();
+
+    CHECK(report["enabled"] == false);
+    CHECK(report["timers"].empty());
+    CHECK(report["counters"].empty());
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdexcept>
+
+#include <catch.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/sparse_matrix.hpp"
+
+
+TEST_CASE("sparse_matrix stores nonzero elements of a dense matrix")
+{
+    xt::xtensor<double, 2> const dense = {
+        {0, 1, 0, 2},
+        {0, 0, 0, 0},
+        {3, 0, 4, 0},
+    };
+    sparse_matrix const matrix{dense};
+
+    CHECK(matrix.row_count() == 3);
+    CHECK(matrix.col_count() == 4);
+    CHECK(matrix.nonzero_count() == 4);
+
+    sparse_matrix::row_view const row0 = matrix.row(0);
+    REQUIRE(row0.size == 2);
+    CHECK(row0.indices[0] == 1);
+    CHECK(row0.indices[1] == 3);
+    CHECK(row0.values[0] == 1);
+    CHECK(row0.values[1] == 2);
+
+    CHECK(matrix.row(1).size == 0);
+
+    sparse_matrix::row_view const row2 = matrix.row(2);
+    REQUIRE(row2.size == 2);
+    CHECK(row2.indices[0] == 0);
+    CHECK(row2.indices[1] == 2);
+
+    CHECK((matrix.to_dense() == dense));
+}
+
+TEST_CASE("sparse_matrix can be created from CSR arrays")
+{
+    sparse_matrix const matrix{3, {0, 2, 3}, {0, 2, 1}, {5, 6, 7}};
+
+    xt::xtensor<double, 2> const expected = {
+        {5, 0, 6},
+        {0, 7, 0},
+    };
+    CHECK((matrix.to_dense() == expected));
+}
+
+TEST_CASE("sparse_matrix rejects inconsistent CSR arrays")
+{
+    CHECK_THROWS_AS((sparse_matrix{3, {}, {}, {}}), std::invalid_argument);
+    CHECK_THROWS_AS((sparse_matrix{3, {1, 2}, {0}, {1}}), std::invalid_argument);
+    CHECK_THROWS_AS((sparse_matrix{3, {0, 2}, {0}, {1}}), std::invalid_argument);
+    CHECK_THROWS_AS((sparse_matrix{3, {0, 1}, {3}, {1}}), std::invalid_argument);
+}
+
+TEST_CASE("sparse_matrix can copy a range of rows")
+{
+    xt::xtensor<double, 2> const dense = {
+        {0, 1, 0, 2},
+        {0, 0, 0, 0},
+        {3, 0, 4, 0},
+        {0, 5, 0, 0},
+    };
+    sparse_matrix const matrix{dense};
+
+    xt::xtensor<double, 2> const expected = {
+        {0, 0, 0, 0},
+        {3, 0, 4, 0},
+    };
+    sparse_matrix const rows = matrix.rows(1, 3);
+
+    CHECK(rows.row_count() == 2);
+    CHECK(rows.nonzero_count() == 2);
+    CHECK((rows.to_dense() == expected));
+
+    CHECK(matrix.rows(4, 4).row_count() == 0);
+    CHECK_THROWS_AS(matrix.rows(2, 5), std::out_of_range);
+}
@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <catch.hpp>
+#include <xtensor/xtensor.hpp>
+
+#include "../lda/sparse_matrix.hpp"
+#include "../lda/sparse_matrix_io.hpp"
+
+
+namespace
+{
+    // File removed on destruction.
+    class temporary_file
+    {
+      public:
+        temporary_file(std::string path, std::string const& content)
+            : path_{std::move(path)}
+        {
+            std::ofstream{path_, std::ios::binary} << content;
+        }
+
+        ~temporary_file()
+        {
+            std::remove(path_.c_str());
+        }
+
+        std::string const& path() const
+        {
+            return path_;
+        }
+
+      private:
+        std::string path_;
+    };
+
+    xt::xtensor<double, 2> const test_dense = {
+        {0, 1, 0, 2, 0},
+        {0, 0, 0, 0, 0},
+        {3, 0, 4, 0, 1},
+        {0, 0, 0, 9, 0},
+    };
+}
+
+
+TEST_CASE("sparse_matrix can be saved and loaded in the binary format")
+{
+    std::stringstream stream;
+    save_sparse_matrix(stream, sparse_matrix{test_dense});
+
+    CHECK(is_binary_sparse_matrix(stream));
+
+    sparse_matrix const loaded = load_sparse_matrix(stream);
+
+    CHECK(loaded.row_count() == 4);
+    CHECK(loaded.col_count() == 5);
+    CHECK(loaded.nonzero_count() == 6);
+    CHECK((loaded.to_dense() == test_dense));
+}
+
+TEST_CASE("sparse_matrix can be saved from a range of rows")
+{
+    sparse_matrix const matrix{test_dense};
+
+    std::stringstream stream;
+    save_sparse_matrix(stream, matrix.rows(2, 4));
+
+    sparse_matrix const loaded = load_sparse_matrix(stream);
+    xt::xtensor<double, 2> const expected = {
+        {3, 0, 4, 0, 1},
+        {0, 0, 0, 9, 0},
+    };
+
+    CHECK((loaded.to_dense() == expected));
+}
+
+TEST_CASE("binary sparse_matrix file can be mapped")
+{
+    std::ostringstream stream;
+    save_sparse_matrix(stream, sparse_matrix{test_dense});
+    temporary_file const file{"test_mapped_corpus.bin", stream.str()};
+
+    sparse_matrix const mapped = map_sparse_matrix(file.path());
+    CHECK((mapped.to_dense() == test_dense));
+
+    // Row ranges keep the mapping alive.
+    sparse_matrix const tail = map_sparse_matrix(file.path()).rows(3, 4);
+    REQUIRE(tail.row(0).size == 1);
+    CHECK(tail.row(0).indices[0] == 3);
+    CHECK(tail.row(0).values[0] == 9);
+}
+
+TEST_CASE("load_sparse_matrix rejects invalid files")
+{
+    std::ostringstream stream;
+    save_sparse_matrix(stream, sparse_matrix{test_dense});
+    std::string const content = stream.str();
+
+    SECTION("text file")
+    {
+        std::istringstream input{"0\t1\t2\n"};
+        CHECK_FALSE(is_binary_sparse_matrix(input));
+        CHECK_THROWS_AS(load_sparse_matrix(input), std::runtime_error);
+    }
+
+    SECTION("truncated file")
+    {
+        std::istringstream input{content.substr(0, content.size() - 64)};
+        CHECK_THROWS_AS(load_sparse_matrix(input), std::runtime_error);
+    }
+
+    SECTION("corrupted file")
+    {
+        std::string corrupted = content;
+        corrupted[corrupted.size() / 2] ^= 0x10;
+        std::istringstream input{corrupted};
+        CHECK_THROWS_AS(load_sparse_matrix(input), std::runtime_error);
+    }
+}
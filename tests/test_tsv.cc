@@ -1,13 +1,31 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <catch.hpp>
 #include <xtensor/xshape.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include "../lda/parallel.hpp"
 #include "../tsv/tsv.hpp"
 
 
+namespace
+{
+    // Returns the text written by format_number.
+    template<typename T>
+    std::string format(T value, int precision)
+    {
+        char buffer[max_formatted_size];
+        char const* const end = format_number(buffer, value, precision);
+        return std::string(buffer, static_cast<std::size_t>(end - buffer));
+    }
+}
+
+
 TEST_CASE("load_tsv loads a 5-by-3 tensor")
 {
     std::istringstream stream{
@@ -52,3 +70,213 @@ TEST_CASE("save_tsv saves a 5-by-3 tensor")
 
     CHECK(stream.str() == expected);
 }
+
+TEST_CASE("load_tsv loads a tensor in chunks")
+{
+    std::istringstream stream{
+        "0\t1\n"
+        "2\t3\n"
+        "4\t5\n"
+    };
+
+    xt::xtensor<double, 2> const first = load_tsv(stream, 2);
+    xt::xtensor<double, 2> const second = load_tsv(stream, 2);
+    xt::xtensor<double, 2> const third = load_tsv(stream, 2);
+
+    xt::xtensor<double, 2> const expected_first = {
+        {0, 1},
+        {2, 3},
+    };
+    xt::xtensor<double, 2> const expected_second = {
+        {4, 5},
+    };
+
+    CHECK((first == expected_first));
+    CHECK((second == expected_second));
+    CHECK(third.shape()[0] == 0);
+}
+
+TEST_CASE("load_tsv returns a tensor with accessible elements")
+{
+    std::istringstream stream{
+        "0\t1\t2\n"
+        "3\t4\t5\n"
+    };
+
+    tsv_tensor const tensor = load_tsv(stream);
+
+    CHECK(tensor(0, 1) == 1);
+    CHECK(tensor(1, 0) == 3);
+    CHECK(tensor(1, 2) == 5);
+}
+
+TEST_CASE("load_tsv parses numbers exactly like strtod")
+{
+    std::vector<std::string> const numbers = {
+        "0", "-0", "+7", "0.1", "3.14159", "1e-5", "-2.5E3", "1e22", "1e23",
+        "0.000000000000000000000000123", "123456789012345678901", "9007199254740993",
+        "4.9e-324", "1.7976931348623157e308", ".5", "5.",
+    };
+
+    std::string text;
+    for (std::string const& number : numbers) {
+        text += number + "\n";
+    }
+    std::istringstream stream{text};
+
+    tsv_tensor const tensor = load_tsv(stream);
+
+    REQUIRE(tensor.shape()[0] == numbers.size());
+    for (std::size_t i = 0; i < numbers.size(); ++i) {
+        CHECK(tensor(i, 0) == std::strtod(numbers[i].c_str(), nullptr));
+    }
+}
+
+TEST_CASE("load_tsv accepts CRLF line endings")
+{
+    std::istringstream stream{"1\t2\r\n3\t4\r\n"};
+
+    xt::xtensor<double, 2> const tensor = load_tsv(stream);
+    xt::xtensor<double, 2> const expected = {
+        {1, 2},
+        {3, 4},
+    };
+
+    CHECK((tensor == expected));
+}
+
+TEST_CASE("load_tsv reports malformed rows with line numbers")
+{
+    SECTION("ragged row")
+    {
+        std::istringstream stream{"1\t2\n3\t4\n5\n"};
+
+        try {
+            load_tsv(stream);
+            FAIL("no exception thrown");
+        } catch (tsv_error const& e) {
+            CHECK(e.line() == 3);
+        }
+    }
+
+    SECTION("invalid number")
+    {
+        std::istringstream stream{"1\t2\n3\tx\n"};
+
+        try {
+            load_tsv(stream);
+            FAIL("no exception thrown");
+        } catch (tsv_error const& e) {
+            CHECK(e.line() == 2);
+        }
+    }
+}
+
+TEST_CASE("tsv_reader reads a stream in chunks")
+{
+    std::istringstream stream{
+        "0\t1\n"
+        "2\t3\n"
+        "4\t5\n"
+        "6\n"
+    };
+    tsv_reader reader{stream};
+
+    xt::xtensor<double, 2> const first = reader.read(2);
+    xt::xtensor<double, 2> const expected_first = {
+        {0, 1},
+        {2, 3},
+    };
+    CHECK((first == expected_first));
+    CHECK(reader.line_count() == 2);
+
+    xt::xtensor<double, 2> const second = reader.read(1);
+    xt::xtensor<double, 2> const expected_second = {
+        {4, 5},
+    };
+    CHECK((second == expected_second));
+
+    // Rows are checked for consistency within a chunk, and line numbers
+    // count from the beginning of the stream.
+    xt::xtensor<double, 2> const third = reader.read(1);
+    CHECK(third.shape()[0] == 1);
+    CHECK(third.shape()[1] == 1);
+
+    CHECK(reader.read(1).shape()[0] == 0);
+    CHECK(reader.line_count() == 4);
+}
+
+TEST_CASE("parse_tsv gives the same result on multiple threads")
+{
+    std::string text;
+    for (std::size_t row = 0; row < 20000; ++row) {
+        for (std::size_t col = 0; col < 10; ++col) {
+            text += std::to_string((row * 31 + col * 7) % 13) + (col == 9 ? "\n" : "\t");
+        }
+    }
+
+    thread_pool single{1};
+    thread_pool multiple{4};
+
+    tsv_tensor const expected = parse_tsv(text.data(), text.data() + text.size(), single);
+    tsv_tensor const actual = parse_tsv(text.data(), text.data() + text.size(), multiple);
+
+    REQUIRE(actual.shape()[0] == 20000);
+    CHECK((actual == expected));
+    CHECK(actual(12345, 6) == static_cast<double>((12345 * 31 + 6 * 7) % 13));
+
+    // The error at the earliest line is reported.
+    text.replace(text.size() / 4 * 3, 1, "x");
+    text.replace(text.size() / 4, 1, "y");
+
+    try {
+        parse_tsv(text.data(), text.data() + text.size(), multiple);
+        FAIL("no exception thrown");
+    } catch (tsv_error const& e) {
+        CHECK(e.line() < 20000 / 2);
+    }
+}
+
+TEST_CASE("format_number formats like printf")
+{
+    std::vector<double> const values = {
+        0, -0.0, 1, 0.5, 2.5, 1e-5, 123456, 1234567, 0.1, 1.0 / 3, -12.937123456789,
+        1e22, 1e300, 5e-324, 9.9999996, 0.000123456789,
+    };
+
+    for (double const value : values) {
+        for (int const precision : {1, 3, 6, 15, 17}) {
+            char expected[64];
+            std::snprintf(expected, sizeof expected, "%.*g", precision, value);
+
+            CHECK(format(value, precision) == expected);
+        }
+    }
+}
+
+TEST_CASE("format_number writes the shortest digits that read back")
+{
+    CHECK(format(0.1, 0) == "0.1");
+    CHECK(format(1.0 / 3, 0) == "0.3333333333333333");
+    CHECK(format(1e-7, 0) == "1e-07");
+    CHECK(format(0.1f, 0) == "0.1");
+
+    for (double const value : {1.0 / 7, 2.0 / 3e20, 123.456e100, 4.9e-324}) {
+        CHECK(std::strtod(format(value, 0).c_str(), nullptr) == value);
+    }
+}
+
+TEST_CASE("save_tsv writes numbers with given precision")
+{
+    xt::xtensor<double, 2> const tensor = {
+        {1.0 / 3, 2},
+    };
+
+    std::ostringstream short_stream;
+    save_tsv(short_stream, tensor, 2);
+    CHECK(short_stream.str() == "0.33\t2\n");
+
+    std::ostringstream exact_stream;
+    save_tsv(exact_stream, tensor, 0);
+    CHECK(exact_stream.str() == "0.3333333333333333\t2\n");
+}
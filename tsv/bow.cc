@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../lda/profile.hpp"
+#include "../lda/sparse_matrix.hpp"
+#include "bow.hpp"
+#include "tsv.hpp"
+
+
+namespace
+{
+    bool is_delim(char ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r';
+    }
+
+    // Returns the next token of [p, end) delimited by spaces or tabs, and
+    // advances p past it. The token is empty at the end of the line.
+    std::pair<char const*, char const*> next_token(char const*& p, char const* end)
+    {
+        char const* const token_begin = std::find_if_not(p, end, is_delim);
+        char const* const token_end = std::find_if(token_begin, end, is_delim);
+        p = token_end;
+        return {token_begin, token_end};
+    }
+
+    // Parses a decimal integer in [begin, end). Returns false if the text is
+    // not entirely an integer or the integer does not fit in size_t.
+    bool parse_integer(char const* begin, char const* end, std::size_t& value)
+    {
+        std::size_t const max = std::numeric_limits<std::size_t>::max();
+        value = 0;
+
+        if (begin == end) {
+            return false;
+        }
+
+        for (char const* p = begin; p != end; ++p) {
+            if (*p < '0' || *p > '9') {
+                return false;
+            }
+            auto const digit = static_cast<std::size_t>(*p - '0');
+            if (value > (max - digit) / 10) {
+                return false;
+            }
+            value = value * 10 + digit;
+        }
+
+        return true;
+    }
+
+    // CSR arrays being built.
+    struct csr_builder
+    {
+        std::vector<sparse_matrix::offset_type> row_offsets = {0};
+        std::vector<sparse_matrix::index_type> col_indices;
+        std::vector<double> values;
+
+        void add(std::size_t col, double value)
+        {
+            col_indices.push_back(static_cast<sparse_matrix::index_type>(col));
+            values.push_back(value);
+        }
+
+        void end_row()
+        {
+            row_offsets.push_back(values.size());
+        }
+
+        std::size_t row_count() const
+        {
+            return row_offsets.size() - 1;
+        }
+
+        sparse_matrix build(std::size_t col_count)
+        {
+            return sparse_matrix{col_count, std::move(row_offsets), std::move(col_indices), std::move(values)};
+        }
+    };
+
+    // Reads a header line of the docword format holding a single integer.
+    std::size_t read_header_value(std::istream& input, std::string& line, std::size_t& line_number)
+    {
+        line_number++;
+        if (!std::getline(input, line)) {
+            throw tsv_error("docword header is truncated", line_number);
+        }
+
+        char const* p = line.data();
+        char const* const end = p + line.size();
+        auto const token = next_token(p, end);
+
+        std::size_t value;
+        if (!parse_integer(token.first, token.second, value) || next_token(p, end).first != end) {
+            throw tsv_error("invalid docword header", line_number);
+        }
+        return value;
+    }
+}
+
+uci_docword_reader::uci_docword_reader(std::istream& input)
+    : input_{input}
+{
+    document_count_ = read_header_value(input_, line_, line_number_);
+    word_count_ = read_header_value(input_, line_, line_number_);
+    read_header_value(input_, line_, line_number_);
+
+    if (word_count_ > std::numeric_limits<sparse_matrix::index_type>::max()) {
+        throw tsv_error("vocabulary is too large", 2);
+    }
+}
+
+std::size_t uci_docword_reader::document_count() const
+{
+    return document_count_;
+}
+
+std::size_t uci_docword_reader::word_count() const
+{
+    return word_count_;
+}
+
+sparse_matrix uci_docword_reader::read(std::size_t max_rows)
+{
+    LDA_PROFILE_SCOPE("bow.read_uci");
+
+    std::size_t const end_doc = next_doc_ + std::min(max_rows, document_count_ - next_doc_);
+    csr_builder result;
+
+    while (next_doc_ < end_doc) {
+        if (!has_pending_ && !read_entry()) {
+            // Trailing documents without counts.
+            for (; next_doc_ < end_doc; ++next_doc_) {
+                result.end_row();
+            }
+            break;
+        }
+
+        if (pending_doc_ != next_doc_) {
+            result.end_row();
+            next_doc_++;
+            continue;
+        }
+
+        result.add(pending_word_, pending_count_);
+        has_pending_ = false;
+    }
+
+    LDA_PROFILE_COUNT("bow.rows_parsed", result.row_count());
+    return result.build(word_count_);
+}
+
+sparse_matrix uci_docword_reader::read_all()
+{
+    return read(std::numeric_limits<std::size_t>::max());
+}
+
+bool uci_docword_reader::read_entry()
+{
+    for (;;) {
+        line_number_++;
+        if (!std::getline(input_, line_)) {
+            return false;
+        }
+
+        char const* p = line_.data();
+        char const* const end = p + line_.size();
+        auto const doc_token = next_token(p, end);
+
+        if (doc_token.first == end) {
+            continue;
+        }
+
+        auto const word_token = next_token(p, end);
+        auto const count_token = next_token(p, end);
+
+        std::size_t doc;
+        std::size_t word;
+        if (!parse_integer(doc_token.first, doc_token.second, doc)
+            || !parse_integer(word_token.first, word_token.second, word)
+            || !parse_tsv_number(count_token.first, count_token.second, pending_count_)
+            || next_token(p, end).first != end) {
+            throw tsv_error("expected 'docID wordID count'", line_number_);
+        }
+
+        if (doc == 0 || doc > document_count_ || word == 0 || word > word_count_) {
+            throw tsv_error("ID out of range", line_number_);
+        }
+
+        if (doc - 1 < next_doc_) {
+            throw tsv_error("lines are not sorted by docID", line_number_);
+        }
+
+        pending_doc_ = doc - 1;
+        pending_word_ = word - 1;
+        has_pending_ = true;
+        return true;
+    }
+}
+
+libsvm_reader::libsvm_reader(std::istream& input, std::size_t index_base, std::size_t col_count)
+    : input_{input}
+    , index_base_{index_base}
+    , col_count_{col_count}
+{
+}
+
+sparse_matrix libsvm_reader::read(std::size_t max_rows)
+{
+    LDA_PROFILE_SCOPE("bow.read_libsvm");
+
+    csr_builder result;
+
+    while (result.row_count() < max_rows && std::getline(input_, line_)) {
+        line_number_++;
+
+        char const* p = line_.data();
+        char const* const end = std::find(p, p + line_.size(), '#');
+        bool first = true;
+
+        for (auto token = next_token(p, end); token.first != end; token = next_token(p, end), first = false) {
+            char const* const colon = std::find(token.first, token.second, ':');
+
+            if (colon == token.second) {
+                if (!first) {
+                    throw tsv_error("expected 'index:count'", line_number_);
+                }
+                continue;
+            }
+
+            // Query IDs of the SVMlight ranking format are not features.
+            if (colon - token.first == 3 && std::equal(token.first, colon, "qid")) {
+                continue;
+            }
+
+            std::size_t index;
+            double count;
+            if (!parse_integer(token.first, colon, index)
+                || !parse_tsv_number(colon + 1, token.second, count)) {
+                throw tsv_error("expected 'index:count'", line_number_);
+            }
+
+            if (index < index_base_ || index - index_base_ >= std::numeric_limits<sparse_matrix::index_type>::max()) {
+                throw tsv_error("index out of range", line_number_);
+            }
+
+            std::size_t const col = index - index_base_;
+            col_count_ = std::max(col_count_, col + 1);
+            result.add(col, count);
+        }
+
+        result.end_row();
+    }
+
+    LDA_PROFILE_COUNT("bow.rows_parsed", result.row_count());
+    return result.build(col_count_);
+}
+
+sparse_matrix libsvm_reader::read_all()
+{
+    return read(std::numeric_limits<std::size_t>::max());
+}
@@ -0,0 +1,90 @@
+#ifndef INCLUDED_BOW_HPP
+#define INCLUDED_BOW_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+#include "../lda/sparse_matrix.hpp"
+
+
+// Reader of the UCI bag-of-words docword format[1]. The format starts with
+// three lines holding the document count D, the vocabulary size W and the
+// number of nonzero counts, followed by a "docID wordID count" line for
+// each nonzero count. IDs start from one and the lines are sorted by docID.
+// The stream is read line by line, so only the sparse result is kept in
+// memory.
+//
+// [1]: https://archive.ics.uci.edu/ml/datasets/Bag+of+Words
+class uci_docword_reader
+{
+  public:
+    // Reads the header. Throws tsv_error if it is malformed.
+    explicit uci_docword_reader(std::istream& input);
+
+    // Returns the document count D in the header.
+    std::size_t document_count() const;
+
+    // Returns the vocabulary size W in the header.
+    std::size_t word_count() const;
+
+    // Reads the next max_rows documents as a matrix with word_count()
+    // columns. Documents without counts are empty rows. Returns an empty
+    // matrix after the last document. Throws tsv_error if a line is
+    // malformed, out of range or out of order.
+    sparse_matrix read(std::size_t max_rows);
+
+    // Reads all the remaining documents.
+    sparse_matrix read_all();
+
+  private:
+    // Reads the next count line into pending_. Returns false at the end.
+    bool read_entry();
+
+  private:
+    std::istream& input_;
+    std::string line_;
+    std::size_t line_number_ = 0;
+    std::size_t document_count_ = 0;
+    std::size_t word_count_ = 0;
+
+    // Index of the next document returned by read.
+    std::size_t next_doc_ = 0;
+
+    // Count line read ahead of the documents returned so far.
+    bool has_pending_ = false;
+    std::size_t pending_doc_ = 0;
+    std::size_t pending_word_ = 0;
+    double pending_count_ = 0;
+};
+
+// Reader of the LibSVM (SVMlight) format. Each line is a document of
+// "index:count" pairs, optionally preceded by a label, which is ignored.
+// Text after '#' is a comment. The stream is read line by line, so only the
+// sparse result is kept in memory.
+class libsvm_reader
+{
+  public:
+    // Creates a reader of indices starting from index_base, which is 1 in
+    // the original format and 0 in some exporters. The matrices returned
+    // have at least col_count columns; the format does not record the
+    // vocabulary size, so it is otherwise one past the largest index seen.
+    libsvm_reader(std::istream& input, std::size_t index_base = 1, std::size_t col_count = 0);
+
+    // Reads the next max_rows documents. Returns an empty matrix at the end
+    // of the input. Throws tsv_error if a line is malformed.
+    sparse_matrix read(std::size_t max_rows);
+
+    // Reads all the remaining documents.
+    sparse_matrix read_all();
+
+  private:
+    std::istream& input_;
+    std::string line_;
+    std::size_t line_number_ = 0;
+    std::size_t index_base_;
+    std::size_t col_count_;
+};
+
+
+#endif
@@ -1,60 +1,749 @@
 #include <algorithm>
-#include <cctype>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 #include <istream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <ostream>
-#include <iterator>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include <locale.h>
+#include <stdlib.h>
+
+#include <json.hpp>
+#include <xtensor/xstrides.hpp>
 #include <xtensor/xtensor.hpp>
 
+#include "../lda/parallel.hpp"
+#include "../lda/profile.hpp"
 #include "tsv.hpp"
 
 
-template<typename OutputIterator>
-std::size_t parse_tsv_row(std::string const& row, OutputIterator output)
+namespace
 {
-    std::size_t item_count = 0;
+    // Text shorter than this per thread is parsed on a single thread.
+    constexpr std::size_t min_bytes_per_thread = std::size_t{1} << 16;
+
+    // Size of the blocks tsv_reader reads from the stream.
+    constexpr std::size_t read_block_size = std::size_t{1} << 20;
+
+    // Powers of ten that are exactly representable in double.
+    constexpr double exact_powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    bool is_delim(char ch)
+    {
+        return ch == ' ' || ch == '\t';
+    }
+
+    bool is_digit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+
+    // Returns the "C" locale, which is created once and never freed.
+    locale_t c_locale()
+    {
+        static locale_t const locale = ::newlocale(LC_ALL_MASK, "C", locale_t{});
+        return locale;
+    }
+
+    // Parses a number in [begin, end) with strtod in the "C" locale. Returns
+    // false if the text is not entirely a number.
+    bool parse_number_slow(char const* begin, char const* end, double& value)
+    {
+        auto const size = static_cast<std::size_t>(end - begin);
+        char small[64];
+        std::string large;
+        char const* text = small;
+
+        if (size < sizeof small) {
+            std::memcpy(small, begin, size);
+            small[size] = '\0';
+        } else {
+            large.assign(begin, end);
+            text = large.c_str();
+        }
+
+        char* parsed_end = nullptr;
+        value = ::strtod_l(text, &parsed_end, c_locale());
+        return size != 0 && parsed_end == text + size;
+    }
+
+    // Parses a number in [begin, end). Returns false if the text is not
+    // entirely a number. Decimal numbers with at most 19 significant digits
+    // whose value is m * 10^e with m <= 2^53 and |e| <= 22 are computed by a
+    // single correctly rounded multiplication or division (Clinger's fast
+    // path), which covers the counts and proportions in typical inputs. The
+    // others are left to strtod.
+    bool parse_number(char const* begin, char const* end, double& value)
+    {
+        char const* p = begin;
+        bool const negative = p != end && *p == '-';
+
+        if (p != end && (*p == '-' || *p == '+')) {
+            ++p;
+        }
+
+        std::uint64_t mantissa = 0;
+        int significant_digits = 0;
+        int exponent = 0;
+        bool has_digits = false;
+
+        // Returns false if the digit does not fit in the mantissa.
+        auto const take_digit = [&](char ch) {
+            if (significant_digits == 19) {
+                return false;
+            }
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(ch - '0');
+            if (mantissa != 0) {
+                significant_digits++;
+            }
+            has_digits = true;
+            return true;
+        };
+
+        for (; p != end && is_digit(*p); ++p) {
+            if (!take_digit(*p)) {
+                return parse_number_slow(begin, end, value);
+            }
+        }
+
+        if (p != end && *p == '.') {
+            for (++p; p != end && is_digit(*p); ++p) {
+                if (!take_digit(*p)) {
+                    return parse_number_slow(begin, end, value);
+                }
+                exponent--;
+            }
+        }
+
+        if (has_digits && p != end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool const negative_exponent = p != end && *p == '-';
+
+            if (p != end && (*p == '-' || *p == '+')) {
+                ++p;
+            }
+            if (p == end || !is_digit(*p)) {
+                return false;
+            }
+
+            int exponent_value = 0;
+            for (; p != end && is_digit(*p); ++p) {
+                if (exponent_value > 1000) {
+                    return parse_number_slow(begin, end, value);
+                }
+                exponent_value = exponent_value * 10 + (*p - '0');
+            }
+            exponent += negative_exponent ? -exponent_value : exponent_value;
+        }
 
-    auto const is_delim = [](char ch) {
-        return std::isblank(ch);
+        if (!has_digits || p != end) {
+            return parse_number_slow(begin, end, value);
+        }
+
+        if (mantissa > (std::uint64_t{1} << 53) || exponent < -22 || exponent > 22) {
+            return parse_number_slow(begin, end, value);
+        }
+
+        value = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            value /= exact_powers_of_ten[-exponent];
+        } else {
+            value *= exact_powers_of_ten[exponent];
+        }
+        if (negative) {
+            value = -value;
+        }
+
+        return true;
+    }
+
+    // Returns the end of the line starting at begin, excluding '\n' and a
+    // preceding '\r'.
+    char const* line_content_end(char const* begin, char const* end)
+    {
+        auto const newline = static_cast<char const*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+        char const* content_end = newline ? newline : end;
+
+        if (content_end != begin && content_end[-1] == '\r') {
+            content_end--;
+        }
+        return content_end;
+    }
+
+    // Counts the columns of the line [begin, end).
+    std::size_t count_columns(char const* begin, char const* end)
+    {
+        std::size_t count = 0;
+        char const* token_begin = std::find_if_not(begin, end, is_delim);
+
+        while (token_begin != end) {
+            count++;
+            token_begin = std::find_if_not(std::find_if(token_begin, end, is_delim), end, is_delim);
+        }
+        return count;
+    }
+
+    // Parses the line [begin, end) into output, which has room for col_count
+    // numbers. Throws tsv_error if the line does not have col_count columns.
+    void parse_row(char const* begin, char const* end, double* output, std::size_t col_count, std::size_t line)
+    {
+        std::size_t count = 0;
+        char const* token_begin = std::find_if_not(begin, end, is_delim);
+
+        while (token_begin != end) {
+            char const* const token_end = std::find_if(token_begin, end, is_delim);
+
+            if (count < col_count && !parse_number(token_begin, token_end, output[count])) {
+                throw tsv_error("invalid number '" + std::string{token_begin, token_end} + "'", line);
+            }
+            count++;
+            token_begin = std::find_if_not(token_end, end, is_delim);
+        }
+
+        if (count != col_count) {
+            throw tsv_error("expected " + std::to_string(col_count) + " columns but found "
+                            + std::to_string(count), line);
+        }
+    }
+
+    // Size of the buffer of tsv_writer.
+    constexpr std::size_t writer_buffer_size = std::size_t{1} << 16;
+
+    // Powers of ten as integers.
+    constexpr std::uint64_t integer_powers_of_ten[] = {
+        1,
+        10,
+        100,
+        1000,
+        10000,
+        100000,
+        1000000,
+        10000000,
+        100000000,
+        1000000000,
+        10000000000,
+        100000000000,
+        1000000000000,
+        10000000000000,
+        100000000000000,
+        1000000000000000,
+        10000000000000000,
+        100000000000000000,
     };
-    auto token_begin = std::find_if_not(row.begin(), row.end(), is_delim);
 
-    while (token_begin != row.end()) {
-        auto const token_end = std::find_if(token_begin, row.end(), is_delim);
-        *output++ = std::stod(std::string{token_begin, token_end});
-        item_count++;
-        token_begin = std::find_if_not(token_end, row.end(), is_delim);
+    // Formats infinities and NaNs like printf.
+    char* format_special(char* output, double value)
+    {
+        char const* const text = std::isnan(value) ? "nan" : value < 0 ? "-inf" : "inf";
+        std::size_t const size = std::strlen(text);
+        std::memcpy(output, text, size);
+        return output + size;
+    }
+
+    // Rounds the decimal digits of a double to precision digits, where
+    // value = digits * 10^exponent. The digits are the shortest ones that
+    // read back as the double, so they may differ from the exact binary
+    // value by up to half a unit in the last place. Returns false if the
+    // digits are too close to halfway between two precision-digit numbers to
+    // tell which one is nearer to the exact value.
+    bool round_digits(char* digits, int& digit_count, int& exponent, int precision)
+    {
+        // Scale the digits to a 17-digit integer.
+        std::uint64_t scaled = 0;
+        for (int i = 0; i < digit_count; ++i) {
+            scaled = scaled * 10 + static_cast<std::uint64_t>(digits[i] - '0');
+        }
+        int const padding = 17 - digit_count;
+        scaled *= integer_powers_of_ten[padding];
+
+        // A unit in the last place of a double is at most 23 units of the
+        // 17-digit integer.
+        std::uint64_t const unit = integer_powers_of_ten[17 - precision];
+        std::uint64_t const remainder = scaled % unit;
+        std::uint64_t const half = unit / 2;
+        std::uint64_t const margin = 32;
+
+        if (remainder + margin >= half && remainder <= half + margin) {
+            return false;
+        }
+
+        std::uint64_t rounded = scaled / unit + (remainder > half ? 1 : 0);
+        exponent += 17 - precision - padding;
+
+        // Rounding up may carry into a new digit.
+        if (rounded == integer_powers_of_ten[precision]) {
+            rounded /= 10;
+            exponent++;
+        }
+
+        for (int i = precision - 1; i >= 0; --i) {
+            digits[i] = static_cast<char>('0' + rounded % 10);
+            rounded /= 10;
+        }
+        digit_count = precision;
+
+        return true;
+    }
+
+    // Formats value = digits * 10^exponent like printf("%.*g", precision)
+    // formats a number whose significant digits are the given ones.
+    char* format_digits(char* output, char const* digits, int digit_count, int exponent, int precision)
+    {
+        while (digit_count > 1 && digits[digit_count - 1] == '0') {
+            digit_count--;
+            exponent++;
+        }
+
+        int const leading_exponent = digit_count + exponent - 1;
+
+        if (leading_exponent < -4 || leading_exponent >= precision) {
+            *output++ = digits[0];
+            if (digit_count > 1) {
+                *output++ = '.';
+                std::memcpy(output, digits + 1, static_cast<std::size_t>(digit_count - 1));
+                output += digit_count - 1;
+            }
+
+            int magnitude = leading_exponent < 0 ? -leading_exponent : leading_exponent;
+            *output++ = 'e';
+            *output++ = leading_exponent < 0 ? '-' : '+';
+            if (magnitude >= 100) {
+                *output++ = static_cast<char>('0' + magnitude / 100);
+                magnitude %= 100;
+            }
+            *output++ = static_cast<char>('0' + magnitude / 10);
+            *output++ = static_cast<char>('0' + magnitude % 10);
+            return output;
+        }
+
+        if (exponent >= 0) {
+            std::memcpy(output, digits, static_cast<std::size_t>(digit_count));
+            output += digit_count;
+            std::memset(output, '0', static_cast<std::size_t>(exponent));
+            return output + exponent;
+        }
+
+        if (leading_exponent >= 0) {
+            auto const integer_digits = static_cast<std::size_t>(leading_exponent + 1);
+            std::memcpy(output, digits, integer_digits);
+            output += integer_digits;
+            *output++ = '.';
+            std::memcpy(output, digits + integer_digits, static_cast<std::size_t>(digit_count) - integer_digits);
+            return output + (static_cast<std::size_t>(digit_count) - integer_digits);
+        }
+
+        *output++ = '0';
+        *output++ = '.';
+        auto const zero_count = static_cast<std::size_t>(-leading_exponent - 1);
+        std::memset(output, '0', zero_count);
+        output += zero_count;
+        std::memcpy(output, digits, static_cast<std::size_t>(digit_count));
+        return output + digit_count;
     }
 
-    return item_count;
+    // Counts the rows in [begin, end), including a last row without '\n'.
+    std::size_t count_rows(char const* begin, char const* end)
+    {
+        std::size_t count = 0;
+
+        for (char const* p = begin; p != end; ++count) {
+            auto const newline = static_cast<char const*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+            p = newline ? newline + 1 : end;
+        }
+        return count;
+    }
+}
+
+bool parse_tsv_number(char const* begin, char const* end, double& value)
+{
+    return parse_number(begin, end, value);
+}
+
+tsv_error::tsv_error(std::string const& message, std::size_t line)
+    : std::runtime_error{"line " + std::to_string(line) + ": " + message}
+    , line_{line}
+{
+}
+
+std::size_t tsv_error::line() const
+{
+    return line_;
+}
+
+tsv_tensor parse_tsv(char const* begin, char const* end, thread_pool& pool, std::size_t first_line)
+{
+    LDA_PROFILE_SCOPE("tsv.parse");
+
+    auto const size = static_cast<std::size_t>(end - begin);
+    std::size_t const segment_count = std::max<std::size_t>(1, std::min(pool.size(), size / min_bytes_per_thread));
+
+    // Split the text into segments of whole lines.
+    std::vector<char const*> segment_bounds(segment_count + 1, end);
+    segment_bounds[0] = begin;
+
+    for (std::size_t i = 1; i < segment_count; ++i) {
+        char const* const p = std::max(begin + size * i / segment_count, segment_bounds[i - 1]);
+        auto const newline = static_cast<char const*>(
+            std::memchr(p - 1, '\n', static_cast<std::size_t>(end - (p - 1))));
+        segment_bounds[i] = newline ? newline + 1 : end;
+    }
+
+    std::vector<std::size_t> row_offsets(segment_count + 1, 0);
+
+    pool.run([&](std::size_t segment) {
+        if (segment < segment_count) {
+            row_offsets[segment + 1] = count_rows(segment_bounds[segment], segment_bounds[segment + 1]);
+        }
+    });
+
+    for (std::size_t i = 0; i < segment_count; ++i) {
+        row_offsets[i + 1] += row_offsets[i];
+    }
+
+    std::size_t const row_count = row_offsets.back();
+    LDA_PROFILE_COUNT("tsv.bytes_parsed", size);
+    LDA_PROFILE_COUNT("tsv.rows_parsed", row_count);
+
+    std::size_t const col_count = row_count == 0 ? 0 : count_columns(begin, line_content_end(begin, end));
+
+    tsv_tensor::container_type values(row_count * col_count);
+
+    // Each segment keeps its first error, and the error at the earliest
+    // line is reported regardless of thread scheduling.
+    std::vector<std::exception_ptr> errors(segment_count);
+
+    pool.run([&](std::size_t segment) {
+        if (segment >= segment_count) {
+            return;
+        }
+
+        char const* const segment_end = segment_bounds[segment + 1];
+        std::size_t row = row_offsets[segment];
+
+        try {
+            for (char const* p = segment_bounds[segment]; p != segment_end; ++row) {
+                char const* const content_end = line_content_end(p, segment_end);
+                parse_row(p, content_end, values.data() + row * col_count, col_count, first_line + row);
+
+                auto const newline = static_cast<char const*>(
+                    std::memchr(content_end, '\n', static_cast<std::size_t>(segment_end - content_end)));
+                p = newline ? newline + 1 : segment_end;
+            }
+        } catch (...) {
+            errors[segment] = std::current_exception();
+        }
+    });
+
+    for (std::exception_ptr const& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // The strides must be given explicitly; zero strides would make every
+    // element access read the first element.
+    tsv_tensor::shape_type shape = {row_count, col_count};
+    tsv_tensor::strides_type strides;
+    xt::compute_strides(shape, xt::layout_type::row_major, strides);
+
+    return tsv_tensor{std::move(values), std::move(shape), std::move(strides)};
 }
 
 tsv_tensor load_tsv(std::istream& input)
 {
-    tsv_tensor::container_type values;
+    return tsv_reader{input}.read_all();
+}
+
+tsv_tensor load_tsv(std::istream& input, std::size_t max_rows)
+{
+    std::string text;
     std::size_t row_count = 0;
-    std::size_t col_count = 0;
 
-    for (std::string line; std::getline(input, line); ) {
-        col_count = parse_tsv_row(line, std::back_inserter(values));
+    for (std::string line; row_count < max_rows && std::getline(input, line); ) {
+        text += line;
+        text += '\n';
         row_count++;
     }
 
-    return tsv_tensor{std::move(values), {row_count, col_count}, {}};
+    thread_pool pool{1};
+    return parse_tsv(text.data(), text.data() + text.size(), pool);
+}
+
+tsv_reader::tsv_reader(std::istream& input, std::size_t thread_count)
+    : input_{input}
+    , pool_{new thread_pool{thread_count}}
+{
+}
+
+tsv_reader::~tsv_reader() = default;
+
+tsv_tensor tsv_reader::read(std::size_t max_rows)
+{
+    for (;;) {
+        while (scanned_rows_ < max_rows && scan_end_ < end_) {
+            auto const newline = static_cast<char const*>(
+                std::memchr(buffer_.data() + scan_end_, '\n', end_ - scan_end_));
+            if (!newline) {
+                break;
+            }
+            scan_end_ = static_cast<std::size_t>(newline - buffer_.data()) + 1;
+            scanned_rows_++;
+        }
+
+        if (scanned_rows_ == max_rows) {
+            break;
+        }
+
+        if (!fill()) {
+            // The last line may lack '\n'.
+            if (scan_end_ < end_) {
+                scan_end_ = end_;
+                scanned_rows_++;
+            }
+            break;
+        }
+    }
+
+    char const* const text = buffer_.data();
+    tsv_tensor result = parse_tsv(text + begin_, text + scan_end_, *pool_, line_count_ + 1);
+
+    line_count_ += scanned_rows_;
+    begin_ = scan_end_;
+    scanned_rows_ = 0;
+
+    return result;
+}
+
+tsv_tensor tsv_reader::read_all()
+{
+    return read(std::numeric_limits<std::size_t>::max());
+}
+
+std::size_t tsv_reader::line_count() const
+{
+    return line_count_;
+}
+
+bool tsv_reader::fill()
+{
+    // Move the unconsumed text to the front to reuse the buffer.
+    if (begin_ != 0) {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        scan_end_ -= begin_;
+        begin_ = 0;
+    }
+
+    if (buffer_.size() < end_ + read_block_size) {
+        buffer_.resize(std::max(end_ + read_block_size, 2 * buffer_.size()));
+    }
+
+    // Take what the stream has available, so that rows arriving slowly
+    // through a pipe are returned without waiting for a whole block. A
+    // stream that cannot tell how much is available is read a block at a
+    // time.
+    std::streambuf& stream_buffer = *input_.rdbuf();
+    std::streamsize available = stream_buffer.in_avail();
+
+    if (available == 0 && stream_buffer.sgetc() != std::streambuf::traits_type::eof()) {
+        available = stream_buffer.in_avail();
+    }
+
+    auto const block_size = static_cast<std::streamsize>(read_block_size);
+    std::streamsize const request = available > 0 ? std::min(available, block_size) : block_size;
+
+    std::size_t read_size;
+    {
+        LDA_PROFILE_SCOPE("tsv.read");
+        read_size = static_cast<std::size_t>(stream_buffer.sgetn(buffer_.data() + end_, request));
+    }
+    LDA_PROFILE_COUNT("tsv.bytes_read", read_size);
+    end_ += read_size;
+
+    if (read_size == 0) {
+        input_.setstate(std::ios::eofbit);
+    }
+
+    return read_size != 0;
 }
 
-void save_tsv(std::ostream& output, xt::xtensor<double, 2> const& tensor)
+char* format_number(char* output, double value, int precision)
 {
+    if (!std::isfinite(value)) {
+        return format_special(output, value);
+    }
+
+    if (std::signbit(value)) {
+        *output++ = '-';
+        value = -value;
+    }
+
+    if (value == 0) {
+        *output++ = '0';
+        return output;
+    }
+
+    // The shortest digits are the leading digits of the exact value only up
+    // to 15 digits, and fewer for subnormal numbers. Leave the others, and
+    // the digits too close to a rounding boundary to decide, to printf.
+    if (precision > 15 || (precision > 0 && value < std::numeric_limits<double>::min())) {
+        return output + std::sprintf(output, "%.*g", precision, value);
+    }
+
+    char digits[32];
+    int digit_count = 0;
+    int exponent = 0;
+    nlohmann::detail::dtoa_impl::grisu2(digits, digit_count, exponent, value);
+
+    if (precision > 0 && digit_count > precision && !round_digits(digits, digit_count, exponent, precision)) {
+        return output + std::sprintf(output, "%.*g", precision, value);
+    }
+
+    return format_digits(output, digits, digit_count, exponent,
+                         precision > 0 ? precision : std::numeric_limits<double>::max_digits10);
+}
+
+char* format_number(char* output, float value, int precision)
+{
+    if (precision > 0 || !std::isfinite(value)) {
+        return format_number(output, static_cast<double>(value), precision);
+    }
+
+    if (std::signbit(value)) {
+        *output++ = '-';
+        value = -value;
+    }
+
+    if (value == 0) {
+        *output++ = '0';
+        return output;
+    }
+
+    char digits[32];
+    int digit_count = 0;
+    int exponent = 0;
+    nlohmann::detail::dtoa_impl::grisu2(digits, digit_count, exponent, value);
+
+    return format_digits(output, digits, digit_count, exponent, std::numeric_limits<float>::max_digits10);
+}
+
+tsv_writer::tsv_writer(std::ostream& output, int precision)
+    : output_{output}
+    , precision_{precision}
+    , buffer_(writer_buffer_size)
+{
+    if (precision < 0 || precision > std::numeric_limits<double>::max_digits10) {
+        throw std::invalid_argument("precision must be in [0, 17]");
+    }
+}
+
+tsv_writer::~tsv_writer()
+{
+    output_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+}
+
+void tsv_writer::write(double value)
+{
+    size_ = static_cast<std::size_t>(format_number(reserve(max_formatted_size), value, precision_) - buffer_.data());
+}
+
+void tsv_writer::write(float value)
+{
+    size_ = static_cast<std::size_t>(format_number(reserve(max_formatted_size), value, precision_) - buffer_.data());
+}
+
+void tsv_writer::write(std::size_t value)
+{
+    char digits[20];
+    char* end = digits + sizeof digits;
+    char* begin = end;
+
+    do {
+        *--begin = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    write(begin, static_cast<std::size_t>(end - begin));
+}
+
+void tsv_writer::put(char ch)
+{
+    *reserve(1) = ch;
+    size_++;
+}
+
+void tsv_writer::write(char const* data, std::size_t size)
+{
+    if (size > buffer_.size()) {
+        flush_buffer();
+        output_.write(data, static_cast<std::streamsize>(size));
+        return;
+    }
+
+    std::memcpy(reserve(size), data, size);
+    size_ += size;
+}
+
+void tsv_writer::flush()
+{
+    flush_buffer();
+    output_.flush();
+
+    if (!output_) {
+        throw std::runtime_error("cannot write output");
+    }
+}
+
+char* tsv_writer::reserve(std::size_t size)
+{
+    if (buffer_.size() - size_ < size) {
+        flush_buffer();
+    }
+    return buffer_.data() + size_;
+}
+
+void tsv_writer::flush_buffer()
+{
+    LDA_PROFILE_SCOPE("tsv.write");
+    LDA_PROFILE_COUNT("tsv.bytes_written", size_);
+
+    output_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+}
+
+template<typename T>
+void save_tsv(std::ostream& output, xt::xtensor<T, 2> const& tensor, int precision)
+{
+    LDA_PROFILE_SCOPE("tsv.save");
+
     std::size_t const row_count = tensor.shape()[0];
     std::size_t const col_count = tensor.shape()[1];
 
+    tsv_writer writer{output, precision};
+    T const* values = tensor.raw_data();
+
     for (std::size_t row = 0; row < row_count; ++row) {
         for (std::size_t col = 0; col < col_count; ++col) {
-            output << tensor(row, col)
-                   << (col == col_count - 1 ? '\n' : '\t');
+            writer.write(values[row * col_count + col]);
+            writer.put(col == col_count - 1 ? '\n' : '\t');
         }
     }
+
+    writer.flush();
 }
+
+template void save_tsv(std::ostream& output, xt::xtensor<float, 2> const& tensor, int precision);
+template void save_tsv(std::ostream& output, xt::xtensor<double, 2> const& tensor, int precision);
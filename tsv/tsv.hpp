@@ -1,21 +1,166 @@
 #ifndef INCLUDED_TSV_HPP
 #define INCLUDED_TSV_HPP
 
+#include <cstddef>
 #include <istream>
+#include <memory>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <xtensor/xtensor.hpp>
 
 
+class thread_pool;
+
 // xtensor container type used to store tsv contents.
 using tsv_tensor = xt::xtensor_container<std::vector<double>, 2, xt::layout_type::row_major>;
 
-// Loads TSV into a two-dimensional tensor.
+// Error in TSV content, such as a malformed number or a row whose number
+// of columns differs from the first row. The readers of the sparse text
+// formats throw it as well.
+class tsv_error : public std::runtime_error
+{
+  public:
+    // Creates an error at given line, counted from one.
+    tsv_error(std::string const& message, std::size_t line);
+
+    // Returns the line of the error, counted from one.
+    std::size_t line() const;
+
+  private:
+    std::size_t line_;
+};
+
+// Loads TSV into a two-dimensional tensor. Throws tsv_error if the content
+// is malformed or ragged.
 tsv_tensor load_tsv(std::istream& input);
 
-// Saves a two-dimensional tensor into a TSV file.
-void save_tsv(std::ostream& output, xt::xtensor<double, 2> const& tensor);
+// Loads at most max_rows rows of TSV into a two-dimensional tensor. The
+// stream is left at the beginning of the next row, so a large file can be
+// loaded in chunks by calling this function repeatedly. tsv_reader reads
+// chunks faster since it is allowed to read ahead.
+tsv_tensor load_tsv(std::istream& input, std::size_t max_rows);
+
+// Parses a number in [begin, end) independently of the locale. Returns
+// false if the text is not entirely a number.
+bool parse_tsv_number(char const* begin, char const* end, double& value);
+
+// Parses the TSV text in [begin, end) on the threads of pool. Rows are
+// separated by '\n' and columns by spaces or tabs, and numbers are parsed
+// independently of the locale. first_line is the line number of the first
+// row used in error messages.
+tsv_tensor parse_tsv(char const* begin, char const* end, thread_pool& pool, std::size_t first_line = 1);
+
+// Reads TSV from a stream in chunks of rows. The stream is read in large
+// blocks, so it must not be used by others while the reader is reading it.
+class tsv_reader
+{
+  public:
+    // Creates a reader parsing on thread_count threads.
+    explicit tsv_reader(std::istream& input, std::size_t thread_count = 1);
+
+    ~tsv_reader();
+
+    tsv_reader(tsv_reader const&) = delete;
+    tsv_reader& operator=(tsv_reader const&) = delete;
+
+    // Reads at most max_rows rows. Returns an empty tensor at the end of the
+    // input. Throws tsv_error if the rows are malformed or ragged; the
+    // column count is checked within each chunk.
+    tsv_tensor read(std::size_t max_rows);
+
+    // Reads all the remaining rows.
+    tsv_tensor read_all();
+
+    // Returns the number of lines read so far.
+    std::size_t line_count() const;
+
+  private:
+    // Appends a block from the stream to the buffer. Returns false at the
+    // end of the stream.
+    bool fill();
+
+  private:
+    std::istream& input_;
+    std::unique_ptr<thread_pool> pool_;
+
+    // Unconsumed text is in [begin_, end_) of buffer_. The first
+    // scanned_rows_ lines of it end before scan_end_.
+    std::vector<char> buffer_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+    std::size_t scan_end_ = 0;
+    std::size_t scanned_rows_ = 0;
+    std::size_t line_count_ = 0;
+};
+
+// Upper bound of the number of characters written by format_number.
+constexpr std::size_t max_formatted_size = 32;
+
+// Formats value like printf("%.*g", precision, value) in the "C" locale.
+// If precision is 0, the value is written with the fewest significant
+// digits that read back as the same value, using the Grisu2 algorithm,
+// which finds the shortest digits for all but a tiny fraction of values.
+// Returns the end of the written characters.
+char* format_number(char* output, double value, int precision);
+
+// Formats a float like the double overload. The shortest representation
+// is the one that reads back as the same float.
+char* format_number(char* output, float value, int precision);
+
+// Buffered writer of TSV text. Numbers are formatted by format_number into
+// a large buffer, which is written to the stream when it is full or on
+// flush. This is much faster than operator<< on each number.
+class tsv_writer
+{
+  public:
+    // Creates a writer formatting numbers with given precision, which is
+    // between 0 (shortest) and 17.
+    explicit tsv_writer(std::ostream& output, int precision = 6);
+
+    // Writes the buffered text without checking for errors.
+    ~tsv_writer();
+
+    tsv_writer(tsv_writer const&) = delete;
+    tsv_writer& operator=(tsv_writer const&) = delete;
+
+    // Writes a number.
+    void write(double value);
+    void write(float value);
+
+    // Writes an index in decimal.
+    void write(std::size_t value);
+
+    // Writes a character.
+    void put(char ch);
+
+    // Writes raw bytes.
+    void write(char const* data, std::size_t size);
+
+    // Writes the buffered text and flushes the stream. Throws
+    // std::runtime_error if the stream has failed.
+    void flush();
+
+  private:
+    // Returns room for size characters at the end of the buffer.
+    char* reserve(std::size_t size);
+
+    // Writes the buffered text to the stream.
+    void flush_buffer();
+
+  private:
+    std::ostream& output_;
+    int precision_;
+    std::vector<char> buffer_;
+    std::size_t size_ = 0;
+};
+
+// Saves a two-dimensional tensor into a TSV file. Numbers are formatted
+// with given precision as in format_number. T is float or double.
+template<typename T>
+void save_tsv(std::ostream& output, xt::xtensor<T, 2> const& tensor, int precision = 6);
 
 
 #endif